@@ -0,0 +1,114 @@
+/* Headless deco analysis of a whole logbook */
+
+#include <QString>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QVector>
+#include <QPair>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "qt-gui.h"
+#include "qthelper.h"
+#include "dive.h"
+#include "git2.h"
+#include "subsurfacestartup.h"
+#include "divelist.h"
+#include "deco-analysis.h"
+
+// analyzes the dives of a series, see deco_series_end()
+struct AnalyzeSeries {
+	AnalyzeSeries(struct deco_analysis *analysis, const struct deco_settings &settings) :
+		analysis(analysis),
+		settings(settings)
+	{
+	}
+	void operator()(const QPair<int, int> &series) const
+	{
+		for (int i = series.first; i < series.second; i++)
+			analyze_dive_deco(get_dive(i), &settings, analysis + i);
+	}
+	struct deco_analysis *analysis;
+	struct deco_settings settings;
+};
+
+int main(int argc, char **argv)
+{
+	QApplication *application = new QApplication(argc, argv);
+	git_libgit2_init();
+	copy_prefs(&default_prefs, &prefs);
+	init_qt_late();
+
+	QCommandLineParser parser;
+	QCommandLineOption sourceOption(QStringList() << "s" << "source",
+					"Read dive log from <file>",
+					"file");
+	parser.addOption(sourceOption);
+	QCommandLineOption outputOption(QStringList() << "o" << "output",
+					"Write report into <file>",
+					"file");
+	parser.addOption(outputOption);
+	QCommandLineOption jsonOption(QStringList() << "json",
+				      "Write JSON instead of CSV");
+	parser.addOption(jsonOption);
+	QCommandLineOption threadsOption(QStringList() << "j" << "threads",
+					 "Use <n> threads (default: one per CPU)",
+					 "n");
+	parser.addOption(threadsOption);
+	QCommandLineOption vpmbOption(QStringList() << "vpmb",
+				      "Use VPM-B instead of Buehlmann");
+	parser.addOption(vpmbOption);
+	QCommandLineOption gfOption(QStringList() << "gf",
+				    "Use gradient factors <low>/<high> with Buehlmann",
+				    "low/high");
+	parser.addOption(gfOption);
+
+	parser.process(*application);
+
+	QString source = parser.value(sourceOption);
+	QString output = parser.value(outputOption);
+
+	if (source.isEmpty() || output.isEmpty()) {
+		qDebug() << "need --source and --output";
+		exit(1);
+	}
+	int ret = parse_file(qPrintable(source));
+	if (ret) {
+		fprintf(stderr, "parse_file returned %d\n", ret);
+		exit(1);
+	}
+	process_dives(false, false);
+
+	// the same calculations as the profile shows, including NDL and TTS
+	prefs.calcndltts = true;
+	prefs.display_deco_mode = parser.isSet(vpmbOption) ? VPMB : BUEHLMANN;
+	if (parser.isSet(gfOption)) {
+		QStringList gf = parser.value(gfOption).split('/');
+		if (gf.count() != 2) {
+			qDebug() << "--gf needs <low>/<high>";
+			exit(1);
+		}
+		prefs.gflow = gf[0].toInt();
+		prefs.gfhigh = gf[1].toInt();
+	}
+	set_gf(prefs.gflow, prefs.gfhigh, prefs.gf_low_at_maxdepth);
+	set_vpmb_conservatism(prefs.vpmb_conservatism);
+	struct deco_settings settings;
+	get_deco_settings(&settings);
+	// the calculated CNS carries over from the dive before
+	update_all_cylinder_related_info();
+	if (parser.isSet(threadsOption))
+		QThreadPool::globalInstance()->setMaxThreadCount(parser.value(threadsOption).toInt());
+
+	// Dives that are more than 48 hours apart don't share any tissue
+	// loading, so each such series of dives can go on its own thread.
+	QVector<QPair<int, int>> series;
+	for (int i = 0; i < dive_table.nr; i = series.last().second)
+		series.append(qMakePair(i, deco_series_end(i)));
+
+	struct deco_analysis *analysis = (struct deco_analysis *)calloc(dive_table.nr, sizeof(struct deco_analysis));
+	QtConcurrent::blockingMap(series, AnalyzeSeries(analysis, settings));
+
+	export_deco_analysis(qPrintable(output), analysis, dive_table.nr, parser.isSet(jsonOption));
+	exit(0);
+}
@@ -0,0 +1,235 @@
+/* deco-analysis.c
+ *
+ * Run the deco model over logged dives and sum up what it found,
+ * e.g. to audit a whole logbook without clicking through every profile.
+ */
+#include <string.h>
+#include <math.h>
+#include "gettext.h"
+#include "dive.h"
+#include "display.h"
+#include "profile.h"
+#include "planner.h"
+#include "divelist.h"
+#include "deco-analysis.h"
+
+/*
+ * The dives that init_decompression() may look at when calculating
+ * the tissues for dive idx or any later dive of its series all lie
+ * between the start of the series and its end - so different series
+ * can be analyzed at the same time, the dives of one series in order.
+ *
+ * Returns the index of the first dive of the next series.
+ */
+int deco_series_end(int idx)
+{
+	struct dive *dive = get_dive(idx);
+	timestamp_t lasttime;
+
+	if (!dive)
+		return idx;
+	lasttime = dive->when + dive->duration.seconds;
+	while ((dive = get_dive(++idx)) != NULL) {
+		if (lasttime + 48 * 60 * 60 < dive->when)
+			break;
+		if (dive->when + dive->duration.seconds > lasttime)
+			lasttime = dive->when + dive->duration.seconds;
+	}
+	return idx;
+}
+
+/*
+ * This runs through the same calculations as the profile, with the settings
+ * in prefs, so calculate the NDL and TTS only if prefs.calcndltts is set.
+ * The deco settings come from get_deco_settings() on the main thread, which
+ * also has to run update_all_cylinder_related_info() first - the CNS of a
+ * dive depends on the dives before it. Other than that, this doesn't touch
+ * any global state but the tissue checkpoints of the dives in the same
+ * series, see deco_series_end().
+ */
+void analyze_dive_deco(struct dive *dive, const struct deco_settings *settings, struct deco_analysis *analysis)
+{
+	struct deco_state ds;
+	struct plot_info pi;
+	int i, j, bottom = 0;
+
+	memset(analysis, 0, sizeof(*analysis));
+	analysis->number = dive->number;
+	analysis->when = dive->when;
+	analysis->maxcns = dive->maxcns;
+	analysis->otu = dive->otu;
+
+	pi = calculate_max_limits_new(dive, &dive->dc);
+	pi.columns = PLOT_TISSUE_PERCENTAGES;
+	/* create_plot_info_new(), but with the settings we were given */
+#ifndef SUBSURFACE_MOBILE
+	init_decompression(&ds, dive, settings);
+#endif
+	create_plot_info_without_deco(dive, &dive->dc, &pi, true);
+#ifndef SUBSURFACE_MOBILE
+	calculate_deco_information(&ds, NULL, dive, &dive->dc, &pi, false);
+#endif
+	for (i = 1; i < pi.nr; i++) {
+		struct plot_data *entry = pi.entry + i;
+		int *percentages = plot_tissue_percentages(&pi, i);
+		int violation = entry->ceiling - entry->depth;
+
+		if (violation > 0) {
+			analysis->ceiling_violation_time += entry->sec - entry[-1].sec;
+			if (violation > analysis->max_ceiling_violation)
+				analysis->max_ceiling_violation = violation;
+		}
+		/* above AMB_PERCENTAGE, the percentages are the gradient factors scaled to the upper half */
+		for (j = 0; j < 16; j++) {
+			double gf = (percentages[j] - AMB_PERCENTAGE) * 100.0 / (100.0 - AMB_PERCENTAGE);
+			if (gf > analysis->max_gf)
+				analysis->max_gf = gf;
+		}
+		/* the bottom time ends when we leave the deepest quarter of the dive for good */
+		if (entry->depth * 4 >= dive->dc.maxdepth.mm * 3)
+			bottom = i;
+	}
+	if (bottom) {
+		analysis->bottom_time = pi.entry[bottom].sec;
+		analysis->tts = pi.entry[bottom].tts_calc;
+	}
+	free_plot_info_data(&pi);
+}
+
+/*
+ * A quick look at the deco of a dive, for the dive list. Unlike the profile,
+ * this only updates the tissues once every DECO_PREVIEW_STEP seconds of the
+ * first dive computer and doesn't bother with NDL and TTS. The dives of a
+ * series (see deco_series_end()) have to come through here in order and with
+ * the same ds: *lasttime is the end of the dive before, 0 for the first dive
+ * of a series - then ds gets cleared with the settings of the preview.
+ * Buehlmann only, and nothing but ds, lasttime and preview is changed, so
+ * it can run on another thread with a copy of the dive.
+ */
+void preview_dive_deco(struct deco_state *ds, timestamp_t *lasttime, struct dive *dive, struct deco_preview *preview)
+{
+	struct divecomputer *dc = &dive->dc;
+	struct gasmix air = { .o2.permille = O2_IN_AIR, .he.permille = 0 };
+	double surface_pressure = get_surface_pressure_in_mbar(dive, true) / 1000.0;
+	int i, j, step_start, ceiling;
+	int64_t depth_sum = 0;
+
+	preview->max_ceiling = 0;
+	preview->surface_gf = 0;
+	preview->deco_time = 0;
+	if (!*lasttime)
+		clear_deco(ds, surface_pressure, &preview->settings);
+	else if (dive->when > *lasttime)
+		add_segment(ds, surface_pressure, &air, dive->when - *lasttime, 0, dive, prefs.decosac);
+	if (dive->when + dive->duration.seconds > *lasttime)
+		*lasttime = dive->when + dive->duration.seconds;
+	if (dc->samples < 2)
+		return;
+
+	step_start = dc->sample[0].time.seconds;
+	for (i = 1; i < dc->samples; i++) {
+		struct sample *sample = dc->sample + i;
+		struct sample *psample = sample - 1;
+		int duration = sample->time.seconds - step_start;
+		struct gasmix gas;
+		duration_t middle;
+
+		/* the mean depth of the step */
+		depth_sum += (int64_t)(sample->depth.mm + psample->depth.mm) * (sample->time.seconds - psample->time.seconds) / 2;
+		if (duration < DECO_PREVIEW_STEP && i < dc->samples - 1)
+			continue;
+		if (duration > 0) {
+			middle.seconds = step_start + duration / 2;
+			get_gas_at_time(dive, dc, middle, &gas);
+			add_segment(ds, depth_to_bar(depth_sum / duration, dive), &gas, duration, sample->setpoint.mbar, dive, prefs.decosac);
+			ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(sample->depth.mm, dive)),
+						     surface_pressure, dive, !prefs.calcceiling3m);
+			if (ceiling > preview->max_ceiling)
+				preview->max_ceiling = ceiling;
+			if (ceiling > 0)
+				preview->deco_time += duration;
+		}
+		step_start = sample->time.seconds;
+		depth_sum = 0;
+	}
+
+	/* the gradient factor of the leading compartment, had we gone straight up */
+	tissue_tolerance_calc(ds, dive, surface_pressure);
+	for (j = 0; j < 16; j++) {
+		double m_value = ds->buehlmann_inertgas_a[j] + surface_pressure / ds->buehlmann_inertgas_b[j];
+		int gf = lrint((ds->tissue_inertgas_saturation[j] - surface_pressure) / (m_value - surface_pressure) * 100.0);
+		if (gf > preview->surface_gf)
+			preview->surface_gf = gf;
+	}
+}
+
+/*
+ * Is the deco preview of dive still good: calculated with these settings,
+ * after prev_dive (the dive before it in its series, or NULL) and neither
+ * of them changed since? invalidate_dive_cache() takes care of the latter.
+ */
+bool deco_preview_is_current(const struct dive *dive, const struct dive *prev_dive, const struct deco_settings *settings)
+{
+	const struct deco_preview *preview = &dive->deco_preview;
+
+	if (!preview->valid || preview->prev_id != (prev_dive ? prev_dive->id : 0))
+		return false;
+	if (prev_dive && !prev_dive->deco_preview.valid)
+		return false;
+	return preview->settings.gf_low == settings->gf_low && preview->settings.gf_high == settings->gf_high &&
+	       preview->settings.gf_low_at_maxdepth == settings->gf_low_at_maxdepth;
+}
+
+static void put_date(struct membuffer *b, timestamp_t when, const char *pre, const char *post)
+{
+	struct tm tm;
+
+	utc_mkdate(when, &tm);
+	put_format(b, "%s%04u-%02u-%02u %02u:%02u:%02u%s", pre,
+		   tm.tm_year, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, post);
+}
+
+void put_deco_analysis(struct membuffer *b, const struct deco_analysis *analysis, int nr, bool json)
+{
+	int i;
+
+	if (json)
+		put_string(b, "[\n");
+	else
+		put_string(b, "dive number,date,ceiling violation [s],max ceiling violation [m],max CNS [%],OTU,max GF [%],end of bottom time [s],TTS [s]\n");
+	for (i = 0; i < nr; i++) {
+		const struct deco_analysis *a = analysis + i;
+
+		if (json) {
+			put_format(b, "  {\"number\": %d, ", a->number);
+			put_date(b, a->when, "\"date\": \"", "\", ");
+			put_format(b, "\"ceiling_violation_s\": %d, \"max_ceiling_violation_m\": %.1f, ",
+				   a->ceiling_violation_time, a->max_ceiling_violation / 1000.0);
+			put_format(b, "\"max_cns\": %d, \"otu\": %d, \"max_gf\": %.0f, \"bottom_time_s\": %d, \"tts_s\": %d}%s\n",
+				   a->maxcns, a->otu, a->max_gf, a->bottom_time, a->tts, i < nr - 1 ? "," : "");
+		} else {
+			put_format(b, "%d,", a->number);
+			put_date(b, a->when, "", ",");
+			put_format(b, "%d,%.1f,%d,%d,%.0f,%d,%d\n", a->ceiling_violation_time, a->max_ceiling_violation / 1000.0,
+				   a->maxcns, a->otu, a->max_gf, a->bottom_time, a->tts);
+		}
+	}
+	if (json)
+		put_string(b, "]\n");
+}
+
+void export_deco_analysis(const char *file_name, const struct deco_analysis *analysis, int nr, bool json)
+{
+	FILE *f;
+	struct membuffer buf = { 0 };
+
+	put_deco_analysis(&buf, analysis, nr, json);
+	f = subsurface_fopen(file_name, "w+");
+	if (!f) {
+		report_error(translate("gettextFromC", "Can't open file %s"), file_name);
+	} else {
+		flush_buffer(&buf, f);
+		fclose(f);
+	}
+	free_buffer(&buf);
+}
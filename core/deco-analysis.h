@@ -0,0 +1,37 @@
+#ifndef DECO_ANALYSIS_H
+#define DECO_ANALYSIS_H
+
+#include "dive.h"
+#include "membuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What the deco model has to say about a logged dive */
+struct deco_analysis {
+	int number;
+	timestamp_t when;
+	int ceiling_violation_time;	// seconds spent shallower than the calculated ceiling
+	int max_ceiling_violation;	// mm, the most the ceiling was above the diver
+	int maxcns, otu;
+	double max_gf;			// in percent, of the leading compartment
+	int bottom_time;		// seconds, end of the bottom time
+	int tts;			// seconds, time to surface at the end of the bottom time
+};
+
+/* the steps of the deco preview, in seconds of the dive */
+#define DECO_PREVIEW_STEP 60
+
+extern int deco_series_end(int idx);
+extern void analyze_dive_deco(struct dive *dive, const struct deco_settings *settings, struct deco_analysis *analysis);
+extern void preview_dive_deco(struct deco_state *ds, timestamp_t *lasttime, struct dive *dive, struct deco_preview *preview);
+extern bool deco_preview_is_current(const struct dive *dive, const struct dive *prev_dive, const struct deco_settings *settings);
+extern void put_deco_analysis(struct membuffer *b, const struct deco_analysis *analysis, int nr, bool json);
+extern void export_deco_analysis(const char *file_name, const struct deco_analysis *analysis, int nr, bool json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DECO_ANALYSIS_H
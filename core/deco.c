@@ -9,9 +9,9 @@
  *
  * add_segment()	- add <seconds> at the given pressure, breathing gasmix
  * deco_allowed_depth() - ceiling based on lead tissue, surface pressure, 3m increments or smooth
- * set_gf()		- set Buehlmann gradient factors
- * set_vpmb_conservatism() - set VPM-B conservatism value
- * clear_deco()
+ * set_gf()		- set default Buehlmann gradient factors
+ * set_vpmb_conservatism() - set default VPM-B conservatism value
+ * clear_deco()		- start a calculation with the default or its own deco_settings
  * cache_deco_state()
  * restore_deco_state()
  * dump_tissues()
@@ -21,6 +21,7 @@
 #include "dive.h"
 #include <assert.h>
 #include "core/planner.h"
+#include "core/deco.h"
 #include "qthelperfromc.h"
 
 #define cube(x) (x * x * x)
@@ -31,29 +32,20 @@
 
 
 extern bool in_planner();
-extern int plot_depth;
-
-extern pressure_t first_ceiling_pressure;
 
 //! Option structure for Buehlmann decompression.
 struct buehlmann_config {
 	double satmult;			//! safety at inert gas accumulation as percentage of effect (more than 100).
 	double desatmult;		//! safety at inert gas depletion as percentage of effect (less than 100).
 	int last_deco_stop_in_mtr;	//! depth of last_deco_stop.
-	double gf_high;			//! gradient factor high (at surface).
-	double gf_low;			//! gradient factor low (at bottom/start of deco calculation).
 	double gf_low_position_min;	//! gf_low_position below surface_min_shallow.
-	bool gf_low_at_maxdepth;	//! if true, gf_low applies at max depth instead of at deepest ceiling.
 };
 
 struct buehlmann_config buehlmann_config = {
 	.satmult = 1.0,
 	.desatmult = 1.01,
 	.last_deco_stop_in_mtr =  0,
-	.gf_high = 0.75,
-	.gf_low = 0.35,
 	.gf_low_position_min = 1.0,
-	.gf_low_at_maxdepth = false
 };
 
 //! Option structure for VPM-B decompression.
@@ -66,7 +58,6 @@ struct vpmb_config {
 	double skin_compression_gammaC;   //! Skin compression gammaC (N / bar = m2).
 	double regeneration_time;         //! Time needed for the bubble to regenerate to the start radius (min).
 	double other_gases_pressure;      //! Always present pressure of other gasses in tissues (bar).
-	short conservatism;		  //! VPM-B conservatism level (0-4)
 };
 
 struct vpmb_config vpmb_config = {
@@ -78,7 +69,14 @@ struct vpmb_config vpmb_config = {
 	.skin_compression_gammaC = 2.6040525,	// = 0.257 N/msw
 	.regeneration_time = 20160.0,
 	.other_gases_pressure = 0.1359888,
-	.conservatism = 3
+};
+
+//! The settings of calculations that don't bring their own, see clear_deco()
+static struct deco_settings default_deco_settings = {
+	.gf_low = 0.35,
+	.gf_high = 0.75,
+	.gf_low_at_maxdepth = false,
+	.vpmb_conservatism = 3
 };
 
 const double buehlmann_N2_a[] = { 1.1696, 1.0, 0.8618, 0.7562,
@@ -153,45 +151,19 @@ const double vpmb_conservatism_lvls[] = { 1.0, 1.05, 1.12, 1.22, 1.35 };
 #define DECO_STOPS_MULTIPLIER_MM 3000.0
 #define NITROGEN_FRACTION 0.79
 
-double tissue_n2_sat[16];
-double tissue_he_sat[16];
-int ci_pointing_to_guiding_tissue;
-double gf_low_pressure_this_dive;
-#define TISSUE_ARRAY_SZ sizeof(tissue_n2_sat)
-
-double tolerated_by_tissue[16];
-double tissue_inertgas_saturation[16];
-double buehlmann_inertgas_a[16], buehlmann_inertgas_b[16];
-
-double max_n2_crushing_pressure[16];
-double max_he_crushing_pressure[16];
-
-double crushing_onset_tension[16];            // total inert gas tension in the t* moment
-double n2_regen_radius[16];                   // rs
-double he_regen_radius[16];
-double max_ambient_pressure;                  // last moment we were descending
-
-double bottom_n2_gradient[16];
-double bottom_he_gradient[16];
-
-double initial_n2_gradient[16];
-double initial_he_gradient[16];
+#define TISSUE_ARRAY_SZ sizeof(ds->tissue_n2_sat)
 
-int sumx, sum1;
-long sumxx;
-double sumy, sumxy;
-
-double get_crit_radius_He()
+static double get_crit_radius_He(const struct deco_state *ds)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (ds->settings.vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[ds->settings.vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_He;
 }
 
-double get_crit_radius_N2()
+static double get_crit_radius_N2(const struct deco_state *ds)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (ds->settings.vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[ds->settings.vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_N2;
 }
 
@@ -214,9 +186,9 @@ double solve_cubic2(double B, double C)
 // This is a simplified formula avoiding radii. It uses the fact that Boyle's law says
 // pV = (G + P_amb) / G^3 is constant to solve for the new gradient G.
 
-double update_gradient(double next_stop_pressure, double first_gradient)
+double update_gradient(struct deco_state *ds, double next_stop_pressure, double first_gradient)
 {
-	double B = cube(first_gradient) / (first_ceiling_pressure.mbar / 1000.0 + first_gradient);
+	double B = cube(first_gradient) / (ds->first_ceiling_pressure.mbar / 1000.0 + first_gradient);
 	double C = next_stop_pressure * B;
 
 	double new_gradient = solve_cubic2(B, C);
@@ -226,72 +198,72 @@ double update_gradient(double next_stop_pressure, double first_gradient)
 	return new_gradient;
 }
 
-double vpmb_tolerated_ambient_pressure(double reference_pressure, int ci)
+double vpmb_tolerated_ambient_pressure(struct deco_state *ds, double reference_pressure, int ci)
 {
 	double n2_gradient, he_gradient, total_gradient;
 
-	if (reference_pressure >= first_ceiling_pressure.mbar / 1000.0 || !first_ceiling_pressure.mbar) {
-		n2_gradient = bottom_n2_gradient[ci];
-		he_gradient = bottom_he_gradient[ci];
+	if (reference_pressure >= ds->first_ceiling_pressure.mbar / 1000.0 || !ds->first_ceiling_pressure.mbar) {
+		n2_gradient = ds->bottom_n2_gradient[ci];
+		he_gradient = ds->bottom_he_gradient[ci];
 	} else {
-		n2_gradient = update_gradient(reference_pressure, bottom_n2_gradient[ci]);
-		he_gradient = update_gradient(reference_pressure, bottom_he_gradient[ci]);
+		n2_gradient = update_gradient(ds, reference_pressure, ds->bottom_n2_gradient[ci]);
+		he_gradient = update_gradient(ds, reference_pressure, ds->bottom_he_gradient[ci]);
 	}
 
-	total_gradient = ((n2_gradient * tissue_n2_sat[ci]) + (he_gradient * tissue_he_sat[ci])) / (tissue_n2_sat[ci] + tissue_he_sat[ci]);
+	total_gradient = ((n2_gradient * ds->tissue_n2_sat[ci]) + (he_gradient * ds->tissue_he_sat[ci])) / (ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci]);
 
-	return tissue_n2_sat[ci] + tissue_he_sat[ci] + vpmb_config.other_gases_pressure - total_gradient;
+	return ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci] + vpmb_config.other_gases_pressure - total_gradient;
 }
 
 
-double tissue_tolerance_calc(const struct dive *dive, double pressure)
+double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, double pressure)
 {
 	int ci = -1;
 	double ret_tolerance_limit_ambient_pressure = 0.0;
-	double gf_high = buehlmann_config.gf_high;
-	double gf_low = buehlmann_config.gf_low;
+	double gf_high = ds->settings.gf_high;
+	double gf_low = ds->settings.gf_low;
 	double surface = get_surface_pressure_in_mbar(dive, true) / 1000.0;
 	double lowest_ceiling = 0.0;
 	double tissue_lowest_ceiling[16];
 
 	for (ci = 0; ci < 16; ci++) {
-		buehlmann_inertgas_a[ci] = ((buehlmann_N2_a[ci] * tissue_n2_sat[ci]) + (buehlmann_He_a[ci] * tissue_he_sat[ci])) / tissue_inertgas_saturation[ci];
-		buehlmann_inertgas_b[ci] = ((buehlmann_N2_b[ci] * tissue_n2_sat[ci]) + (buehlmann_He_b[ci] * tissue_he_sat[ci])) / tissue_inertgas_saturation[ci];
+		ds->buehlmann_inertgas_a[ci] = ((buehlmann_N2_a[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_a[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
+		ds->buehlmann_inertgas_b[ci] = ((buehlmann_N2_b[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_b[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
 	}
 
-	if (decoMode() != VPMB) {
+	if (ds->settings.deco_mode != VPMB) {
 		for (ci = 0; ci < 16; ci++) {
 
-			/* tolerated = (tissue_inertgas_saturation - buehlmann_inertgas_a) * buehlmann_inertgas_b; */
+			/* tolerated = (ds->tissue_inertgas_saturation - ds->buehlmann_inertgas_a) * ds->buehlmann_inertgas_b; */
 
-			tissue_lowest_ceiling[ci] = (buehlmann_inertgas_b[ci] * tissue_inertgas_saturation[ci] - gf_low * buehlmann_inertgas_a[ci] * buehlmann_inertgas_b[ci]) /
-						     ((1.0 - buehlmann_inertgas_b[ci]) * gf_low + buehlmann_inertgas_b[ci]);
+			tissue_lowest_ceiling[ci] = (ds->buehlmann_inertgas_b[ci] * ds->tissue_inertgas_saturation[ci] - gf_low * ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci]) /
+						     ((1.0 - ds->buehlmann_inertgas_b[ci]) * gf_low + ds->buehlmann_inertgas_b[ci]);
 			if (tissue_lowest_ceiling[ci] > lowest_ceiling)
 				lowest_ceiling = tissue_lowest_ceiling[ci];
-			if (!buehlmann_config.gf_low_at_maxdepth) {
-				if (lowest_ceiling > gf_low_pressure_this_dive)
-					gf_low_pressure_this_dive = lowest_ceiling;
+			if (!ds->settings.gf_low_at_maxdepth) {
+				if (lowest_ceiling > ds->gf_low_pressure_this_dive)
+					ds->gf_low_pressure_this_dive = lowest_ceiling;
 			}
 		}
 		for (ci = 0; ci < 16; ci++) {
 			double tolerated;
 
-			if ((surface / buehlmann_inertgas_b[ci] + buehlmann_inertgas_a[ci] - surface) * gf_high + surface <
-			    (gf_low_pressure_this_dive / buehlmann_inertgas_b[ci] + buehlmann_inertgas_a[ci] - gf_low_pressure_this_dive) * gf_low + gf_low_pressure_this_dive)
-				tolerated = (-buehlmann_inertgas_a[ci] * buehlmann_inertgas_b[ci] * (gf_high * gf_low_pressure_this_dive - gf_low * surface) -
-					     (1.0 - buehlmann_inertgas_b[ci]) * (gf_high - gf_low) * gf_low_pressure_this_dive * surface +
-					     buehlmann_inertgas_b[ci] * (gf_low_pressure_this_dive - surface) * tissue_inertgas_saturation[ci]) /
-					    (-buehlmann_inertgas_a[ci] * buehlmann_inertgas_b[ci] * (gf_high - gf_low) +
-					     (1.0 - buehlmann_inertgas_b[ci]) * (gf_low * gf_low_pressure_this_dive - gf_high * surface) +
-					     buehlmann_inertgas_b[ci] * (gf_low_pressure_this_dive - surface));
+			if ((surface / ds->buehlmann_inertgas_b[ci] + ds->buehlmann_inertgas_a[ci] - surface) * gf_high + surface <
+			    (ds->gf_low_pressure_this_dive / ds->buehlmann_inertgas_b[ci] + ds->buehlmann_inertgas_a[ci] - ds->gf_low_pressure_this_dive) * gf_low + ds->gf_low_pressure_this_dive)
+				tolerated = (-ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci] * (gf_high * ds->gf_low_pressure_this_dive - gf_low * surface) -
+					     (1.0 - ds->buehlmann_inertgas_b[ci]) * (gf_high - gf_low) * ds->gf_low_pressure_this_dive * surface +
+					     ds->buehlmann_inertgas_b[ci] * (ds->gf_low_pressure_this_dive - surface) * ds->tissue_inertgas_saturation[ci]) /
+					    (-ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci] * (gf_high - gf_low) +
+					     (1.0 - ds->buehlmann_inertgas_b[ci]) * (gf_low * ds->gf_low_pressure_this_dive - gf_high * surface) +
+					     ds->buehlmann_inertgas_b[ci] * (ds->gf_low_pressure_this_dive - surface));
 			else
 				tolerated = ret_tolerance_limit_ambient_pressure;
 
 
-			tolerated_by_tissue[ci] = tolerated;
+			ds->tolerated_by_tissue[ci] = tolerated;
 
 			if (tolerated >= ret_tolerance_limit_ambient_pressure) {
-				ci_pointing_to_guiding_tissue = ci;
+				ds->ci_pointing_to_guiding_tissue = ci;
 				ret_tolerance_limit_ambient_pressure = tolerated;
 			}
 		}
@@ -305,84 +277,80 @@ double tissue_tolerance_calc(const struct dive *dive, double pressure)
 			reference_pressure = ret_tolerance_limit_ambient_pressure;
 			ret_tolerance_limit_ambient_pressure = 0.0;
 			for (ci = 0; ci < 16; ci++) {
-				double tolerated = vpmb_tolerated_ambient_pressure(reference_pressure, ci);
+				double tolerated = vpmb_tolerated_ambient_pressure(ds, reference_pressure, ci);
 				if (tolerated >= ret_tolerance_limit_ambient_pressure) {
-					ci_pointing_to_guiding_tissue = ci;
+					ds->ci_pointing_to_guiding_tissue = ci;
 					ret_tolerance_limit_ambient_pressure = tolerated;
 				}
-				tolerated_by_tissue[ci] = tolerated;
+				ds->tolerated_by_tissue[ci] = tolerated;
 			}
 		// We are doing ok if the gradient was computed within ten centimeters of the ceiling.
 		} while (fabs(ret_tolerance_limit_ambient_pressure - reference_pressure) > 0.01);
 
-		if (plot_depth) {
-			++sum1;
-			sumx += plot_depth;
-			sumxx += plot_depth * plot_depth;
+		if (ds->plot_depth) {
+			++ds->sum1;
+			ds->sumx += ds->plot_depth;
+			ds->sumxx += ds->plot_depth * ds->plot_depth;
 			double n2_gradient, he_gradient, total_gradient;
-			n2_gradient = update_gradient(depth_to_bar(plot_depth, &displayed_dive), bottom_n2_gradient[ci_pointing_to_guiding_tissue]);
-			he_gradient = update_gradient(depth_to_bar(plot_depth, &displayed_dive), bottom_he_gradient[ci_pointing_to_guiding_tissue]);
-			total_gradient = ((n2_gradient * tissue_n2_sat[ci_pointing_to_guiding_tissue]) + (he_gradient * tissue_he_sat[ci_pointing_to_guiding_tissue]))
-					/ (tissue_n2_sat[ci_pointing_to_guiding_tissue] + tissue_he_sat[ci_pointing_to_guiding_tissue]);
+			n2_gradient = update_gradient(ds, depth_to_bar(ds->plot_depth, dive), ds->bottom_n2_gradient[ds->ci_pointing_to_guiding_tissue]);
+			he_gradient = update_gradient(ds, depth_to_bar(ds->plot_depth, dive), ds->bottom_he_gradient[ds->ci_pointing_to_guiding_tissue]);
+			total_gradient = ((n2_gradient * ds->tissue_n2_sat[ds->ci_pointing_to_guiding_tissue]) + (he_gradient * ds->tissue_he_sat[ds->ci_pointing_to_guiding_tissue]))
+					/ (ds->tissue_n2_sat[ds->ci_pointing_to_guiding_tissue] + ds->tissue_he_sat[ds->ci_pointing_to_guiding_tissue]);
 
-			double buehlmann_gradient = (1.0 / buehlmann_inertgas_b[ci_pointing_to_guiding_tissue] - 1.0) * depth_to_bar(plot_depth, &displayed_dive) + buehlmann_inertgas_a[ci_pointing_to_guiding_tissue];
+			double buehlmann_gradient = (1.0 / ds->buehlmann_inertgas_b[ds->ci_pointing_to_guiding_tissue] - 1.0) * depth_to_bar(ds->plot_depth, dive) + ds->buehlmann_inertgas_a[ds->ci_pointing_to_guiding_tissue];
 			double gf = (total_gradient - vpmb_config.other_gases_pressure) / buehlmann_gradient;
-			sumxy += gf * plot_depth;
-			sumy += gf;
-			plot_depth = 0;
+			ds->sumxy += gf * ds->plot_depth;
+			ds->sumy += gf;
+			ds->plot_depth = 0;
 		}
 	}
 	return ret_tolerance_limit_ambient_pressure;
 }
 
 /*
- * Return buelman factor for a particular period and tissue index.
+ * Look up the Buehlmann factors of all compartments for a particular period.
  *
- * We cache the last factor, since we commonly call this with the
- * same values... We have a special "fixed cache" for the one second
- * case, although I wonder if that's even worth it considering the
- * more general-purpose cache.
+ * add_segment() is called with a handful of periods over and over again
+ * (the one second steps of the planner, the 20 second steps of the profile,
+ * the 60 second steps of the ascent), so we keep the factors for the last
+ * few periods around instead of evaluating 32 exponentials per call. One
+ * second has its own fixed table. The cache lives in the deco state, so
+ * concurrent calculations don't trample on each other.
  */
-struct factor_cache {
-	int last_period;
-	double last_factor;
-};
-
-double n2_factor(int period_in_seconds, int ci)
+static void get_factors(struct deco_state *ds, int period_in_seconds, const double **n2_f, const double **he_f)
 {
-	static struct factor_cache cache[16];
+	struct factor_cache *cache;
+	int i, ci;
 
-	if (period_in_seconds == 1)
-		return buehlmann_N2_factor_expositon_one_second[ci];
-
-	if (period_in_seconds != cache[ci].last_period) {
-		cache[ci].last_period = period_in_seconds;
-		// ln(2)/60 = 1.155245301e-02
-		cache[ci].last_factor = 1 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_N2_t_halflife[ci]);
+	if (period_in_seconds == 1) {
+		*n2_f = buehlmann_N2_factor_expositon_one_second;
+		*he_f = buehlmann_He_factor_expositon_one_second;
+		return;
 	}
 
-	return cache[ci].last_factor;
-}
-
-double he_factor(int period_in_seconds, int ci)
-{
-	static struct factor_cache cache[16];
-
-	if (period_in_seconds == 1)
-		return buehlmann_He_factor_expositon_one_second[ci];
+	for (i = 0; i < FACTOR_CACHE_SIZE; i++) {
+		cache = &ds->factor_cache[i];
+		if (cache->valid && cache->period == period_in_seconds)
+			goto found;
+	}
 
-	if (period_in_seconds != cache[ci].last_period) {
-		cache[ci].last_period = period_in_seconds;
+	cache = &ds->factor_cache[ds->factor_cache_next];
+	ds->factor_cache_next = (ds->factor_cache_next + 1) % FACTOR_CACHE_SIZE;
+	cache->valid = true;
+	cache->period = period_in_seconds;
+	for (ci = 0; ci < 16; ci++) {
 		// ln(2)/60 = 1.155245301e-02
-		cache[ci].last_factor = 1 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_He_t_halflife[ci]);
+		cache->n2[ci] = 1 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_N2_t_halflife[ci]);
+		cache->he[ci] = 1 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_He_t_halflife[ci]);
 	}
-
-	return cache[ci].last_factor;
+found:
+	*n2_f = cache->n2;
+	*he_f = cache->he;
 }
 
-double calc_surface_phase(double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant)
+static double calc_surface_phase(const struct deco_state *ds, double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant)
 {
-	double inspired_n2 = (surface_pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * NITROGEN_FRACTION;
+	double inspired_n2 = (surface_pressure - ((ds->settings.in_planner && ds->settings.deco_mode == VPMB) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * NITROGEN_FRACTION;
 
 	if (n2_pressure > inspired_n2)
 		return (he_pressure / he_time_constant + (n2_pressure - inspired_n2) / n2_time_constant) / (he_pressure + n2_pressure - inspired_n2);
@@ -396,17 +364,17 @@ double calc_surface_phase(double surface_pressure, double he_pressure, double n2
 	return 0;
 }
 
-void vpmb_start_gradient()
+void vpmb_start_gradient(struct deco_state *ds)
 {
 	int ci;
 
 	for (ci = 0; ci < 16; ++ci) {
-		initial_n2_gradient[ci] = bottom_n2_gradient[ci] = 2.0 * (vpmb_config.surface_tension_gamma / vpmb_config.skin_compression_gammaC) * ((vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma) / n2_regen_radius[ci]);
-		initial_he_gradient[ci] = bottom_he_gradient[ci] = 2.0 * (vpmb_config.surface_tension_gamma / vpmb_config.skin_compression_gammaC) * ((vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma) / he_regen_radius[ci]);
+		ds->initial_n2_gradient[ci] = ds->bottom_n2_gradient[ci] = 2.0 * (vpmb_config.surface_tension_gamma / vpmb_config.skin_compression_gammaC) * ((vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma) / ds->n2_regen_radius[ci]);
+		ds->initial_he_gradient[ci] = ds->bottom_he_gradient[ci] = 2.0 * (vpmb_config.surface_tension_gamma / vpmb_config.skin_compression_gammaC) * ((vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma) / ds->he_regen_radius[ci]);
 	}
 }
 
-void vpmb_next_gradient(double deco_time, double surface_pressure)
+void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_pressure)
 {
 	int ci;
 	double n2_b, n2_c;
@@ -415,18 +383,18 @@ void vpmb_next_gradient(double deco_time, double surface_pressure)
 	deco_time /= 60.0;
 
 	for (ci = 0; ci < 16; ++ci) {
-		desat_time = deco_time + calc_surface_phase(surface_pressure, tissue_he_sat[ci], tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci]);
+		desat_time = deco_time + calc_surface_phase(ds, surface_pressure, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci]);
 
-		n2_b = initial_n2_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
-		he_b = initial_he_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
+		n2_b = ds->initial_n2_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
+		he_b = ds->initial_he_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
 
-		n2_c = vpmb_config.surface_tension_gamma * vpmb_config.surface_tension_gamma * vpmb_config.crit_volume_lambda * max_n2_crushing_pressure[ci];
+		n2_c = vpmb_config.surface_tension_gamma * vpmb_config.surface_tension_gamma * vpmb_config.crit_volume_lambda * ds->max_n2_crushing_pressure[ci];
 		n2_c = n2_c / (vpmb_config.skin_compression_gammaC * vpmb_config.skin_compression_gammaC * desat_time);
-		he_c = vpmb_config.surface_tension_gamma * vpmb_config.surface_tension_gamma * vpmb_config.crit_volume_lambda * max_he_crushing_pressure[ci];
+		he_c = vpmb_config.surface_tension_gamma * vpmb_config.surface_tension_gamma * vpmb_config.crit_volume_lambda * ds->max_he_crushing_pressure[ci];
 		he_c = he_c / (vpmb_config.skin_compression_gammaC * vpmb_config.skin_compression_gammaC * desat_time);
 
-		bottom_n2_gradient[ci] = 0.5 * ( n2_b + sqrt(n2_b * n2_b - 4.0 * n2_c));
-		bottom_he_gradient[ci] = 0.5 * ( he_b + sqrt(he_b * he_b - 4.0 * he_c));
+		ds->bottom_n2_gradient[ci] = 0.5 * ( n2_b + sqrt(n2_b * n2_b - 4.0 * n2_c));
+		ds->bottom_he_gradient[ci] = 0.5 * ( he_b + sqrt(he_b * he_b - 4.0 * he_c));
 	}
 }
 
@@ -452,18 +420,18 @@ double solve_cubic(double A, double B, double C)
 }
 
 
-void nuclear_regeneration(double time)
+void nuclear_regeneration(struct deco_state *ds, double time)
 {
 	time /= 60.0;
 	int ci;
 	double crushing_radius_N2, crushing_radius_He;
 	for (ci = 0; ci < 16; ++ci) {
 		//rm
-		crushing_radius_N2 = 1.0 / (max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2());
-		crushing_radius_He = 1.0 / (max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He());
+		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2(ds));
+		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He(ds));
 		//rs
-		n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2() - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
-		he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He() - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2(ds) - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He(ds) - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
 	}
 }
 
@@ -483,8 +451,8 @@ double calc_inner_pressure(double crit_radius, double onset_tension, double curr
 	return onset_tension * onset_radius * onset_radius * onset_radius / (current_radius * current_radius * current_radius);
 }
 
-// Calculates the crushing pressure in the given moment. Updates crushing_onset_tension and critical radius if needed
-void calc_crushing_pressure(double pressure)
+// Calculates the crushing pressure in the given moment. Updates ds->crushing_onset_tension and critical radius if needed
+void calc_crushing_pressure(struct deco_state *ds, double pressure)
 {
 	int ci;
 	double gradient;
@@ -493,115 +461,247 @@ void calc_crushing_pressure(double pressure)
 	double n2_inner_pressure, he_inner_pressure;
 
 	for (ci = 0; ci < 16; ++ci) {
-		gas_tension = tissue_n2_sat[ci] + tissue_he_sat[ci] + vpmb_config.other_gases_pressure;
+		gas_tension = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci] + vpmb_config.other_gases_pressure;
 		gradient = pressure - gas_tension;
 
 		if (gradient <= vpmb_config.gradient_of_imperm) {	// permeable situation
 			n2_crushing_pressure = he_crushing_pressure = gradient;
-			crushing_onset_tension[ci] = gas_tension;
+			ds->crushing_onset_tension[ci] = gas_tension;
 		}
 		else {	// impermeable
-			if (max_ambient_pressure >= pressure)
+			if (ds->max_ambient_pressure >= pressure)
 				return;
 
-			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(), crushing_onset_tension[ci], pressure);
-			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(), crushing_onset_tension[ci], pressure);
+			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(ds), ds->crushing_onset_tension[ci], pressure);
+			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(ds), ds->crushing_onset_tension[ci], pressure);
 
 			n2_crushing_pressure = pressure - n2_inner_pressure;
 			he_crushing_pressure = pressure - he_inner_pressure;
 		}
-		max_n2_crushing_pressure[ci] = MAX(max_n2_crushing_pressure[ci], n2_crushing_pressure);
-		max_he_crushing_pressure[ci] = MAX(max_he_crushing_pressure[ci], he_crushing_pressure);
+		ds->max_n2_crushing_pressure[ci] = MAX(ds->max_n2_crushing_pressure[ci], n2_crushing_pressure);
+		ds->max_he_crushing_pressure[ci] = MAX(ds->max_he_crushing_pressure[ci], he_crushing_pressure);
 	}
-	max_ambient_pressure = MAX(pressure, max_ambient_pressure);
+	ds->max_ambient_pressure = MAX(pressure, ds->max_ambient_pressure);
 }
 
 /* add period_in_seconds at the given pressure and gas to the deco calculation */
-void add_segment(double pressure, const struct gasmix *gasmix, int period_in_seconds, int ccpo2, const struct dive *dive, int sac)
+void add_segment(struct deco_state *ds, double pressure, const struct gasmix *gasmix, int period_in_seconds, int ccpo2, const struct dive *dive, int sac)
 {
 	(void) sac;
 	int ci;
 	struct gas_pressures pressures;
+	const double *n2_f, *he_f;
+	const double satmult = buehlmann_config.satmult, desatmult = buehlmann_config.desatmult;
 
-	fill_pressures(&pressures, pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE),
+	fill_pressures(&pressures, pressure - ((ds->settings.in_planner && ds->settings.deco_mode == VPMB) ? WV_PRESSURE_SCHREINER : WV_PRESSURE),
 		       gasmix, (double) ccpo2 / 1000.0, dive->dc.divemode);
 
-	if (buehlmann_config.gf_low_at_maxdepth && pressure > gf_low_pressure_this_dive)
-		gf_low_pressure_this_dive = pressure;
+	if (ds->settings.gf_low_at_maxdepth && pressure > ds->gf_low_pressure_this_dive)
+		ds->gf_low_pressure_this_dive = pressure;
+
+	get_factors(ds, period_in_seconds, &n2_f, &he_f);
+
+	/* No calls and no branches in here: the compartments are independent
+	 * arrays, so the compiler can turn this into vector code. */
+	for (ci = 0; ci < 16; ci++) {
+		double pn2_oversat = pressures.n2 - ds->tissue_n2_sat[ci];
+		double phe_oversat = pressures.he - ds->tissue_he_sat[ci];
+		double n2_satmult = pn2_oversat > 0 ? satmult : desatmult;
+		double he_satmult = phe_oversat > 0 ? satmult : desatmult;
+
+		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * n2_f[ci];
+		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * he_f[ci];
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
+	}
+	if (ds->settings.deco_mode == VPMB)
+		calc_crushing_pressure(ds, pressure);
+	return;
+}
+
+/*
+ * The same as calling add_segment() repetitions times with identical
+ * arguments, but evaluated in closed form (the Haldane equation), so the
+ * cost doesn't depend on the number of repetitions. This is meant for
+ * looking ahead (e.g. for the NDL), so VPM-B crushing pressures are not
+ * updated.
+ *
+ * Returns false without touching the deco state if a compartment would
+ * take up one gas while releasing the other (or overshoot); callers can
+ * rely on each compartment loading or unloading monotonously otherwise.
+ */
+bool add_segment_repeated(struct deco_state *ds, double pressure, const struct gasmix *gasmix, int period_in_seconds, int repetitions, int ccpo2, const struct dive *dive)
+{
+	int ci;
+	struct gas_pressures pressures;
+	const double *n2_f, *he_f;
+	double n2_ratio[16], he_ratio[16];
+
+	fill_pressures(&pressures, pressure - ((ds->settings.in_planner && ds->settings.deco_mode == VPMB) ? WV_PRESSURE_SCHREINER : WV_PRESSURE),
+		       gasmix, (double) ccpo2 / 1000.0, dive->dc.divemode);
+
+	get_factors(ds, period_in_seconds, &n2_f, &he_f);
 
 	for (ci = 0; ci < 16; ci++) {
-		double pn2_oversat = pressures.n2 - tissue_n2_sat[ci];
-		double phe_oversat = pressures.he - tissue_he_sat[ci];
-		double n2_f = n2_factor(period_in_seconds, ci);
-		double he_f = he_factor(period_in_seconds, ci);
+		double pn2_oversat = pressures.n2 - ds->tissue_n2_sat[ci];
+		double phe_oversat = pressures.he - ds->tissue_he_sat[ci];
 		double n2_satmult = pn2_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
 		double he_satmult = phe_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
 
-		tissue_n2_sat[ci] += n2_satmult * pn2_oversat * n2_f;
-		tissue_he_sat[ci] += he_satmult * phe_oversat * he_f;
-		tissue_inertgas_saturation[ci] = tissue_n2_sat[ci] + tissue_he_sat[ci];
+		if ((pn2_oversat > 0 && phe_oversat < 0) || (pn2_oversat < 0 && phe_oversat > 0))
+			return false;
+		n2_ratio[ci] = 1.0 - n2_satmult * n2_f[ci];
+		he_ratio[ci] = 1.0 - he_satmult * he_f[ci];
+		if (n2_ratio[ci] < 0.0 || he_ratio[ci] < 0.0)
+			return false;
+	}
+
+	if (ds->settings.gf_low_at_maxdepth && pressure > ds->gf_low_pressure_this_dive)
+		ds->gf_low_pressure_this_dive = pressure;
 
+	for (ci = 0; ci < 16; ci++) {
+		ds->tissue_n2_sat[ci] = pressures.n2 - (pressures.n2 - ds->tissue_n2_sat[ci]) * pow(n2_ratio[ci], repetitions);
+		ds->tissue_he_sat[ci] = pressures.he - (pressures.he - ds->tissue_he_sat[ci]) * pow(he_ratio[ci], repetitions);
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
 	}
-	if(decoMode() == VPMB)
-		calc_crushing_pressure(pressure);
-	return;
+	return true;
 }
 
-void dump_tissues()
+void dump_tissues(struct deco_state *ds)
 {
 	int ci;
 	printf("N2 tissues:");
 	for (ci = 0; ci < 16; ci++)
-		printf(" %6.3e", tissue_n2_sat[ci]);
+		printf(" %6.3e", ds->tissue_n2_sat[ci]);
 	printf("\nHe tissues:");
 	for (ci = 0; ci < 16; ci++)
-		printf(" %6.3e", tissue_he_sat[ci]);
+		printf(" %6.3e", ds->tissue_he_sat[ci]);
 	printf("\n");
 }
 
-void clear_deco(double surface_pressure)
+void clear_deco(struct deco_state *ds, double surface_pressure, const struct deco_settings *settings)
 {
 	int ci;
+	struct deco_settings own;
+
+	if (settings)
+		own = *settings;
+	else
+		get_deco_settings(&own);
+
+	/* start from a blank slate - nothing from a previous calculation may leak into this one */
+	memset(ds, 0, sizeof(*ds));
+	ds->settings = own;
 	for (ci = 0; ci < 16; ci++) {
-		tissue_n2_sat[ci] = (surface_pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * N2_IN_AIR / 1000;
-		tissue_he_sat[ci] = 0.0;
-		max_n2_crushing_pressure[ci] = 0.0;
-		max_he_crushing_pressure[ci] = 0.0;
-		n2_regen_radius[ci] = get_crit_radius_N2();
-		he_regen_radius[ci] = get_crit_radius_He();
+		ds->tissue_n2_sat[ci] = (surface_pressure - ((ds->settings.in_planner && ds->settings.deco_mode == VPMB) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * N2_IN_AIR / 1000;
+		ds->tissue_he_sat[ci] = 0.0;
+		ds->max_n2_crushing_pressure[ci] = 0.0;
+		ds->max_he_crushing_pressure[ci] = 0.0;
+		ds->n2_regen_radius[ci] = get_crit_radius_N2(ds);
+		ds->he_regen_radius[ci] = get_crit_radius_He(ds);
 	}
-	gf_low_pressure_this_dive = surface_pressure;
-	if (!buehlmann_config.gf_low_at_maxdepth)
-		gf_low_pressure_this_dive += buehlmann_config.gf_low_position_min;
-	max_ambient_pressure = 0.0;
+	ds->gf_low_pressure_this_dive = surface_pressure;
+	if (!ds->settings.gf_low_at_maxdepth)
+		ds->gf_low_pressure_this_dive += buehlmann_config.gf_low_position_min;
+	ds->max_ambient_pressure = 0.0;
+}
+
+void save_deco_snapshot(const struct deco_state *ds, struct deco_snapshot *snapshot)
+{
+	memcpy(snapshot->tissue_n2_sat, ds->tissue_n2_sat, TISSUE_ARRAY_SZ);
+	memcpy(snapshot->tissue_he_sat, ds->tissue_he_sat, TISSUE_ARRAY_SZ);
+	snapshot->gf_low_pressure_this_dive = ds->gf_low_pressure_this_dive;
+	snapshot->ci_pointing_to_guiding_tissue = ds->ci_pointing_to_guiding_tissue;
+}
+
+void restore_deco_snapshot(struct deco_state *ds, const struct deco_snapshot *snapshot)
+{
+	memcpy(ds->tissue_n2_sat, snapshot->tissue_n2_sat, TISSUE_ARRAY_SZ);
+	memcpy(ds->tissue_he_sat, snapshot->tissue_he_sat, TISSUE_ARRAY_SZ);
+	ds->gf_low_pressure_this_dive = snapshot->gf_low_pressure_this_dive;
+	ds->ci_pointing_to_guiding_tissue = snapshot->ci_pointing_to_guiding_tissue;
+}
+
+/*
+ * A checkpoint only holds what add_segment() changes in Buehlmann mode,
+ * so it can't stand in for replaying a dive in VPM-B mode (crushing
+ * pressures) or with a different gf_low_at_maxdepth setting.
+ */
+void save_deco_checkpoint(const struct deco_state *ds, struct deco_checkpoint *checkpoint)
+{
+	save_deco_snapshot(ds, &checkpoint->snapshot);
+	checkpoint->gf_low_at_maxdepth = ds->settings.gf_low_at_maxdepth;
+	checkpoint->valid = ds->settings.deco_mode != VPMB;
+}
+
+bool deco_checkpoint_usable(const struct deco_checkpoint *checkpoint, const struct deco_settings *settings)
+{
+	return checkpoint->valid && settings->deco_mode != VPMB &&
+	       checkpoint->gf_low_at_maxdepth == settings->gf_low_at_maxdepth;
+}
+
+void restore_deco_checkpoint(struct deco_state *ds, const struct deco_checkpoint *checkpoint)
+{
+	int ci;
+
+	restore_deco_snapshot(ds, &checkpoint->snapshot);
+	for (ci = 0; ci < 16; ci++)
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
 }
 
-void cache_deco_state(char **cached_datap)
+void cache_deco_state(struct deco_state *ds, char **cached_datap)
 {
 	char *data = *cached_datap;
 
 	if (!data) {
-		data = malloc(2 * TISSUE_ARRAY_SZ + sizeof(double) + sizeof(int));
+		data = malloc(sizeof(struct deco_snapshot));
 		*cached_datap = data;
 	}
-	memcpy(data, tissue_n2_sat, TISSUE_ARRAY_SZ);
-	data += TISSUE_ARRAY_SZ;
-	memcpy(data, tissue_he_sat, TISSUE_ARRAY_SZ);
-	data += TISSUE_ARRAY_SZ;
-	memcpy(data, &gf_low_pressure_this_dive, sizeof(double));
-	data += sizeof(double);
-	memcpy(data, &ci_pointing_to_guiding_tissue, sizeof(int));
+	save_deco_snapshot(ds, (struct deco_snapshot *)data);
+}
+
+void restore_deco_state(struct deco_state *ds, char *data)
+{
+	restore_deco_snapshot(ds, (struct deco_snapshot *)data);
 }
 
-void restore_deco_state(char *data)
+/*
+ * The compartments that are taking up an inert gas at this pressure and gas
+ * are the ones that get worse the longer we stay. Load them up to what they
+ * can reach here (at most) and return the highest ambient pressure they
+ * tolerate then, or 0 if there are none. As long as that is no problem,
+ * staying longer can only help.
+ */
+double ongassing_tolerance_limit(const struct deco_state *ds, double pressure, const struct gasmix *gasmix, int ccpo2, const struct dive *dive)
 {
-	memcpy(tissue_n2_sat, data, TISSUE_ARRAY_SZ);
-	data += TISSUE_ARRAY_SZ;
-	memcpy(tissue_he_sat, data, TISSUE_ARRAY_SZ);
-	data += TISSUE_ARRAY_SZ;
-	memcpy(&gf_low_pressure_this_dive, data, sizeof(double));
-	data += sizeof(double);
-	memcpy(&ci_pointing_to_guiding_tissue, data, sizeof(int));
+	int ci;
+	struct gas_pressures pressures;
+	struct deco_state limit = *ds;
+	bool ongassing[16];
+	bool any = false;
+	double tolerance = 0.0;
+
+	fill_pressures(&pressures, pressure - ((ds->settings.in_planner && ds->settings.deco_mode == VPMB) ? WV_PRESSURE_SCHREINER : WV_PRESSURE),
+		       gasmix, (double) ccpo2 / 1000.0, dive->dc.divemode);
+
+	for (ci = 0; ci < 16; ci++) {
+		ongassing[ci] = pressures.n2 > ds->tissue_n2_sat[ci] || pressures.he > ds->tissue_he_sat[ci];
+		if (!ongassing[ci])
+			continue;
+		any = true;
+		limit.tissue_n2_sat[ci] = MAX(pressures.n2, ds->tissue_n2_sat[ci]);
+		limit.tissue_he_sat[ci] = MAX(pressures.he, ds->tissue_he_sat[ci]);
+		limit.tissue_inertgas_saturation[ci] = limit.tissue_n2_sat[ci] + limit.tissue_he_sat[ci];
+	}
+	if (!any)
+		return 0.0;
+
+	limit.plot_depth = 0;
+	tissue_tolerance_calc(&limit, dive, pressure);
+	for (ci = 0; ci < 16; ci++) {
+		if (ongassing[ci] && limit.tolerated_by_tissue[ci] > tolerance)
+			tolerance = limit.tolerated_by_tissue[ci];
+	}
+	return tolerance;
 }
 
 int deco_allowed_depth(double tissues_tolerance, double surface_pressure, struct dive *dive, bool smooth)
@@ -623,63 +723,83 @@ int deco_allowed_depth(double tissues_tolerance, double surface_pressure, struct
 	return depth;
 }
 
-void set_gf(short gflow, short gfhigh, bool gf_low_at_maxdepth)
+void set_deco_settings_gf(struct deco_settings *settings, short gflow, short gfhigh, bool gf_low_at_maxdepth)
 {
 	if (gflow != -1)
-		buehlmann_config.gf_low = (double)gflow / 100.0;
+		settings->gf_low = (double)gflow / 100.0;
 	if (gfhigh != -1)
-		buehlmann_config.gf_high = (double)gfhigh / 100.0;
-	buehlmann_config.gf_low_at_maxdepth = gf_low_at_maxdepth;
+		settings->gf_high = (double)gfhigh / 100.0;
+	settings->gf_low_at_maxdepth = gf_low_at_maxdepth;
 }
 
-void set_vpmb_conservatism(short conservatism)
+void set_deco_settings_vpmb_conservatism(struct deco_settings *settings, short conservatism)
 {
 	if (conservatism < 0)
-		vpmb_config.conservatism = 0;
+		settings->vpmb_conservatism = 0;
 	else if (conservatism > 4)
-		vpmb_config.conservatism = 4;
+		settings->vpmb_conservatism = 4;
 	else
-		vpmb_config.conservatism = conservatism;
+		settings->vpmb_conservatism = conservatism;
+}
+
+/* The defaults together with the deco mode of the moment. decoMode() and
+ * in_planner() look at the application state, so take the settings on the
+ * main thread and hand them to calculations that run on other threads. */
+void get_deco_settings(struct deco_settings *settings)
+{
+	*settings = default_deco_settings;
+	settings->deco_mode = decoMode();
+	settings->in_planner = in_planner();
+}
+
+void set_gf(short gflow, short gfhigh, bool gf_low_at_maxdepth)
+{
+	set_deco_settings_gf(&default_deco_settings, gflow, gfhigh, gf_low_at_maxdepth);
+}
+
+void set_vpmb_conservatism(short conservatism)
+{
+	set_deco_settings_vpmb_conservatism(&default_deco_settings, conservatism);
 }
 
-double get_gf(double ambpressure_bar, const struct dive *dive)
+double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive)
 {
 	double surface_pressure_bar = get_surface_pressure_in_mbar(dive, true) / 1000.0;
-	double gf_low = buehlmann_config.gf_low;
-	double gf_high = buehlmann_config.gf_high;
+	double gf_low = ds->settings.gf_low;
+	double gf_high = ds->settings.gf_high;
 	double gf;
-	if (gf_low_pressure_this_dive > surface_pressure_bar)
+	if (ds->gf_low_pressure_this_dive > surface_pressure_bar)
 		gf = MAX((double)gf_low, (ambpressure_bar - surface_pressure_bar) /
-			(gf_low_pressure_this_dive - surface_pressure_bar) * (gf_low - gf_high) + gf_high);
+			(ds->gf_low_pressure_this_dive - surface_pressure_bar) * (gf_low - gf_high) + gf_high);
 	else
 		gf = gf_low;
 	return gf;
 }
 
-double regressiona()
+double regressiona(struct deco_state *ds)
 {
-	if (sum1 > 1) {
-		double avxy = sumxy / sum1;
-		double avx = (double)sumx / sum1;
-		double avy = sumy / sum1;
-		double avxx = (double) sumxx / sum1;
+	if (ds->sum1 > 1) {
+		double avxy = ds->sumxy / ds->sum1;
+		double avx = (double)ds->sumx / ds->sum1;
+		double avy = ds->sumy / ds->sum1;
+		double avxx = (double) ds->sumxx / ds->sum1;
 		return (avxy - avx * avy) / (avxx - avx*avx);
 	}
 	else
 		return 0.0;
 }
 
-double regressionb()
+double regressionb(struct deco_state *ds)
 {
-	if (sum1)
-		return sumy / sum1 - sumx * regressiona() / sum1;
+	if (ds->sum1)
+		return ds->sumy / ds->sum1 - ds->sumx * regressiona(ds) / ds->sum1;
 	else
 		return 0.0;
 }
 
-void reset_regression()
+void reset_regression(struct deco_state *ds)
 {
-	sumx = sum1 = 0;
-	sumxx = 0L;
-	sumy = sumxy = 0.0;
+	ds->sumx = ds->sum1 = 0;
+	ds->sumxx = 0L;
+	ds->sumy = ds->sumxy = 0.0;
 }
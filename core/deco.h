@@ -1,19 +1,131 @@
 #ifndef DECO_H
 #define DECO_H
 
+#include "units.h"
+#include "pref.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-extern double tolerated_by_tissue[];
-extern double buehlmann_N2_t_halflife[];
-extern double tissue_inertgas_saturation[16];
-extern double buehlmann_inertgas_a[16], buehlmann_inertgas_b[16];
-extern double gf_low_pressure_this_dive;
+struct dive;
+struct gasmix;
+
+#define FACTOR_CACHE_SIZE 4
+
+/* Buehlmann factors of all compartments for one period */
+struct factor_cache {
+	bool valid;
+	int period;
+	double n2[16];
+	double he[16];
+};
+
+/* The user's choices that go into a calculation. Most calculations use
+ * the defaults set with set_gf() and set_vpmb_conservatism(), but e.g.
+ * the planner brings its own, see clear_deco(). The deco mode is part of
+ * them, so that the calculation doesn't have to ask the GUI about it. */
+struct deco_settings {
+	double gf_low;			// gradient factor low (at bottom/start of deco calculation)
+	double gf_high;			// gradient factor high (at surface)
+	bool gf_low_at_maxdepth;	// if true, gf_low applies at max depth instead of at deepest ceiling
+	short vpmb_conservatism;	// VPM-B conservatism level (0-4)
+	enum deco_mode deco_mode;	// decoMode() when the settings were taken
+	bool in_planner;		// in_planner() when the settings were taken
+};
+
+/* Everything the Buehlmann and VPM-B calculations know about the diver.
+ * All functions that load tissues or evaluate ceilings operate on one of
+ * these, so independent calculations can run side by side (e.g. on several
+ * threads). Initialize it with clear_deco() or init_decompression(). */
+struct deco_state {
+	struct deco_settings settings;
+
+	double tissue_n2_sat[16];
+	double tissue_he_sat[16];
+	double tolerated_by_tissue[16];
+	double tissue_inertgas_saturation[16];
+	double buehlmann_inertgas_a[16];
+	double buehlmann_inertgas_b[16];
+
+	double max_n2_crushing_pressure[16];
+	double max_he_crushing_pressure[16];
+
+	double crushing_onset_tension[16];	// total inert gas tension in the t* moment
+	double n2_regen_radius[16];		// rs
+	double he_regen_radius[16];
+	double max_ambient_pressure;		// last moment we were descending
+
+	double bottom_n2_gradient[16];
+	double bottom_he_gradient[16];
+
+	double initial_n2_gradient[16];
+	double initial_he_gradient[16];
+
+	pressure_t first_ceiling_pressure;
+	pressure_t max_bottom_ceiling_pressure;
+	int ci_pointing_to_guiding_tissue;
+	double gf_low_pressure_this_dive;
+
+	/* linear regression of the VPM-B gradients, expressed as gradient factors */
+	int plot_depth;
+	int sumx, sum1;
+	long sumxx;
+	double sumy, sumxy;
+
+	struct factor_cache factor_cache[FACTOR_CACHE_SIZE];
+	int factor_cache_next;
+};
+
+/* The part of a deco state that has to be put back after looking ahead,
+ * e.g. after simulating an ascent. Cheap enough to keep on the stack. */
+struct deco_snapshot {
+	double tissue_n2_sat[16];
+	double tissue_he_sat[16];
+	double gf_low_pressure_this_dive;
+	int ci_pointing_to_guiding_tissue;
+};
+
+/* The tissues at the end of a dive. Kept with the dive, so that the dives
+ * following it don't have to replay it, see init_decompression() */
+struct deco_checkpoint {
+	bool valid;
+	bool gf_low_at_maxdepth;
+	int prev_id;			// the previous dive of the series, 0 if there is none
+	timestamp_t when, lasttime;
+	int duration;
+	struct deco_snapshot snapshot;
+};
+
+/* What the dive list shows of the deco of a dive, from a quick and coarse
+ * calculation on another thread, see preview_dive_deco() */
+struct deco_preview {
+	bool valid;			// cleared by invalidate_dive_cache()
+	bool pending;			// being calculated, also cleared by invalidate_dive_cache()
+	int prev_id;			// the dive before in the same series, 0 if there is none
+	struct deco_settings settings;
+	int max_ceiling;		// mm
+	int surface_gf;			// percent, of the leading compartment when surfacing
+	int deco_time;			// seconds with a ceiling
+};
+
+extern const double buehlmann_N2_t_halflife[];
 
 extern int deco_allowed_depth(double tissues_tolerance, double surface_pressure, struct dive *dive, bool smooth);
 
-double get_gf(double ambpressure_bar, const struct dive *dive);
+void get_deco_settings(struct deco_settings *settings);
+void set_deco_settings_gf(struct deco_settings *settings, short gflow, short gfhigh, bool gf_low_at_maxdepth);
+void set_deco_settings_vpmb_conservatism(struct deco_settings *settings, short conservatism);
+double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive);
+double regressiona(struct deco_state *ds);
+double regressionb(struct deco_state *ds);
+void reset_regression(struct deco_state *ds);
+void save_deco_snapshot(const struct deco_state *ds, struct deco_snapshot *snapshot);
+void restore_deco_snapshot(struct deco_state *ds, const struct deco_snapshot *snapshot);
+void save_deco_checkpoint(const struct deco_state *ds, struct deco_checkpoint *checkpoint);
+bool deco_checkpoint_usable(const struct deco_checkpoint *checkpoint, const struct deco_settings *settings);
+void restore_deco_checkpoint(struct deco_state *ds, const struct deco_checkpoint *checkpoint);
+double ongassing_tolerance_limit(const struct deco_state *ds, double pressure, const struct gasmix *gasmix, int ccpo2, const struct dive *dive);
 
 #ifdef __cplusplus
 }
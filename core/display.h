@@ -25,9 +25,35 @@ struct plot_info {
 	double endtempcoord;
 	double maxpp;
 	bool has_ndl;
+	/* The time stamps of the entries never go backwards - set by analyze_plot_info() */
+	bool in_order;
 	struct plot_data *entry;
+	/* Optional columns with 16 values (one per tissue) for every entry.
+	 * Only the ones requested in "columns" before create_plot_info_new()
+	 * get allocated and calculated, the others stay NULL. */
+	unsigned int columns;
+	int *ceilings;
+	int *percentages;
+	/* When this is set and returns true, calculate_deco_information()
+	 * gives up and leaves the rest of the plot info as it is. It gets
+	 * called with cancel_data, from the thread doing the calculation */
+	bool (*cancelled)(void *cancel_data);
+	void *cancel_data;
 };
 
+#define PLOT_TISSUE_CEILINGS (1 << 0)
+#define PLOT_TISSUE_PERCENTAGES (1 << 1)
+
+static inline int *plot_tissue_ceilings(const struct plot_info *pi, int idx)
+{
+	return pi->ceilings ? pi->ceilings + 16 * idx : NULL;
+}
+
+static inline int *plot_tissue_percentages(const struct plot_info *pi, int idx)
+{
+	return pi->percentages ? pi->percentages + 16 * idx : NULL;
+}
+
 typedef enum {
 	SC_SCREEN,
 	SC_PRINT
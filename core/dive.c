@@ -385,12 +385,11 @@ static void copy_pl(struct picture *sp, struct picture *dp)
 	dp->hash = copy_string(sp->hash);
 }
 
-/* copy an element in a list of tags */
+/* copy an element in a list of tags - the tags themselves belong to
+ * g_tag_list and are shared by all dives, see taglist_add_tag() */
 static void copy_tl(struct tag_entry *st, struct tag_entry *dt)
 {
-	dt->tag = malloc(sizeof(struct divetag));
-	dt->tag->name = copy_string(st->tag->name);
-	dt->tag->source = copy_string(st->tag->source);
+	dt->tag = st->tag;
 }
 
 /* Clear everything but the first element;
@@ -448,11 +447,16 @@ void clear_dive(struct dive *d)
  * any impact on the source */
 void copy_dive(struct dive *s, struct dive *d)
 {
+	/* d must not go back to a cache generation it had before, or what was
+	 * cached for that would be taken for the new contents */
+	unsigned int generation = MAX(s->cache_generation, d->cache_generation);
+
 	clear_dive(d);
 	/* simply copy things over, but then make actual copies of the
 	 * relevant components that are referenced through pointers,
 	 * so all the strings and the structured lists */
 	*d = *s;
+	d->cache_generation = generation;
 	invalidate_dive_cache(d);
 	d->buddy = copy_string(s->buddy);
 	d->divemaster = copy_string(s->divemaster);
@@ -500,7 +504,7 @@ void selective_copy_dive(struct dive *s, struct dive *d, struct dive_components
 	if (what.visibility)
 		d->visibility = s->visibility;
 	if (what.divesite)
-		d->dive_site_uuid = s->dive_site_uuid;
+		set_dive_site_uuid(d, s->dive_site_uuid);
 	if (what.tags)
 		STRUCTURED_LIST_COPY(struct tag_entry, s->tag_list, d->tag_list, copy_tl);
 	if (what.cylinders)
@@ -634,7 +638,8 @@ struct sample *prepare_sample(struct divecomputer *dc)
 		if (nr >= alloc_samples) {
 			struct sample *newsamples;
 
-			alloc_samples = (alloc_samples * 3) / 2 + 10;
+			/* fixup_dive() gives back what isn't used */
+			alloc_samples = alloc_samples ? alloc_samples * 2 : 64;
 			newsamples = realloc(dc->sample, alloc_samples * sizeof(struct sample));
 			if (!newsamples)
 				return NULL;
@@ -1522,6 +1527,24 @@ static void fixup_dc_gasswitch(struct dive *dive, struct divecomputer *dc)
 	}
 }
 
+/*
+ * prepare_sample() doubles the room for samples whenever it runs out, and
+ * samples are most of the memory a dive takes - once the dive computer is
+ * complete, give back what wasn't used.
+ */
+static void fixup_dc_samples(struct divecomputer *dc)
+{
+	struct sample *samples;
+
+	if (!dc->samples || dc->alloc_samples <= dc->samples)
+		return;
+	samples = realloc(dc->sample, dc->samples * sizeof(struct sample));
+	if (!samples)
+		return;
+	dc->sample = samples;
+	dc->alloc_samples = dc->samples;
+}
+
 static void fixup_dive_dc(struct dive *dive, struct divecomputer *dc)
 {
 	/* Add device information to table */
@@ -1544,6 +1567,8 @@ static void fixup_dive_dc(struct dive *dive, struct divecomputer *dc)
 	fixup_dive_pressures(dive, dc);
 
 	fixup_dc_events(dc);
+
+	fixup_dc_samples(dc);
 }
 
 struct dive *fixup_dive(struct dive *dive)
@@ -1579,6 +1604,7 @@ struct dive *fixup_dive(struct dive *dive)
 		if (same_rounded_pressure(cyl->sample_end, cyl->end))
 			cyl->end.mbar = 0;
 	}
+	dive->cylinder_info.valid = false;
 	update_cylinder_related_info(dive);
 	for (i = 0; i < MAX_WEIGHTSYSTEMS; i++) {
 		weightsystem_t *ws = dive->weightsystem + i;
@@ -3022,7 +3048,7 @@ struct dive *merge_dives(struct dive *a, struct dive *b, int offset, bool prefer
 		interleave_dive_computers(&res->dc, &a->dc, &b->dc, offset);
 	else
 		join_dive_computers(&res->dc, &a->dc, &b->dc, 0);
-	res->dive_site_uuid = a->dive_site_uuid ?: b->dive_site_uuid;
+	set_dive_site_uuid(res, a->dive_site_uuid ?: b->dive_site_uuid);
 	fixup_dive(res);
 	return res;
 }
@@ -3523,10 +3549,9 @@ void dive_set_geodata_from_picture(struct dive *dive, struct picture *picture)
 	struct dive_site *ds = get_dive_site_by_uuid(dive->dive_site_uuid);
 	if (!dive_site_has_gps_location(ds) && (picture->latitude.udeg || picture->longitude.udeg)) {
 		if (ds) {
-			ds->latitude = picture->latitude;
-			ds->longitude = picture->longitude;
+			set_dive_site_gps(ds, picture->latitude, picture->longitude);
 		} else {
-			dive->dive_site_uuid = create_dive_site_with_gps("", picture->latitude, picture->longitude, dive->when);
+			set_dive_site_uuid(dive, create_dive_site_with_gps("", picture->latitude, picture->longitude, dive->when));
 			invalidate_dive_cache(dive);
 		}
 	}
@@ -53,6 +53,8 @@ extern "C" {
 #include <stdbool.h>
 #endif
 
+#include "deco.h"
+
 extern int last_xml_version;
 
 enum dive_comp_type {OC, CCR, PSCR, FREEDIVE, NUM_DC_TYPE};	// Flags (Open-circuit and Closed-circuit-rebreather) for setting dive computer type
@@ -179,6 +181,7 @@ static inline int interpolate(int a, int b, int part, int whole)
 void get_gas_string(const struct gasmix *gasmix, char *text, int len);
 const char *gasname(const struct gasmix *gasmix);
 
+/* the fields are ordered by size, so the compiler doesn't have to pad between them */
 struct sample                         // BASE TYPE BYTES  UNITS    RANGE      DESCRIPTION
 {                                     // --------- -----  -----    -----      -----------
 	duration_t time;               // uint32_t   4  seconds  (0-68 yrs)   elapsed dive time up to this sample
@@ -191,17 +194,17 @@ struct sample                         // BASE TYPE BYTES  UNITS    RANGE      DE
 	temperature_t temperature;     // int32_t    4  mdegrK   (0-2 MdegK)  ambient temperature
 	pressure_t cylinderpressure;   // int32_t    4    mbar   (0-2 Mbar)   main cylinder pressure
 	pressure_t o2cylinderpressure; // int32_t    4    mbar   (0-2 Mbar)   CCR o2 cylinder pressure (rebreather)
+	volume_t sac;                  // int32_t    4  ml/min                predefined SAC
 	o2pressure_t setpoint;         // uint16_t   2    mbar   (0-65 bar)   O2 partial pressure (will be setpoint)
 	o2pressure_t o2sensor[3];      // uint16_t   6    mbar   (0-65 bar)   Up to 3 PO2 sensor values (rebreather)
 	bearing_t bearing;             // int16_t    2  degrees  (-32k to 32k deg) compass bearing
 	uint8_t sensor;                // uint8_t    1  sensorID (0-255)      ID of cylinder pressure sensor
 	uint8_t cns;                   // uint8_t    1     %     (0-255 %)    cns% accumulated
 	uint8_t heartbeat;             // uint8_t    1  beats/m  (0-255)      heart rate measurement
-	volume_t sac;                  //            4  ml/min                predefined SAC
 	bool in_deco;                  // bool       1    y/n      y/n        this sample is part of deco
 	bool manually_entered;         // bool       1    y/n      y/n        this sample was entered by the user,
 				       //                                     not calculated when planning a dive
-};                      // Total size of structure: 57 bytes, excluding padding at end
+};                      // Total size of structure: 59 bytes, excluding padding at end
 
 struct divetag {
 	/*
@@ -289,6 +292,38 @@ struct divecomputer {
 	struct divecomputer *next;
 };
 
+/*
+ * Code that only reads the samples of a dive computer gets them through
+ * these rather than from dc->sample[] - so they can be stored differently
+ * later without changing it, e.g. with the channels that most dive computers
+ * don't have kept apart from time and depth.
+ */
+#define DC_SAMPLE_CHANNEL(type, channel) \
+	static inline type dc_sample_##channel(const struct divecomputer *dc, int idx) { return dc->sample[idx].channel; }
+DC_SAMPLE_CHANNEL(duration_t, time)
+DC_SAMPLE_CHANNEL(depth_t, depth)
+DC_SAMPLE_CHANNEL(duration_t, stoptime)
+DC_SAMPLE_CHANNEL(depth_t, stopdepth)
+DC_SAMPLE_CHANNEL(duration_t, ndl)
+DC_SAMPLE_CHANNEL(duration_t, tts)
+DC_SAMPLE_CHANNEL(duration_t, rbt)
+DC_SAMPLE_CHANNEL(bool, in_deco)
+DC_SAMPLE_CHANNEL(temperature_t, temperature)
+DC_SAMPLE_CHANNEL(pressure_t, cylinderpressure)
+DC_SAMPLE_CHANNEL(pressure_t, o2cylinderpressure)
+DC_SAMPLE_CHANNEL(uint8_t, sensor)
+DC_SAMPLE_CHANNEL(volume_t, sac)
+DC_SAMPLE_CHANNEL(o2pressure_t, setpoint)
+DC_SAMPLE_CHANNEL(bearing_t, bearing)
+DC_SAMPLE_CHANNEL(uint8_t, cns)
+DC_SAMPLE_CHANNEL(uint8_t, heartbeat)
+#undef DC_SAMPLE_CHANNEL
+
+static inline o2pressure_t dc_sample_o2sensor(const struct divecomputer *dc, int idx, int nr)
+{
+	return dc->sample[idx].o2sensor[nr];
+}
+
 #define MAX_CYLINDERS (8)
 #define MAX_WEIGHTSYSTEMS (6)
 #define W_IDX_PRIMARY 0
@@ -317,6 +352,17 @@ typedef struct dive_trip
 /* List of dive trips (sorted by date) */
 extern dive_trip_t *dive_trip_list;
 struct picture;
+
+/* What update_cylinder_related_info() based sac, otu and a calculated
+ * maxcns on, besides the dive itself */
+struct cylinder_info_cache {
+	bool valid;		// cleared by invalidate_dive_cache()
+	bool cns_calculated;	// cns and maxcns came from calculate_cns()
+	int prev_id;		// the dive whose CNS carried over, 0 if none
+	timestamp_t prev_end;
+	int prev_cns;
+};
+
 struct dive {
 	int number;
 	tripflag_t tripflag;
@@ -349,11 +395,20 @@ struct dive {
 	struct picture *picture_list;
 	int oxygen_cylinder_index, diluent_cylinder_index; // CCR dive cylinder indices
 	unsigned char git_id[20];
+	unsigned int cache_generation; // changes with every invalidate_dive_cache(), see copy_dive()
+	struct deco_checkpoint deco_checkpoint;
+	struct cylinder_info_cache cylinder_info;
+	struct deco_preview deco_preview;
 };
 
 static inline void invalidate_dive_cache(struct dive *dive)
 {
 	memset(dive->git_id, 0, 20);
+	dive->cache_generation++;
+	dive->deco_checkpoint.valid = false;
+	dive->cylinder_info.valid = false;
+	dive->deco_preview.valid = false;
+	dive->deco_preview.pending = false;
 }
 
 static inline bool dive_cache_is_valid(const struct dive *dive)
@@ -442,17 +497,17 @@ static inline int calculate_depth_to_mbar(int depth, pressure_t surface_pressure
 	return mbar;
 }
 
-static inline int depth_to_mbar(int depth, struct dive *dive)
+static inline int depth_to_mbar(int depth, const struct dive *dive)
 {
 	return calculate_depth_to_mbar(depth, dive->surface_pressure, dive->salinity);
 }
 
-static inline double depth_to_bar(int depth, struct dive *dive)
+static inline double depth_to_bar(int depth, const struct dive *dive)
 {
 	return depth_to_mbar(depth, dive) / 1000.0;
 }
 
-static inline double depth_to_atm(int depth, struct dive *dive)
+static inline double depth_to_atm(int depth, const struct dive *dive)
 {
 	return mbar_to_atm(depth_to_mbar(depth, dive));
 }
@@ -623,41 +678,11 @@ extern void delete_current_divecomputer(void);
 #define for_each_gps_location(_i, _x) \
 	for ((_i) = 0; ((_x) = get_gps_location(_i, &gps_location_table)) != NULL; (_i)++)
 
-static inline struct dive *get_dive_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return dive;
-}
-
-static inline int get_idx_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return i;
-}
+/* these go through an index of dive_table by dive id, see divelist.c */
+extern struct dive *get_dive_by_uniq_id(int id);
+extern int get_idx_by_uniq_id(int id);
+extern void update_dive_index(struct dive_table *table);
+extern void add_to_dive_index(struct dive_table *table, int idx);
 
 static inline bool dive_site_has_gps_location(struct dive_site *ds)
 {
@@ -827,17 +852,20 @@ extern void subsurface_command_line_exit(int *, char ***);
 
 #define FRACTION(n, x) ((unsigned)(n) / (x)), ((unsigned)(n) % (x))
 
-extern void add_segment(double pressure, const struct gasmix *gasmix, int period_in_seconds, int setpoint, const struct dive *dive, int sac);
-extern void clear_deco(double surface_pressure);
-extern void dump_tissues(void);
+struct deco_state;
+extern void add_segment(struct deco_state *ds, double pressure, const struct gasmix *gasmix, int period_in_seconds, int setpoint, const struct dive *dive, int sac);
+extern bool add_segment_repeated(struct deco_state *ds, double pressure, const struct gasmix *gasmix, int period_in_seconds, int repetitions, int setpoint, const struct dive *dive);
+struct deco_settings;
+extern void clear_deco(struct deco_state *ds, double surface_pressure, const struct deco_settings *settings);
+extern void dump_tissues(struct deco_state *ds);
 extern void set_gf(short gflow, short gfhigh, bool gf_low_at_maxdepth);
 extern void set_vpmb_conservatism(short conservatism);
-extern void cache_deco_state(char **datap);
-extern void restore_deco_state(char *data);
-extern void nuclear_regeneration(double time);
-extern void vpmb_start_gradient();
-extern void vpmb_next_gradient(double deco_time, double surface_pressure);
-extern double tissue_tolerance_calc(const struct dive *dive, double pressure);
+extern void cache_deco_state(struct deco_state *ds, char **datap);
+extern void restore_deco_state(struct deco_state *ds, char *data);
+extern void nuclear_regeneration(struct deco_state *ds, double time);
+extern void vpmb_start_gradient(struct deco_state *ds);
+extern void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_pressure);
+extern double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, double pressure);
 
 /* this should be converted to use our types */
 struct divedatapoint {
@@ -861,6 +889,7 @@ struct diveplan {
 	struct divedatapoint *dp;
 	int eff_gflow, eff_gfhigh;
 	unsigned int surface_interval;
+	struct plan_checkpoints *checkpoints; /* optional, see planner.h */
 };
 
 struct divedatapoint *plan_add_segment(struct diveplan *diveplan, int duration, int depth, int cylinderid, int po2, bool entered);
@@ -868,9 +897,11 @@ struct divedatapoint *create_dp(int time_incr, int depth, int cylinderid, int po
 #if DEBUG_PLAN
 void dump_plan(struct diveplan *diveplan);
 #endif
-bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool show_disclaimer);
-void calc_crushing_pressure(double pressure);
-void vpmb_start_gradient();
+bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, char **cached_datap, bool is_planner, bool show_disclaimer);
+bool calculate_plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, char **cached_datap, bool is_planner,
+		    const struct deco_settings *settings, int *error);
+void finish_plan(struct diveplan *diveplan, struct dive *dive, bool is_planner, bool show_disclaimer, int error);
+void calc_crushing_pressure(struct deco_state *ds, double pressure);
 
 void delete_single_dive(int idx);
 
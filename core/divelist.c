@@ -10,8 +10,11 @@
  * void get_dive_gas(struct dive *dive, int *o2_p, int *he_p, int *o2low_p)
  * int total_weight(struct dive *dive)
  * int get_divenr(struct dive *dive)
- * double init_decompression(struct dive *dive)
+ * struct dive *get_dive_by_uniq_id(int id)
+ * int get_idx_by_uniq_id(int id)
+ * unsigned int init_decompression(struct deco_state *ds, struct dive *dive, const struct deco_settings *settings)
  * void update_cylinder_related_info(struct dive *dive)
+ * void update_all_cylinder_related_info(void)
  * void dump_trip_list(void)
  * dive_trip_t *find_matching_trip(timestamp_t when)
  * void insert_trip(dive_trip_t **dive_trip_p)
@@ -41,6 +44,8 @@
 
 #include "dive.h"
 #include "divelist.h"
+#include "id-index.h"
+#include "deco.h"
 #include "display.h"
 #include "planner.h"
 #include "qthelperfromc.h"
@@ -221,6 +226,7 @@ static int calculate_cns(struct dive *dive)
 	 * Check if we did a dive 12 hours prior, and what cns we had from that.
 	 * Then apply ha 90min halftime to see whats left.
 	 */
+	dive->cylinder_info.prev_id = 0;
 	divenr = get_divenr(dive);
 	if (divenr) {
 		prev_dive = get_dive(divenr - 1);
@@ -228,6 +234,9 @@ static int calculate_cns(struct dive *dive)
 			endtime = prev_dive->when + prev_dive->duration.seconds;
 			if (dive->when < (endtime + 3600 * 12)) {
 				cns = calculate_cns(prev_dive);
+				dive->cylinder_info.prev_id = prev_dive->id;
+				dive->cylinder_info.prev_end = endtime;
+				dive->cylinder_info.prev_cns = prev_dive->cns;
 				cns = cns * 1 / pow(2, (dive->when - endtime) / (90.0 * 60.0));
 			}
 		}
@@ -309,7 +318,7 @@ static int calculate_sac(struct dive *dive)
 }
 
 /* for now we do this based on the first divecomputer */
-static void add_dive_to_deco(struct dive *dive)
+static void add_dive_to_deco(struct deco_state *ds, struct dive *dive)
 {
 	struct divecomputer *dc = &dive->dc;
 	int i;
@@ -325,22 +334,109 @@ static void add_dive_to_deco(struct dive *dive)
 
 		for (j = t0; j < t1; j++) {
 			int depth = interpolate(psample->depth.mm, sample->depth.mm, j - t0, t1 - t0);
-			add_segment(depth_to_bar(depth, dive),
+			add_segment(ds, depth_to_bar(depth, dive),
 					  &dive->cylinder[sample->sensor].gasmix, 1, sample->setpoint.mbar, dive, dive->sac);
 		}
 	}
 }
 
-int get_divenr(struct dive *dive)
+/*
+ * The index of dive_table by dive id, kept up to date by everything in
+ * here that moves dives around in the table, by record_dive_to_table() and
+ * sort_table(). Lookups only go through the index, so a change of the
+ * table that doesn't update it is a bug - DEBUG builds check every lookup
+ * against the table.
+ */
+static struct id_index dive_index;
+
+/* the dives of table moved around */
+void update_dive_index(struct dive_table *table)
+{
+	int idx;
+
+	if (table != &dive_table)
+		return;
+	id_index_clear(&dive_index);
+	for (idx = 0; idx < dive_table.nr; idx++)
+		id_index_set(&dive_index, dive_table.dives[idx]->id, idx);
+}
+
+/* the dive at idx was added to the end of table */
+void add_to_dive_index(struct dive_table *table, int idx)
+{
+	if (table == &dive_table)
+		id_index_set(&dive_index, dive_table.dives[idx]->id, idx);
+}
+
+/* the dives from idx on moved to another place in dive_table */
+static void reindex_dives_from(int idx)
+{
+	for (; idx < dive_table.nr; idx++)
+		id_index_set(&dive_index, dive_table.dives[idx]->id, idx);
+}
+
+/* give the dive at idx another id */
+static void set_dive_id(int idx, int id)
 {
+	struct dive *dive = get_dive(idx);
+
+	id_index_remove(&dive_index, dive->id, idx);
+	dive->id = id;
+	id_index_set(&dive_index, id, idx);
+}
+
+static int find_dive_idx(int id)
+{
+	int idx = id_index_get(&dive_index, id);
+
+#ifdef DEBUG
 	int i;
-	struct dive *d;
+	struct dive *dive;
+
+	for_each_dive (i, dive) {
+		if (dive->id == id)
+			break;
+	}
+	if (idx != (i < dive_table.nr ? i : -1)) {
+		fprintf(stderr, "The dive index has id %x at %d, the dive table at %d - try to fix the code\n", id, idx, i);
+		exit(1);
+	}
+#endif
+	return idx;
+}
+
+struct dive *get_dive_by_uniq_id(int id)
+{
+	int idx = find_dive_idx(id);
+
+#ifdef DEBUG
+	if (idx < 0) {
+		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
+		exit(1);
+	}
+#endif
+	return idx >= 0 ? dive_table.dives[idx] : NULL;
+}
+
+/* dive_table.nr if there is no such dive */
+int get_idx_by_uniq_id(int id)
+{
+	int idx = find_dive_idx(id);
+
+#ifdef DEBUG
+	if (idx < 0) {
+		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
+		exit(1);
+	}
+#endif
+	return idx >= 0 ? idx : dive_table.nr;
+}
+
+int get_divenr(struct dive *dive)
+{
 	// tempting as it may be, don't die when called with dive=NULL
 	if (dive)
-		for_each_dive(i, d) {
-			if (d->id == dive->id) // don't compare pointers, we could be passing in a copy of the dive
-				return i;
-		}
+		return find_dive_idx(dive->id); // don't compare pointers, we could be passing in a copy of the dive
 	return -1;
 }
 
@@ -359,23 +455,55 @@ int get_divesite_idx(struct dive_site *ds)
 
 static struct gasmix air = { .o2.permille = O2_IN_AIR, .he.permille = 0 };
 
+/* the dives of the series leading up to dive that init_decompression() adds, in this order */
+static bool dive_adds_to_deco(struct dive *dive, struct dive *pdive)
+{
+	/* skip dives from different trips */
+	if (dive->divetrip && dive->divetrip != pdive->divetrip)
+		return false;
+	/* Don't add future dives */
+	return pdive->when <= dive->when;
+}
+
+/* was this checkpoint taken after adding pdive to the dives of the same series as now? */
+static bool deco_checkpoint_matches(struct dive *pdive, int prev_id, const struct deco_settings *settings)
+{
+	const struct deco_checkpoint *checkpoint = &pdive->deco_checkpoint;
+
+	return deco_checkpoint_usable(checkpoint, settings) && checkpoint->prev_id == prev_id &&
+	       checkpoint->when == pdive->when && checkpoint->duration == pdive->duration.seconds;
+}
+
 /* take into account previous dives until there is a 48h gap between dives */
 /* return true if this is a repetitive dive */
-unsigned int init_decompression(struct dive *dive)
+/* settings is NULL for the default deco settings */
+unsigned int init_decompression(struct deco_state *ds, struct dive *dive, const struct deco_settings *settings)
 {
-	int i, divenr = -1;
+	int i, j, end, resume = -1, prev_id;
 	unsigned int surface_time;
 	timestamp_t when, lasttime = 0, laststart = 0;
 	bool deco_init = false;
+	bool use_checkpoints;
 	double surface_pressure;
+	struct deco_settings own;
 
 	if (!dive)
 		return false;
 
+	/* clear_deco() resets ds, which settings may point into */
+	if (settings)
+		own = *settings;
+	else
+		get_deco_settings(&own);
+	/* the surface intervals are added in the dive mode of this dive, and for PSCR
+	 * that makes a difference - so there is nothing to share with other dives.
+	 * Checkpoints can't stand in for dives in VPM-B mode, and not even writing
+	 * them then means the planner can replay dives on several threads at once */
+	use_checkpoints = dive->dc.divemode != PSCR && own.deco_mode != VPMB;
 	surface_pressure = get_surface_pressure_in_mbar(dive, true) / 1000.0;
-	divenr = get_divenr(dive);
+	i = get_divenr(dive);
+	end = i >= 0 ? i : dive_table.nr;
 	when = dive->when;
-	i = divenr;
 	if (i < 0) {
 		i = dive_table.nr - 1;
 		while (i >= 0 && get_dive(i)->when > when)
@@ -396,68 +524,142 @@ unsigned int init_decompression(struct dive *dive)
 		when = pdive->when;
 		lasttime = when + pdive->duration.seconds;
 	}
-	while (++i < (divenr >= 0 ? divenr : dive_table.nr)) {
+	/* Every dive remembers the tissues at its end. Pick up from the last one
+	 * that is still valid, i.e. that neither it nor a dive before it has been
+	 * changed and the series is still made up of the same dives */
+	prev_id = 0;
+	for (j = i + 1; use_checkpoints && j < end; j++) {
+		struct dive *pdive = get_dive(j);
+		if (!dive_adds_to_deco(dive, pdive))
+			continue;
+		if (!deco_checkpoint_matches(pdive, prev_id, &own))
+			break;
+		resume = j;
+		prev_id = pdive->id;
+	}
+	prev_id = 0;
+	while (++i < end) {
 		struct dive *pdive = get_dive(i);
-		/* again skip dives from different trips */
-		if (dive->divetrip && dive->divetrip != pdive->divetrip)
+		if (!dive_adds_to_deco(dive, pdive))
 			continue;
-		/* Don't add future dives */
-		if (pdive->when > dive->when)
-			continue;	/* This could be break if the divelist is always sorted */
 		surface_pressure = get_surface_pressure_in_mbar(pdive, true) / 1000.0;
 		if (!deco_init) {
-			clear_deco(surface_pressure);
+			clear_deco(ds, surface_pressure, &own);
 			deco_init = true;
 #if DECO_CALC_DEBUG & 2
-			dump_tissues();
+			dump_tissues(ds);
 #endif
 		}
+		if (i <= resume) {
+			if (i == resume) {
+				restore_deco_checkpoint(ds, &pdive->deco_checkpoint);
+				lasttime = pdive->deco_checkpoint.lasttime;
+			}
+			laststart = pdive->when;
+			prev_id = pdive->id;
+			continue;
+		}
 		if (pdive->when > lasttime) {
 			surface_time = pdive->when - lasttime;
 			lasttime = pdive->when + pdive->duration.seconds;
-			add_segment(surface_pressure, &air, surface_time, 0, dive, prefs.decosac);
+			add_segment(ds, surface_pressure, &air, surface_time, 0, dive, prefs.decosac);
 #if DECO_CALC_DEBUG & 2
 			printf("after surface intervall of %d:%02u\n", FRACTION(surface_time, 60));
-			dump_tissues();
+			dump_tissues(ds);
 #endif
 		}
-		add_dive_to_deco(pdive);
+		add_dive_to_deco(ds, pdive);
 		laststart = pdive->when;
 #if DECO_CALC_DEBUG & 2
 		printf("added dive #%d\n", pdive->number);
-		dump_tissues();
+		dump_tissues(ds);
 #endif
+		if (use_checkpoints) {
+			save_deco_checkpoint(ds, &pdive->deco_checkpoint);
+			pdive->deco_checkpoint.prev_id = prev_id;
+			pdive->deco_checkpoint.when = pdive->when;
+			pdive->deco_checkpoint.duration = pdive->duration.seconds;
+			pdive->deco_checkpoint.lasttime = lasttime;
+		}
+		prev_id = pdive->id;
 	}
 	/* add the final surface time */
 	if (lasttime && dive->when > lasttime) {
 		surface_time = dive->when - lasttime;
 		surface_pressure = get_surface_pressure_in_mbar(dive, true) / 1000.0;
-		add_segment(surface_pressure, &air, surface_time, 0, dive, prefs.decosac);
+		add_segment(ds, surface_pressure, &air, surface_time, 0, dive, prefs.decosac);
 #if DECO_CALC_DEBUG & 2
 		printf("after surface intervall of %d:%02u\n", FRACTION(surface_time, 60));
-		dump_tissues();
+		dump_tissues(ds);
 #endif
 	}
 	if (!deco_init) {
 		surface_pressure = get_surface_pressure_in_mbar(dive, true) / 1000.0;
-		clear_deco(surface_pressure);
+		clear_deco(ds, surface_pressure, &own);
 #if DECO_CALC_DEBUG & 2
 		printf("no previous dive\n");
-		dump_tissues();
+		dump_tissues(ds);
 #endif
 	}
 	// I do not dare to remove this call. We don't need the result but it might have side effects. Bummer.
-	tissue_tolerance_calc(dive, surface_pressure);
+	tissue_tolerance_calc(ds, dive, surface_pressure);
 	return surface_time;
 }
 
+/*
+ * The values only change with the dive (see invalidate_dive_cache()) and,
+ * for a calculated CNS, with the dive before it - which only
+ * update_all_cylinder_related_info() checks.
+ */
 void update_cylinder_related_info(struct dive *dive)
 {
-	if (dive != NULL) {
-		dive->sac = calculate_sac(dive);
-		dive->otu = calculate_otu(dive);
-		if (dive->maxcns == 0)
-			dive->maxcns = calculate_cns(dive);
+	struct cylinder_info_cache *cache;
+
+	if (dive == NULL)
+		return;
+	cache = &dive->cylinder_info;
+	if (cache->valid)
+		return;
+	dive->sac = calculate_sac(dive);
+	dive->otu = calculate_otu(dive);
+	/* a CNS we calculated ourselves is out of date as well */
+	if (cache->cns_calculated)
+		dive->cns = dive->maxcns = 0;
+	if (dive->maxcns == 0) {
+		cache->cns_calculated = !dive->cns;
+		dive->maxcns = calculate_cns(dive);
+	}
+	cache->valid = true;
+}
+
+/* is the CNS that calculate_cns() carried over into dive still what the dive before has? */
+static bool cns_carryover_matches(const struct dive *dive, const struct dive *prev_dive)
+{
+	const struct cylinder_info_cache *cache = &dive->cylinder_info;
+	timestamp_t endtime;
+
+	if (!prev_dive)
+		return cache->prev_id == 0;
+	endtime = prev_dive->when + prev_dive->duration.seconds;
+	if (dive->when >= endtime + 3600 * 12)
+		return cache->prev_id == 0;
+	return cache->prev_id == prev_dive->id && cache->prev_end == endtime && cache->prev_cns == prev_dive->cns;
+}
+
+/*
+ * update_cylinder_related_info() for all dives, oldest first, so that a
+ * calculated CNS gets updated when the dive it carried over from changed
+ * or another dive came before it.
+ */
+void update_all_cylinder_related_info(void)
+{
+	int i;
+	struct dive *dive;
+
+	for_each_dive (i, dive) {
+		if (dive->cylinder_info.cns_calculated && !cns_carryover_matches(dive, i ? get_dive(i - 1) : NULL))
+			dive->cylinder_info.valid = false;
+		update_cylinder_related_info(dive);
 	}
 }
 
@@ -762,9 +964,12 @@ void delete_single_dive(int idx)
 	remove_dive_from_trip(dive, false);
 	if (dive->selected)
 		deselect_dive(idx);
+	id_index_remove(&dive_index, dive->id, idx);
 	for (i = idx; i < dive_table.nr - 1; i++)
 		dive_table.dives[i] = dive_table.dives[i + 1];
 	dive_table.dives[--dive_table.nr] = NULL;
+	reindex_dives_from(idx);
+	invalidate_dive_site_counts();
 	/* free all allocations */
 	free(dive->dc.sample);
 	free((void *)dive->notes);
@@ -815,6 +1020,8 @@ void add_single_dive(int idx, struct dive *dive)
 		dive_table.dives[i] = dive;
 		dive = tmp;
 	}
+	reindex_dives_from(idx);
+	invalidate_dive_site_counts();
 }
 
 bool consecutive_selected()
@@ -894,7 +1101,7 @@ struct dive *merge_two_dives(struct dive *a, struct dive *b)
 	// now make sure that we keep the id of the first dive.
 	// why?
 	// because this way one of the previously selected ids is still around
-	res->id = id;
+	set_dive_id(get_divenr(res), id);
 
 	// renumber dives from merged one in advance by difference between
 	// merged dives numbers. Do not renumber if actual number is zero.
@@ -930,6 +1137,7 @@ void select_dive(int idx)
 		if (!dive->selected) {
 			dive->selected = 1;
 			amount_selected++;
+			invalidate_dive_site_counts();
 		}
 		selected_dive = idx;
 	}
@@ -940,6 +1148,7 @@ void deselect_dive(int idx)
 	struct dive *dive = get_dive(idx);
 	if (dive && dive->selected) {
 		dive->selected = 0;
+		invalidate_dive_site_counts();
 		if (amount_selected)
 			amount_selected--;
 		if (selected_dive == idx && amount_selected > 0) {
@@ -1012,6 +1221,8 @@ void combine_trips(struct dive_trip *trip_a, struct dive_trip *trip_b)
 void mark_divelist_changed(int changed)
 {
 	dive_list_changed = changed;
+	invalidate_dive_site_counts();
+	invalidate_dive_site_grid();
 	updateWindowTitle();
 }
 
@@ -1148,7 +1359,7 @@ void process_dives(bool is_imported, bool prefer_imported)
 		delete_single_dive(i + 1);
 		delete_single_dive(i + 1);
 		// keep the id or the first dive for the merged dive
-		merged->id = id;
+		set_dive_id(i, id);
 
 		/* this means the table was changed */
 		did_merge = true;
@@ -1224,10 +1435,11 @@ int get_dive_id_closest_to(timestamp_t when)
 
 void clear_dive_file_data()
 {
+	/* from the end, so the others don't have to move */
 	while (dive_table.nr)
-		delete_single_dive(0);
+		delete_single_dive(dive_table.nr - 1);
 	while (dive_site_table.nr)
-		delete_dive_site(get_dive_site(0)->uuid);
+		delete_dive_site(get_dive_site(dive_site_table.nr - 1)->uuid);
 
 	clear_dive(&displayed_dive);
 	clear_dive_site(&displayed_dive_site);
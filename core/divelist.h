@@ -9,12 +9,15 @@ extern "C" {
 #define DATAFORMAT_VERSION 3
 
 struct dive;
+struct deco_state;
+struct deco_settings;
 
 extern void update_cylinder_related_info(struct dive *);
+extern void update_all_cylinder_related_info(void);
 extern void mark_divelist_changed(int);
 extern int unsaved_changes(void);
 extern void remove_autogen_trips(void);
-extern unsigned int init_decompression(struct dive *dive);
+extern unsigned int init_decompression(struct deco_state *ds, struct dive *dive, const struct deco_settings *settings);
 
 /* divelist core logic functions */
 extern void process_dives(bool imported, bool prefer_imported);
@@ -2,33 +2,278 @@
 #include "divesite.h"
 #include "dive.h"
 #include "divelist.h"
+#include "id-index.h"
 
 #include <math.h>
 
 struct dive_site_table dive_site_table;
 
-/* there could be multiple sites of the same name - return the first one */
-uint32_t get_dive_site_uuid_by_name(const char *name, struct dive_site **dsp)
+/*
+ * The index of dive_site_table by uuid. Everything in here that moves the
+ * sites around keeps it up to date, code that sorts the table itself calls
+ * update_dive_site_index(). As with the dive index, a lookup checks what it
+ * finds and searches the table if that was wrong.
+ */
+static struct id_index site_index;
+
+void update_dive_site_index()
+{
+	int i;
+
+	id_index_clear(&site_index);
+	for (i = 0; i < dive_site_table.nr; i++)
+		id_index_set(&site_index, dive_site_table.dive_sites[i]->uuid, i);
+	invalidate_dive_site_grid();
+}
+
+static int find_dive_site_idx(uint32_t uuid)
+{
+	int i;
+	struct dive_site *ds;
+
+	i = id_index_get(&site_index, uuid);
+	if (i >= 0 && i < dive_site_table.nr && dive_site_table.dive_sites[i]->uuid == uuid)
+		return i;
+	for_each_dive_site (i, ds)
+		if (ds->uuid == uuid)
+			return i;
+	return -1;
+}
+
+struct dive_site *get_dive_site_by_uuid(uint32_t uuid)
+{
+	return get_dive_site(find_dive_site_idx(uuid));
+}
+
+/*
+ * The nr_dives and nr_selected_dives of the sites are counted in one go
+ * over the dives of dive_table, when they are asked for after a change.
+ * Adding, removing and selecting dives, set_dive_site_uuid() and
+ * mark_divelist_changed() call invalidate_dive_site_counts() - not
+ * invalidate_dive_cache(), which also gets called for copies of dives,
+ * e.g. on the threads of a plan sweep.
+ */
+static bool dive_site_counts_valid;
+
+void invalidate_dive_site_counts()
+{
+	dive_site_counts_valid = false;
+}
+
+void set_dive_site_uuid(struct dive *dive, uint32_t uuid)
+{
+	if (dive->dive_site_uuid == uuid)
+		return;
+	dive->dive_site_uuid = uuid;
+	invalidate_dive_site_counts();
+}
+
+static void count_dives_at_dive_sites()
 {
 	int i;
+	struct dive *d;
 	struct dive_site *ds;
+
+	for_each_dive_site (i, ds)
+		ds->nr_dives = ds->nr_selected_dives = 0;
+	for_each_dive (i, d) {
+		if (!d->dive_site_uuid || (ds = get_dive_site_by_uuid(d->dive_site_uuid)) == NULL)
+			continue;
+		ds->nr_dives++;
+		if (d->selected)
+			ds->nr_selected_dives++;
+	}
+	dive_site_counts_valid = true;
+}
+
+/*
+ * A grid over the sites with a GPS fix, so the sites near a position can
+ * be found without working out the distance to all of them. It is the
+ * sites sorted by the cell they are in, with cells of GRID_CELL_UDEG on
+ * each side. It is built when it is needed after invalidate_dive_site_grid(),
+ * which adding, deleting and sorting sites call, as does set_dive_site_gps()
+ * - so the GPS fix of a site in dive_site_table only changes through that.
+ */
+#define GRID_CELL_UDEG 10000
+#define GRID_LAT_CELLS (180000000 / GRID_CELL_UDEG)
+#define GRID_LON_CELLS (360000000 / GRID_CELL_UDEG)
+
+struct grid_entry {
+	int cell;
+	int idx;		// in dive_site_table
+};
+
+static struct {
+	bool valid;
+	int nr, allocated;
+	struct grid_entry *entries;
+} site_grid;
+
+void invalidate_dive_site_grid()
+{
+	site_grid.valid = false;
+}
+
+void set_dive_site_gps(struct dive_site *ds, degrees_t latitude, degrees_t longitude)
+{
+	if (ds->latitude.udeg == latitude.udeg && ds->longitude.udeg == longitude.udeg)
+		return;
+	ds->latitude = latitude;
+	ds->longitude = longitude;
+	invalidate_dive_site_grid();
+}
+
+static long long floor_div(long long a, int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int lat_cell(long long udeg)
+{
+	long long cell = floor_div(udeg + 90000000, GRID_CELL_UDEG);
+	return cell < 0 ? 0 : cell >= GRID_LAT_CELLS ? GRID_LAT_CELLS - 1 : cell;
+}
+
+/* without wrapping around - see lon_cell() */
+static long long lon_cell_unwrapped(long long udeg)
+{
+	return floor_div(udeg + 180000000, GRID_CELL_UDEG);
+}
+
+static int lon_cell(long long udeg)
+{
+	long long cell = lon_cell_unwrapped(udeg) % GRID_LON_CELLS;
+	return cell < 0 ? cell + GRID_LON_CELLS : cell;
+}
+
+static int grid_cell(degrees_t latitude, degrees_t longitude)
+{
+	return lat_cell(latitude.udeg) * GRID_LON_CELLS + lon_cell(longitude.udeg);
+}
+
+static int compare_grid_entries(const void *_a, const void *_b)
+{
+	const struct grid_entry *a = _a, *b = _b;
+	if (a->cell != b->cell)
+		return a->cell < b->cell ? -1 : 1;
+	return a->idx - b->idx;
+}
+
+static void build_site_grid()
+{
+	int i;
+	struct dive_site *ds;
+
+	if (site_grid.allocated < dive_site_table.nr) {
+		site_grid.allocated = dive_site_table.allocated;
+		site_grid.entries = realloc(site_grid.entries, site_grid.allocated * sizeof(struct grid_entry));
+		if (!site_grid.entries)
+			exit(1);
+	}
+	site_grid.nr = 0;
 	for_each_dive_site (i, ds) {
-		if (same_string(ds->name, name)) {
-			if (dsp)
-				*dsp = ds;
-			return ds->uuid;
+		if (!dive_site_has_gps_location(ds))
+			continue;
+		site_grid.entries[site_grid.nr].cell = grid_cell(ds->latitude, ds->longitude);
+		site_grid.entries[site_grid.nr].idx = i;
+		site_grid.nr++;
+	}
+	/* within a cell, the sites stay in the order of the table */
+	qsort(site_grid.entries, site_grid.nr, sizeof(struct grid_entry), compare_grid_entries);
+	site_grid.valid = true;
+}
+
+/* the first entry of the grid in the cell, or where it would be */
+static int grid_cell_start(int cell)
+{
+	int low = 0, high = site_grid.nr;
+
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (site_grid.entries[mid].cell < cell)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/*
+ * Call fn for the sites with a GPS fix that can be less than distance meters
+ * from the position. That is at most distance / R away in latitude, and at
+ * most 2 asin(sin(distance / 2R) / cos(latitude)) in longitude - with the
+ * latitude the furthest from the equator of the sites that can be near.
+ */
+static void for_each_dive_site_near(degrees_t latitude, degrees_t longitude, int distance,
+				    void (*fn)(int idx, void *data), void *data)
+{
+	double angle = distance / 6371000.0;
+	double c;
+	long long dlat, dlon;
+	int i, j, k, lat_from = 0, lat_to = 0, lon_from = 0, nlon = GRID_LON_CELLS;
+
+	if (!site_grid.valid)
+		build_site_grid();
+	/* with a cell to spare on each side, for the rounding */
+	dlat = lrint(angle * 180 / M_PI * 1000000) + GRID_CELL_UDEG;
+	c = cos(udeg_to_radians(abs(latitude.udeg) + dlat));
+	if (distance >= 0 && angle < M_PI && abs(latitude.udeg) + dlat < 90000000 && sin(angle / 2) < c) {
+		dlon = lrint(2 * asin(sin(angle / 2) / c) * 180 / M_PI * 1000000) + GRID_CELL_UDEG;
+		lat_from = lat_cell(latitude.udeg - dlat);
+		lat_to = lat_cell(latitude.udeg + dlat);
+		lon_from = lon_cell(longitude.udeg - dlon);
+		nlon = lon_cell_unwrapped(longitude.udeg + dlon) - lon_cell_unwrapped(longitude.udeg - dlon) + 1;
+		if (nlon > GRID_LON_CELLS)
+			nlon = GRID_LON_CELLS;
+	}
+	/* looking at all the sites is quicker than looking in all those cells */
+	if (nlon == GRID_LON_CELLS || (long long)(lat_to - lat_from + 1) * nlon > site_grid.nr) {
+		for (i = 0; i < site_grid.nr; i++)
+			fn(site_grid.entries[i].idx, data);
+		return;
+	}
+	for (i = lat_from; i <= lat_to; i++) {
+		for (j = 0; j < nlon; j++) {
+			int cell = i * GRID_LON_CELLS + (lon_from + j) % GRID_LON_CELLS;
+			for (k = grid_cell_start(cell); k < site_grid.nr && site_grid.entries[k].cell == cell; k++)
+				fn(site_grid.entries[k].idx, data);
 		}
 	}
-	return 0;
 }
 
-/* there could be multiple sites at the same GPS fix - return the first one */
-uint32_t get_dive_site_uuid_by_gps(degrees_t latitude, degrees_t longitude, struct dive_site **dsp)
+/* the first site in the table at exactly that position, with that name if match_name */
+static struct dive_site *first_dive_site_at(degrees_t latitude, degrees_t longitude, bool match_name, const char *name)
+{
+	int i, cell;
+	struct dive_site *ds;
+
+	/* the sites without a GPS fix aren't in the grid */
+	if (!latitude.udeg && !longitude.udeg) {
+		for_each_dive_site (i, ds) {
+			if (!dive_site_has_gps_location(ds) && (!match_name || same_string(ds->name, name)))
+				return ds;
+		}
+		return NULL;
+	}
+	if (!site_grid.valid)
+		build_site_grid();
+	cell = grid_cell(latitude, longitude);
+	for (i = grid_cell_start(cell); i < site_grid.nr && site_grid.entries[i].cell == cell; i++) {
+		ds = get_dive_site(site_grid.entries[i].idx);
+		if (ds->latitude.udeg == latitude.udeg && ds->longitude.udeg == longitude.udeg &&
+		    (!match_name || same_string(ds->name, name)))
+			return ds;
+	}
+	return NULL;
+}
+
+/* there could be multiple sites of the same name - return the first one */
+uint32_t get_dive_site_uuid_by_name(const char *name, struct dive_site **dsp)
 {
 	int i;
 	struct dive_site *ds;
 	for_each_dive_site (i, ds) {
-		if (ds->latitude.udeg == latitude.udeg && ds->longitude.udeg == longitude.udeg) {
+		if (same_string(ds->name, name)) {
 			if (dsp)
 				*dsp = ds;
 			return ds->uuid;
@@ -37,53 +282,129 @@ uint32_t get_dive_site_uuid_by_gps(degrees_t latitude, degrees_t longitude, stru
 	return 0;
 }
 
+/* there could be multiple sites at the same GPS fix - return the first one */
+uint32_t get_dive_site_uuid_by_gps(degrees_t latitude, degrees_t longitude, struct dive_site **dsp)
+{
+	struct dive_site *ds = first_dive_site_at(latitude, longitude, false, NULL);
+
+	if (!ds)
+		return 0;
+	if (dsp)
+		*dsp = ds;
+	return ds->uuid;
+}
+
 
 /* to avoid a bug where we have two dive sites with different name and the same GPS coordinates
  * and first get the gps coordinates (reading a V2 file) and happen to get back "the other" name,
  * this function allows us to verify if a very specific name/GPS combination already exists */
 uint32_t get_dive_site_uuid_by_gps_and_name(char *name, degrees_t latitude, degrees_t longitude)
 {
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds) {
-		if (ds->latitude.udeg == latitude.udeg && ds->longitude.udeg == longitude.udeg && same_string(ds->name, name))
-			return ds->uuid;
-	}
-	return 0;
+	struct dive_site *ds = first_dive_site_at(latitude, longitude, true, name);
+
+	return ds ? ds->uuid : 0;
 }
 
 // Calculate the distance in meters between two coordinates.
 unsigned int get_distance(degrees_t lat1, degrees_t lon1, degrees_t lat2, degrees_t lon2)
 {
+	double lat1_r = udeg_to_radians(lat1.udeg);
 	double lat2_r = udeg_to_radians(lat2.udeg);
 	double lat_d_r = udeg_to_radians(lat2.udeg-lat1.udeg);
 	double lon_d_r = udeg_to_radians(lon2.udeg-lon1.udeg);
 
 	double a = sin(lat_d_r/2) * sin(lat_d_r/2) +
-		cos(lat2_r) * cos(lat2_r) * sin(lon_d_r/2) * sin(lon_d_r/2);
+		cos(lat1_r) * cos(lat2_r) * sin(lon_d_r/2) * sin(lon_d_r/2);
 	double c = 2 * atan2(sqrt(a), sqrt(1.0 - a));
 
 	// Earth radious in metres
 	return 6371000 * c;
 }
 
+struct closest_site {
+	degrees_t latitude, longitude;
+	unsigned int distance;
+	int idx;		// -1 until there is one closer than the distance asked for
+};
+
+static void closer_dive_site(int idx, void *_closest)
+{
+	struct closest_site *closest = _closest;
+	struct dive_site *ds = get_dive_site(idx);
+	unsigned int distance = get_distance(ds->latitude, ds->longitude, closest->latitude, closest->longitude);
+
+	if (distance < closest->distance || (closest->idx >= 0 && distance == closest->distance && idx < closest->idx)) {
+		closest->distance = distance;
+		closest->idx = idx;
+	}
+}
+
 /* find the closest one, no more than distance meters away - if more than one at same distance, pick the first */
 uint32_t get_dive_site_uuid_by_gps_proximity(degrees_t latitude, degrees_t longitude, int distance, struct dive_site **dsp)
 {
-	int i;
-	int uuid = 0;
+	struct closest_site closest = { latitude, longitude, distance, -1 };
 	struct dive_site *ds;
-	unsigned int cur_distance, min_distance = distance;
-	for_each_dive_site (i, ds) {
-		if (dive_site_has_gps_location(ds) &&
-		    (cur_distance = get_distance(ds->latitude, ds->longitude, latitude, longitude)) < min_distance) {
-			min_distance = cur_distance;
-			uuid = ds->uuid;
-			if (dsp)
-				*dsp = ds;
-		}
+
+	for_each_dive_site_near(latitude, longitude, distance, closer_dive_site, &closest);
+	if (closest.idx < 0)
+		return 0;
+	ds = get_dive_site(closest.idx);
+	if (dsp)
+		*dsp = ds;
+	return ds->uuid;
+}
+
+struct nearby_sites {
+	int idx;		// of the site the others are near to
+	int distance;
+	int nr, allocated;
+	struct dive_site_pair *pairs;
+};
+
+static void add_nearby_dive_site(int idx, void *_nearby)
+{
+	struct nearby_sites *nearby = _nearby;
+	struct dive_site *ds = get_dive_site(nearby->idx);
+	struct dive_site *other = get_dive_site(idx);
+	unsigned int distance;
+
+	/* every pair once, the site that comes first in the table first */
+	if (idx >= nearby->idx)
+		return;
+	distance = get_distance(other->latitude, other->longitude, ds->latitude, ds->longitude);
+	if (distance >= (unsigned int)nearby->distance)
+		return;
+	if (nearby->nr >= nearby->allocated) {
+		nearby->allocated = (nearby->nr + 32) * 3 / 2;
+		nearby->pairs = realloc(nearby->pairs, nearby->allocated * sizeof(struct dive_site_pair));
+		if (!nearby->pairs)
+			exit(1);
 	}
-	return uuid;
+	nearby->pairs[nearby->nr].uuid1 = other->uuid;
+	nearby->pairs[nearby->nr].uuid2 = ds->uuid;
+	nearby->pairs[nearby->nr].distance = distance;
+	nearby->nr++;
+}
+
+/*
+ * All the pairs of sites with GPS fixes less than distance meters apart,
+ * e.g. to find the duplicates among them. Returns the number of pairs;
+ * the caller frees *pairs.
+ */
+int get_dive_site_pairs_by_gps_proximity(int distance, struct dive_site_pair **pairs)
+{
+	struct nearby_sites nearby = { 0, distance, 0, 0, NULL };
+	struct dive_site *ds;
+
+	*pairs = NULL;
+	if (distance <= 0)
+		return 0;
+	for_each_dive_site (nearby.idx, ds) {
+		if (dive_site_has_gps_location(ds))
+			for_each_dive_site_near(ds->latitude, ds->longitude, distance, add_nearby_dive_site, &nearby);
+	}
+	*pairs = nearby.pairs;
+	return nearby.nr;
 }
 
 /* try to create a uniqe ID - fingers crossed */
@@ -136,6 +457,10 @@ struct dive_site *alloc_or_get_dive_site(uint32_t uuid)
 		ds->uuid = uuid;
 	else
 		ds->uuid = dive_site_getUniqId();
+	id_index_set(&site_index, ds->uuid, nr);
+	invalidate_dive_site_grid();
+	// a new site can already have dives, from before it was deleted
+	dive_site_counts_valid = false;
 	return ds;
 }
 
@@ -144,6 +469,14 @@ int nr_of_dives_at_dive_site(uint32_t uuid, bool select_only)
 	int j;
 	int nr = 0;
 	struct dive *d;
+	struct dive_site *ds = get_dive_site_by_uuid(uuid);
+
+	if (ds) {
+		if (!dive_site_counts_valid)
+			count_dives_at_dive_sites();
+		return select_only ? ds->nr_selected_dives : ds->nr_dives;
+	}
+	/* not a site in the table, so it isn't counted */
 	for_each_dive(j, d) {
 		if (d->dive_site_uuid == uuid && (!select_only || d->selected)) {
 			nr++;
@@ -154,35 +487,29 @@ int nr_of_dives_at_dive_site(uint32_t uuid, bool select_only)
 
 bool is_dive_site_used(uint32_t uuid, bool select_only)
 {
-	int j;
-	bool found = false;
-	struct dive *d;
-	for_each_dive(j, d) {
-		if (d->dive_site_uuid == uuid && (!select_only || d->selected)) {
-			found = true;
-			break;
-		}
-	}
-	return found;
+	return nr_of_dives_at_dive_site(uuid, select_only) > 0;
 }
 
 void delete_dive_site(uint32_t id)
 {
 	int nr = dive_site_table.nr;
-	for (int i = 0; i < nr; i++) {
-		struct dive_site *ds = get_dive_site(i);
-		if (ds->uuid == id) {
-			free(ds->name);
-			free(ds->notes);
-			free(ds);
-			if (nr - 1 > i)
-				memmove(&dive_site_table.dive_sites[i],
-					&dive_site_table.dive_sites[i+1],
-					(nr - 1 - i) * sizeof(dive_site_table.dive_sites[0]));
-			dive_site_table.nr = nr - 1;
-			break;
-		}
-	}
+	int i = find_dive_site_idx(id);
+	struct dive_site *ds = get_dive_site(i);
+
+	if (!ds)
+		return;
+	id_index_remove(&site_index, id, i);
+	free(ds->name);
+	free(ds->notes);
+	free(ds);
+	if (nr - 1 > i)
+		memmove(&dive_site_table.dive_sites[i],
+			&dive_site_table.dive_sites[i+1],
+			(nr - 1 - i) * sizeof(dive_site_table.dive_sites[0]));
+	dive_site_table.nr = nr - 1;
+	for (; i < nr - 1; i++)
+		id_index_set(&site_index, dive_site_table.dive_sites[i]->uuid, i);
+	invalidate_dive_site_grid();
 }
 
 uint32_t create_divesite_uuid(const char *name, timestamp_t divetime)
@@ -228,8 +555,7 @@ uint32_t create_dive_site_with_gps(const char *name, degrees_t latitude, degrees
 	uint32_t uuid = create_divesite_uuid(name, divetime);
 	struct dive_site *ds = alloc_or_get_dive_site(uuid);
 	ds->name = copy_string(name);
-	ds->latitude = latitude;
-	ds->longitude = longitude;
+	set_dive_site_gps(ds, latitude, longitude);
 
 	return ds->uuid;
 }
@@ -250,8 +576,7 @@ void copy_dive_site(struct dive_site *orig, struct dive_site *copy)
 	free(copy->notes);
 	free(copy->description);
 
-	copy->latitude = orig->latitude;
-	copy->longitude = orig->longitude;
+	set_dive_site_gps(copy, orig->latitude, orig->longitude);
 	copy->name = copy_string(orig->name);
 	copy->notes = copy_string(orig->notes);
 	copy->description = copy_string(orig->description);
@@ -281,8 +606,7 @@ void clear_dive_site(struct dive_site *ds)
 	ds->name = 0;
 	ds->notes = 0;
 	ds->description = 0;
-	ds->latitude.udeg = 0;
-	ds->longitude.udeg = 0;
+	set_dive_site_gps(ds, (degrees_t){ 0 }, (degrees_t){ 0 });
 	ds->uuid = 0;
 	ds->taxonomy.nr = 0;
 	free_taxonomy(&ds->taxonomy);
@@ -299,7 +623,7 @@ void merge_dive_sites(uint32_t ref, uint32_t* uuids, int count)
 		for_each_dive(curr_dive, d) {
 			if (d->dive_site_uuid != uuids[i] )
 				continue;
-			d->dive_site_uuid = ref;
+			set_dive_site_uuid(d, ref);
 		}
 	}
 
@@ -334,4 +658,5 @@ static int compare_sites(const void *_a, const void *_b)
 void dive_site_table_sort()
 {
 	qsort(dive_site_table.dive_sites, dive_site_table.nr, sizeof(struct dive_site *), compare_sites);
+	update_dive_site_index();
 }
@@ -20,6 +20,13 @@ struct dive_site
 	char *description;
 	char *notes;
 	struct taxonomy_data taxonomy;
+	/* the dives at the site, see nr_of_dives_at_dive_site() */
+	int nr_dives, nr_selected_dives;
+};
+
+struct dive_site_pair {
+	uint32_t uuid1, uuid2;
+	unsigned int distance;	// in meters
 };
 
 struct dive_site_table {
@@ -40,15 +47,16 @@ static inline struct dive_site *get_dive_site(int nr)
 #define for_each_dive_site(_i, _x) \
 	for ((_i) = 0; ((_x) = get_dive_site(_i)) != NULL; (_i)++)
 
-static inline struct dive_site *get_dive_site_by_uuid(uint32_t uuid)
-{
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds)
-		if (ds->uuid == uuid)
-			return get_dive_site(i);
-	return NULL;
-}
+/* these go through an index of dive_site_table by uuid, see divesite.c */
+struct dive_site *get_dive_site_by_uuid(uint32_t uuid);
+void update_dive_site_index();
+void invalidate_dive_site_counts();
+struct dive;
+/* every change of the site of a dive goes through this, so the counts follow */
+void set_dive_site_uuid(struct dive *dive, uint32_t uuid);
+/* the GPS fix of a site goes through this, see get_dive_site_uuid_by_gps_proximity() */
+void set_dive_site_gps(struct dive_site *ds, degrees_t latitude, degrees_t longitude);
+void invalidate_dive_site_grid();
 
 void dive_site_table_sort();
 struct dive_site *alloc_or_get_dive_site(uint32_t uuid);
@@ -62,6 +70,7 @@ uint32_t get_dive_site_uuid_by_name(const char *name, struct dive_site **dsp);
 uint32_t get_dive_site_uuid_by_gps(degrees_t latitude, degrees_t longitude, struct dive_site **dsp);
 uint32_t get_dive_site_uuid_by_gps_and_name(char *name, degrees_t latitude, degrees_t longitude);
 uint32_t get_dive_site_uuid_by_gps_proximity(degrees_t latitude, degrees_t longitude, int distance, struct dive_site **dsp);
+int get_dive_site_pairs_by_gps_proximity(int distance, struct dive_site_pair **pairs);
 bool dive_site_is_empty(struct dive_site *ds);
 void copy_dive_site(struct dive_site *orig, struct dive_site *copy);
 void clear_dive_site(struct dive_site *ds);
@@ -14,7 +14,8 @@
  *  the majority of the functions below. The linked list covers a part of the dive profile
  *  for which there are no cylinder pressure data. Each element in the linked list
  *  represents a segment between two consecutive points on the dive profile.
- *  pr_track_t is defined in gaspressures.h
+ *  pr_track_t is defined in gaspressures.h. The lists of all cylinders share one array,
+ *  allocated once per profile: every plot entry starts at most one segment.
  */
 
 #include "dive.h"
@@ -22,9 +23,17 @@
 #include "profile.h"
 #include "gaspressures.h"
 
-static pr_track_t *pr_track_alloc(int start, int t_start)
+/* The segments of all cylinders of a profile */
+struct pr_tracks {
+	pr_track_t *segments;
+	int nr;
+	pr_track_t *first[MAX_CYLINDERS];
+	pr_track_t *last[MAX_CYLINDERS];
+};
+
+static pr_track_t *pr_track_alloc(struct pr_tracks *tracks, int start, int t_start)
 {
-	pr_track_t *pt = malloc(sizeof(pr_track_t));
+	pr_track_t *pt = tracks->segments + tracks->nr++;
 	pt->start = start;
 	pt->end = 0;
 	pt->t_start = pt->t_end = t_start;
@@ -33,33 +42,13 @@ static pr_track_t *pr_track_alloc(int start, int t_start)
 	return pt;
 }
 
-/* poor man's linked list */
-static pr_track_t *list_last(pr_track_t *list)
-{
-	pr_track_t *tail = list;
-	if (!tail)
-		return NULL;
-	while (tail->next) {
-		tail = tail->next;
-	}
-	return tail;
-}
-
-static pr_track_t *list_add(pr_track_t *list, pr_track_t *element)
+static void list_add(struct pr_tracks *tracks, int cyl, pr_track_t *element)
 {
-	pr_track_t *tail = list_last(list);
-	if (!tail)
-		return element;
-	tail->next = element;
-	return list;
-}
-
-static void list_free(pr_track_t *list)
-{
-	if (!list)
-		return;
-	list_free(list->next);
-	free(list);
+	if (tracks->last[cyl])
+		tracks->last[cyl]->next = element;
+	else
+		tracks->first[cyl] = element;
+	tracks->last[cyl] = element;
 }
 
 #ifdef DEBUG_PR_TRACK
@@ -196,6 +185,50 @@ static struct pr_interpolate_struct get_pr_interpolate_data(pr_track_t *segment,
 	return interpolate;
 }
 
+/* the first entry at or after sec, or pi->nr - the entries have to be in order */
+static int first_entry_at(const struct plot_info *pi, int sec)
+{
+	int low = 0, high = pi->nr;
+
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (pi->entry[mid].sec < sec)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/*
+ * The same as get_pr_interpolate_data(), if the entries are in order: then
+ * the entries of the segment are the ones from its start up to the first
+ * one at its end, and pt_sum[i] is the pressure-time of the entries before i.
+ */
+static struct pr_interpolate_struct get_pr_interpolate_data_in_order(pr_track_t *segment, struct plot_info *pi, const int64_t *pt_sum, int cur)
+{
+	struct pr_interpolate_struct interpolate;
+	int first = first_entry_at(pi, segment->t_start);
+	int end = MAX(first_entry_at(pi, segment->t_end), first);
+
+	interpolate.start = segment->start;
+	interpolate.end = segment->end;
+	interpolate.pressure_time = pt_sum[MIN(end + 1, pi->nr)] - pt_sum[first];
+	interpolate.acc_pressure_time = pt_sum[MAX(first, MIN(end, cur + 1))] - pt_sum[first];
+	return interpolate;
+}
+
+static bool entries_in_order(const struct plot_info *pi)
+{
+	int i;
+
+	for (i = 1; i < pi->nr; i++) {
+		if (pi->entry[i].sec < pi->entry[i - 1].sec)
+			return false;
+	}
+	return true;
+}
+
 static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi, pr_track_t **track_pr, bool o2_flag)
 {
 	int cyl, i;
@@ -203,6 +236,18 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 	pr_interpolate_t interpolate = { 0, 0, 0, 0 };
 	pr_track_t *last_segment = NULL;
 	int cur_pr[MAX_CYLINDERS]; // cur_pr[MAX_CYLINDERS] is the CCR diluent cylinder
+	/* With the entries in order, the segment of an entry is never before that
+	 * of the entry before it, and the pressure-times can be summed up once */
+	bool in_order = entries_in_order(pi);
+	pr_track_t *cur_segment[MAX_CYLINDERS];
+	int64_t *pt_sum = NULL;
+
+	if (in_order) {
+		pt_sum = malloc((pi->nr + 1) * sizeof(*pt_sum));
+		pt_sum[0] = 0;
+		for (i = 0; i < pi->nr; i++)
+			pt_sum[i + 1] = pt_sum[i] + pi->entry[i].pressure_time;
+	}
 
 	for (cyl = 0; cyl < MAX_CYLINDERS; cyl++) {
 		enum interpolation_strategy strategy;
@@ -218,6 +263,8 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 		fill_missing_segment_pressures(track_pr[cyl], strategy); // Interpolate the missing tank pressure values ..
 		cur_pr[cyl] = track_pr[cyl]->start;	       // in the pr_track_t lists of structures
 	}						       // and keep the starting pressure for each cylinder.
+	for (cyl = 0; cyl < MAX_CYLINDERS; cyl++)
+		cur_segment[cyl] = track_pr[cyl];
 
 #ifdef DEBUG_PR_TRACK
 	/* another great debugging tool */
@@ -246,7 +293,7 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 			// Find the cylinder index (cyl) and pressure
 			cyl = dive->oxygen_cylinder_index;
 			if (cyl < 0)
-				return;   // Can we do this?!?
+				break;   // Can we do this?!?
 			pressure = O2CYLINDER_PRESSURE(entry);
 			save_pressure = &(entry->o2cylinderpressure[SENSOR_PR]);
 			save_interpolated = &(entry->o2cylinderpressure[INTERPOLATED_PR]);
@@ -264,9 +311,10 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 		}
 		// If there is NO valid pressure value..
 		// Find the pressure segment corresponding to this entry..
-		segment = track_pr[cyl];
+		segment = in_order ? cur_segment[cyl] : track_pr[cyl];
 		while (segment && segment->t_end < entry->sec) // Find the track_pr with end time..
 			segment = segment->next;	       // ..that matches the plot_info time (entry->sec)
+		cur_segment[cyl] = segment;
 
 		if (!segment || !segment->pressure_time) { // No (or empty) segment?
 			*save_pressure = cur_pr[cyl];      // Just use our current pressure
@@ -278,7 +326,10 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 			interpolate.acc_pressure_time += entry->pressure_time;
 		} else {
 			// Set up an interpolation structure
-			interpolate = get_pr_interpolate_data(segment, pi, i);
+			if (in_order)
+				interpolate = get_pr_interpolate_data_in_order(segment, pi, pt_sum, i);
+			else
+				interpolate = get_pr_interpolate_data(segment, pi, i);
 			last_segment = segment;
 		}
 
@@ -298,6 +349,7 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 		}
 		*save_interpolated = cur_pr[cyl]; // and store the interpolated data in plot_info
 	}
+	free(pt_sum);
 }
 
 
@@ -349,7 +401,7 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 {
 	(void) dc;
 	int i, cylinderid, cylinderindex = -1;
-	pr_track_t *track_pr[MAX_CYLINDERS] = { NULL, };
+	struct pr_tracks tracks = { NULL, };
 	pr_track_t *current = NULL;
 	bool missing_pr = false;
 	bool found_any_pr_data = false;
@@ -365,6 +417,8 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 	if (!found_any_pr_data)
 		return;
 
+	tracks.segments = malloc(pi->nr * sizeof(*tracks.segments));
+
 	for (i = 0; i < pi->nr; i++) {
 		struct plot_data *entry = pi->entry + i;
 		unsigned pressure;
@@ -392,8 +446,8 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 				cylinderindex = dive->oxygen_cylinder_index; // indicate o2 cylinder
 			else
 				cylinderindex = entry->cylinderindex;
-			current = pr_track_alloc(pressure, entry->sec);
-			track_pr[cylinderindex] = list_add(track_pr[cylinderindex], current);
+			current = pr_track_alloc(&tracks, pressure, entry->sec);
+			list_add(&tracks, cylinderindex, current);
 			continue;
 		}
 
@@ -411,13 +465,13 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 			continue;
 
 		/* transmitter stopped transmitting cylinder pressure data */
-		current = pr_track_alloc(pressure, entry->sec);
+		current = pr_track_alloc(&tracks, pressure, entry->sec);
 		if (cylinderindex >= 0)
-			track_pr[cylinderindex] = list_add(track_pr[cylinderindex], current);
+			list_add(&tracks, cylinderindex, current);
 	}
 
 	if (missing_pr) {
-		fill_missing_tank_pressures(dive, pi, track_pr, o2_flag);
+		fill_missing_tank_pressures(dive, pi, tracks.first, o2_flag);
 	}
 
 #ifdef PRINT_PRESSURES_DEBUG
@@ -425,6 +479,5 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 #endif
 
 GIVE_UP:
-	for (i = 0; i < MAX_CYLINDERS; i++)
-		list_free(track_pr[i]);
+	free(tracks.segments);
 }
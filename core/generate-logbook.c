@@ -0,0 +1,272 @@
+/* generate-logbook.c
+ *
+ * Make up logbooks of any size, to see how loading, saving and all the
+ * calculations in between hold up with many thousands of dives. The dives
+ * are random but plausible: a descent, some time at depth, an ascent with
+ * a safety stop and the tank pressure going down with the diver's
+ * breathing. The same seed always gives the same logbook.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "dive.h"
+#include "divesite.h"
+#include "libdivecomputer.h"
+#include "generate-logbook.h"
+
+static const char *buddies[] = { "Anna", "Ben", "Carla", "Dimitri", "Eva", "Farid", "Grace", "Hiro" };
+static const char *suits[] = { "3mm shorty", "5mm wetsuit", "7mm semidry", "Drysuit" };
+static const char *tags[] = { "boat", "shore", "wreck", "reef", "night", "drift", "cave" };
+static const char *notes[] = {
+	"Good visibility, lots of fish.",
+	"Some current on the way back to the line.",
+	"Cold thermocline below 15m.",
+	"Tried out the new regulator, no issues."
+};
+#define PICK(state, list) (list[next_random(state) % (sizeof(list) / sizeof(list[0]))])
+
+/* The dive, as all its dive computers record it */
+struct profile {
+	int nr;
+	int time[8];
+	int depth[8];
+	int sac;		// ml/min
+	int watertemp;		// C
+};
+
+/* xorshift - good enough for made up dives, and the same everywhere */
+static unsigned int next_random(unsigned int *state)
+{
+	unsigned int x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+/* low to high, both included */
+static int random_between(unsigned int *state, int low, int high)
+{
+	return low + next_random(state) % (high - low + 1);
+}
+
+static void add_point(struct profile *p, int time, int depth)
+{
+	p->time[p->nr] = time;
+	p->depth[p->nr] = depth;
+	p->nr++;
+}
+
+static void make_profile(struct profile *p, unsigned int *state)
+{
+	/* most dives are recreational, some go deeper */
+	int maxdepth = MIN(random_between(state, 6000, 60000), random_between(state, 6000, 60000));
+	int bottom_time = random_between(state, 10 * 60, 50 * 60) * 20000 / MAX(maxdepth, 20000);
+	int end_depth = maxdepth * random_between(state, 30, 70) / 100;
+	int stop_depth = MIN(5000, end_depth);
+	int time;
+
+	p->nr = 0;
+	add_point(p, 0, 0);
+	time = maxdepth / 300;				/* 18m/min down */
+	add_point(p, time, maxdepth);
+	add_point(p, time + bottom_time / 2, maxdepth * random_between(state, 60, 100) / 100);
+	time += bottom_time;
+	add_point(p, time, end_depth);
+	time += (end_depth - stop_depth) / 150;		/* 9m/min up */
+	add_point(p, time, stop_depth);
+	time += 180;
+	add_point(p, time, stop_depth);
+	time += stop_depth / 150;
+	add_point(p, time, 0);
+	p->sac = random_between(state, 12000, 25000);
+	p->watertemp = random_between(state, 8, 28);
+}
+
+static int profile_depth(const struct profile *p, int time)
+{
+	int i;
+
+	for (i = 1; i < p->nr; i++) {
+		if (time <= p->time[i])
+			return interpolate(p->depth[i - 1], p->depth[i], time - p->time[i - 1], p->time[i] - p->time[i - 1]);
+	}
+	return 0;
+}
+
+/* Nobody breathes their tank empty: cut the SAC down to leave 50 bar */
+static void limit_sac(struct profile *p, const struct dive *dive, const cylinder_t *cyl)
+{
+	int end = p->time[p->nr - 1], time;
+	double used = 0.0;
+
+	for (time = 0; time < end; time += 10)
+		used += p->sac / 6.0 * depth_to_bar(profile_depth(p, time), dive) * 1000.0 / cyl->type.size.mliter;
+	if (cyl->start.mbar - used < 50000)
+		p->sac = p->sac * (cyl->start.mbar - 50000) / used;
+}
+
+/* A dive computer that records the profile every rate seconds, with some noise */
+static void record_profile(struct dive *dive, struct divecomputer *dc, const struct profile *p, int rate, unsigned int *state)
+{
+	int end = p->time[p->nr - 1];
+	bool ccr = dc->divemode == CCR;
+	cylinder_t *cyl = dive->cylinder + (ccr ? 1 : 0);
+	double pressure = cyl->start.mbar;
+	double o2pressure = dive->cylinder[0].start.mbar;
+	int setpoint = 700;
+	int time;
+
+	if (ccr)
+		add_event(dc, 0, SAMPLE_EVENT_PO2, 0, setpoint, "SP change");
+	for (time = 0; time <= end + rate - 1; time += rate) {
+		struct sample *sample = prepare_sample(dc);
+		int depth = profile_depth(p, MIN(time, end));
+		double bar = depth_to_bar(depth, dive);
+
+		if (depth > 200 && time < end)
+			depth += random_between(state, -100, 100);
+		sample->time.seconds = time;
+		sample->depth.mm = depth;
+		sample->temperature.mkelvin = C_to_mkelvin(p->watertemp + 4.0 * (1.0 - MIN(depth, 20000) / 20000.0));
+		if (ccr) {
+			/* the diluent only makes up for the loop volume, the oxygen for the metabolism */
+			pressure -= 500.0 * rate / 60.0 * bar * 1000.0 / cyl->type.size.mliter;
+			o2pressure -= 1000.0 * rate / 60.0 * 1000.0 / dive->cylinder[0].type.size.mliter;
+			sample->o2cylinderpressure.mbar = lrint(o2pressure);
+			if (setpoint == 700 && depth > 6000) {
+				setpoint = 1300;
+				add_event(dc, time, SAMPLE_EVENT_PO2, 0, setpoint, "SP change");
+			}
+			sample->setpoint.mbar = MIN(setpoint, (int)lrint(bar * 1000));
+			sample->o2sensor[0].mbar = sample->setpoint.mbar + random_between(state, -30, 30);
+			sample->o2sensor[1].mbar = sample->setpoint.mbar + random_between(state, -30, 30);
+			sample->o2sensor[2].mbar = sample->setpoint.mbar + random_between(state, -30, 30);
+		} else {
+			pressure -= (double)p->sac * rate / 60.0 * bar * 1000.0 / cyl->type.size.mliter;
+		}
+		sample->cylinderpressure.mbar = lrint(MAX(pressure, 0.0));
+		sample->sensor = cyl - dive->cylinder;
+		finish_sample(dc);
+	}
+	if (random_between(state, 0, 3) == 0)
+		add_event(dc, random_between(state, 0, end), SAMPLE_EVENT_BOOKMARK, 0, 0, "bookmark");
+}
+
+static void fill_cylinder(cylinder_t *cyl, const char *description, int size, int o2, int start, enum cylinderuse use)
+{
+	cyl->type.description = strdup(description);
+	cyl->type.size.mliter = size;
+	cyl->type.workingpressure.mbar = 232000;
+	cyl->gasmix.o2.permille = o2;
+	cyl->start.mbar = start;
+	cyl->cylinder_use = use;
+}
+
+static struct dive *generate_dive(const struct logbook_shape *shape, const uint32_t *sites, int nr_sites, timestamp_t when, unsigned int *state)
+{
+	struct dive *dive = alloc_dive();
+	struct divecomputer *dc = &dive->dc;
+	struct profile p;
+	char name[64];
+	int i;
+
+	dive->when = when;
+	set_dive_site_uuid(dive, sites[next_random(state) % nr_sites]);
+	dive->buddy = strdup(PICK(state, buddies));
+	dive->divemaster = strdup(PICK(state, buddies));
+	dive->suit = strdup(PICK(state, suits));
+	dive->notes = strdup(PICK(state, notes));
+	dive->rating = random_between(state, 0, 5);
+	dive->visibility = random_between(state, 0, 5);
+	taglist_add_tag(&dive->tag_list, PICK(state, tags));
+	dive->weightsystem[0].weight.grams = random_between(state, 2, 12) * 1000;
+	dive->weightsystem[0].description = strdup("belt");
+
+	dc->when = when;
+	dc->surface_pressure.mbar = 1013;
+	dc->salinity = 10300;
+	if (random_between(state, 1, 100) <= shape->ccr_percent) {
+		dc->divemode = CCR;
+		dc->no_o2sensors = 3;
+		fill_cylinder(dive->cylinder + 0, "Oxygen 3l", 3000, 1000, random_between(state, 180, 200) * 1000, OXYGEN);
+		fill_cylinder(dive->cylinder + 1, "Diluent 3l", 3000, 209, random_between(state, 180, 200) * 1000, DILUENT);
+	} else {
+		int size = random_between(state, 0, 1) ? 15 : 12;
+
+		snprintf(name, sizeof(name), "%dl", size);
+		fill_cylinder(dive->cylinder + 0, name, size * 1000, random_between(state, 0, 2) ? 209 : 320,
+			      random_between(state, 190, 230) * 1000, OC_GAS);
+	}
+
+	make_profile(&p, state);
+	if (dc->divemode != CCR)
+		limit_sac(&p, dive, dive->cylinder + 0);
+	for (i = 0; i < shape->dive_computers; i++) {
+		if (i) {
+			dc->next = calloc(1, sizeof(*dc));
+			dc->next->when = when;
+			dc->next->divemode = dc->divemode;
+			dc->next->no_o2sensors = dc->no_o2sensors;
+			dc->next->surface_pressure = dc->surface_pressure;
+			dc->next->salinity = dc->salinity;
+			dc = dc->next;
+		}
+		snprintf(name, sizeof(name), "Logbook Generator %d", i + 1);
+		dc->model = strdup(name);
+		dc->deviceid = 0x10000 + i;
+		dc->diveid = next_random(state);
+		/* the backup computers sample less often */
+		record_profile(dive, dc, &p, shape->sample_rate * (i + 1), state);
+	}
+	return fixup_dive(dive);
+}
+
+void default_logbook_shape(struct logbook_shape *shape)
+{
+	shape->dives = 1000;
+	shape->dive_sites = 100;
+	shape->sample_rate = 1;
+	shape->dive_computers = 2;
+	shape->ccr_percent = 10;
+	shape->start = 1262304000;	/* 2010-01-01 */
+	shape->seed = 1;
+}
+
+/*
+ * Adds the dives to the table and their dive sites to the global dive
+ * site table - these don't go through process_dives(), they are in order
+ * and numbered already.
+ */
+void generate_logbook(const struct logbook_shape *shape, struct dive_table *table)
+{
+	unsigned int state = shape->seed ^ 0x9e3779b9;
+	int nr_sites = MAX(shape->dive_sites, 1);
+	uint32_t *sites = malloc(nr_sites * sizeof(*sites));
+	timestamp_t when = shape->start;
+	char name[64];
+	int i;
+
+	if (!state)
+		state = 1;
+	for (i = 0; i < nr_sites; i++) {
+		degrees_t latitude = { random_between(&state, -60000000, 60000000) };
+		degrees_t longitude = { random_between(&state, -180000000, 180000000) };
+
+		snprintf(name, sizeof(name), "Generated site %d", i + 1);
+		sites[i] = create_dive_site_with_gps(name, latitude, longitude, shape->start + i);
+	}
+	for (i = 0; i < shape->dives; i++) {
+		struct dive *dive = generate_dive(shape, sites, nr_sites, when, &state);
+
+		dive->number = i + 1;
+		record_dive_to_table(dive, table);
+		/* one to three dives a day, now and then a few days off */
+		when += dive->duration.seconds + random_between(&state, 1, 4) * 3600;
+		if (random_between(&state, 0, 2) == 0)
+			when += random_between(&state, 1, 30) * 24 * 3600;
+	}
+	free(sites);
+}
@@ -0,0 +1,28 @@
+#ifndef GENERATE_LOGBOOK_H
+#define GENERATE_LOGBOOK_H
+
+#include "dive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What a generated logbook looks like */
+struct logbook_shape {
+	int dives;
+	int dive_sites;		// the dives are spread over that many sites
+	int sample_rate;	// seconds between samples of the first dive computer
+	int dive_computers;	// per dive, at least one
+	int ccr_percent;	// of the dives, on a rebreather with three O2 sensors
+	timestamp_t start;	// of the first dive
+	unsigned int seed;	// the same seed gives the same logbook
+};
+
+extern void default_logbook_shape(struct logbook_shape *shape);
+extern void generate_logbook(const struct logbook_shape *shape, struct dive_table *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GENERATE_LOGBOOK_H
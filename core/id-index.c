@@ -0,0 +1,91 @@
+/* id-index.c
+ *
+ * A hash of ids to table positions, for the tables that are looked up by
+ * id all the time. Open addressing with linear probing; the index is kept
+ * at most half full, so the probes stay short.
+ */
+#include <stdlib.h>
+#include "id-index.h"
+
+static unsigned int home_slot(const struct id_index *index, uint32_t id)
+{
+	return (id * 2654435761u) & (index->size - 1);
+}
+
+/* the slot with id, or the empty one where it would go */
+static unsigned int find_slot(const struct id_index *index, uint32_t id)
+{
+	unsigned int slot = home_slot(index, id);
+
+	while (index->entries[slot].idx >= 0 && index->entries[slot].id != id)
+		slot = (slot + 1) & (index->size - 1);
+	return slot;
+}
+
+/* the table position of id, -1 if it isn't in the index */
+int id_index_get(const struct id_index *index, uint32_t id)
+{
+	if (!index->size)
+		return -1;
+	return index->entries[find_slot(index, id)].idx;
+}
+
+void id_index_set(struct id_index *index, uint32_t id, int idx)
+{
+	unsigned int slot;
+
+	if ((index->used + 1) * 2 > index->size) {
+		struct id_index_entry *old = index->entries;
+		unsigned int i, old_size = index->size;
+
+		index->size = old_size ? old_size * 2 : 64;
+		index->entries = malloc(index->size * sizeof(*index->entries));
+		if (!index->entries)
+			exit(1);
+		for (i = 0; i < index->size; i++)
+			index->entries[i].idx = -1;
+		for (i = 0; i < old_size; i++) {
+			if (old[i].idx >= 0)
+				index->entries[find_slot(index, old[i].id)] = old[i];
+		}
+		free(old);
+	}
+	slot = find_slot(index, id);
+	if (index->entries[slot].idx < 0)
+		index->used++;
+	index->entries[slot].id = id;
+	index->entries[slot].idx = idx;
+}
+
+/* only if id is at idx - a table may briefly have two entries with the same id */
+void id_index_remove(struct id_index *index, uint32_t id, int idx)
+{
+	unsigned int slot, next, home, mask = index->size - 1;
+
+	if (!index->size)
+		return;
+	slot = find_slot(index, id);
+	if (index->entries[slot].idx < 0 || index->entries[slot].idx != idx)
+		return;
+	index->entries[slot].idx = -1;
+	index->used--;
+	/* move back the entries that had to probe past the slot, or they wouldn't be found */
+	for (next = (slot + 1) & mask; index->entries[next].idx >= 0; next = (next + 1) & mask) {
+		home = home_slot(index, index->entries[next].id);
+		if (((next - home) & mask) < ((next - slot) & mask))
+			continue;
+		index->entries[slot] = index->entries[next];
+		index->entries[next].idx = -1;
+		slot = next;
+	}
+}
+
+/* empty, but with the memory kept for refilling it */
+void id_index_clear(struct id_index *index)
+{
+	unsigned int i;
+
+	for (i = 0; i < index->size; i++)
+		index->entries[i].idx = -1;
+	index->used = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef ID_INDEX_H
+#define ID_INDEX_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Where the entry with an id is in a table, e.g. of dives or of dive sites */
+struct id_index_entry {
+	uint32_t id;
+	int idx;			// -1 for an empty slot
+};
+
+struct id_index {
+	struct id_index_entry *entries;
+	unsigned int size, used;	// size is a power of two
+};
+
+extern int id_index_get(const struct id_index *index, uint32_t id);
+extern void id_index_set(struct id_index *index, uint32_t id, int idx);
+extern void id_index_remove(struct id_index *index, uint32_t id, int idx);
+extern void id_index_clear(struct id_index *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ID_INDEX_H
@@ -185,7 +185,7 @@ static void parse_dive_gps(char *line, struct membuffer *str, void *_dive)
 		uuid = get_dive_site_uuid_by_gps(latitude, longitude, NULL);
 		if (!uuid)
 			uuid = create_dive_site_with_gps("", latitude, longitude, dive->when);
-		dive->dive_site_uuid = uuid;
+		set_dive_site_uuid(dive, uuid);
 	} else {
 		if (dive_site_has_gps_location(ds) &&
 		    (ds->latitude.udeg != latitude.udeg || ds->longitude.udeg != longitude.udeg)) {
@@ -194,8 +194,7 @@ static void parse_dive_gps(char *line, struct membuffer *str, void *_dive)
 			ds->notes = add_to_string(ds->notes, translate("gettextFromC", "multiple GPS locations for this dive site; also %s\n"), coords);
 			free((void *)coords);
 		}
-		ds->latitude = latitude;
-		ds->longitude = longitude;
+		set_dive_site_gps(ds, latitude, longitude);
 	}
 
 }
@@ -211,7 +210,7 @@ static void parse_dive_location(char *line, struct membuffer *str, void *_dive)
 		uuid = get_dive_site_uuid_by_name(name, NULL);
 		if (!uuid)
 			uuid = create_dive_site(name, dive->when);
-		dive->dive_site_uuid = uuid;
+		set_dive_site_uuid(dive, uuid);
 	} else {
 		// we already had a dive site linked to the dive
 		if (same_string(ds->name, "")) {
@@ -238,7 +237,7 @@ static void parse_dive_notes(char *line, struct membuffer *str, void *_dive)
 { (void) line; struct dive *dive = _dive; dive->notes = get_utf8(str); }
 
 static void parse_dive_divesiteid(char *line, struct membuffer *str, void *_dive)
-{ (void) str; struct dive *dive = _dive; dive->dive_site_uuid = get_hex(line); }
+{ (void) str; struct dive *dive = _dive; set_dive_site_uuid(dive, get_hex(line)); }
 
 /*
  * We can have multiple tags in the membuffer. They are separated by
@@ -304,9 +303,10 @@ static void parse_site_gps(char *line, struct membuffer *str, void *_ds)
 {
 	(void) str;
 	struct dive_site *ds = _ds;
+	degrees_t latitude = parse_degrees(line, &line);
+	degrees_t longitude = parse_degrees(line, &line);
 
-	ds->latitude = parse_degrees(line, &line);
-	ds->longitude = parse_degrees(line, &line);
+	set_dive_site_gps(ds, latitude, longitude);
 }
 
 static void parse_site_geo(char *line, struct membuffer *str, void *_ds)
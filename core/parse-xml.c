@@ -75,6 +75,9 @@ void record_dive_to_table(struct dive *dive, struct dive_table *table)
 
 	dives[nr] = fixup_dive(dive);
 	table->nr = nr + 1;
+	add_to_dive_index(table, nr);
+	if (table == &dive_table)
+		invalidate_dive_site_counts();
 }
 
 void record_dive(struct dive *dive)
@@ -1174,11 +1177,11 @@ static void gps_lat(char *buffer, struct dive *dive)
 	degrees_t latitude = parse_degrees(buffer, &end);
 	struct dive_site *ds = get_dive_site_for_dive(dive);
 	if (!ds) {
-		dive->dive_site_uuid = create_dive_site_with_gps(NULL, latitude, (degrees_t){0}, dive->when);
+		set_dive_site_uuid(dive, create_dive_site_with_gps(NULL, latitude, (degrees_t){0}, dive->when));
 	} else {
 		if (ds->latitude.udeg && ds->latitude.udeg != latitude.udeg)
 			fprintf(stderr, "Oops, changing the latitude of existing dive site id %8x name %s; not good\n", ds->uuid, ds->name ?: "(unknown)");
-		ds->latitude = latitude;
+		set_dive_site_gps(ds, latitude, ds->longitude);
 	}
 }
 
@@ -1188,11 +1191,11 @@ static void gps_long(char *buffer, struct dive *dive)
 	degrees_t longitude = parse_degrees(buffer, &end);
 	struct dive_site *ds = get_dive_site_for_dive(dive);
 	if (!ds) {
-		dive->dive_site_uuid = create_dive_site_with_gps(NULL, (degrees_t){0}, longitude, dive->when);
+		set_dive_site_uuid(dive, create_dive_site_with_gps(NULL, (degrees_t){0}, longitude, dive->when));
 	} else {
 		if (ds->longitude.udeg && ds->longitude.udeg != longitude.udeg)
 			fprintf(stderr, "Oops, changing the longitude of existing dive site id %8x name %s; not good\n", ds->uuid, ds->name ?: "(unknown)");
-		ds->longitude = longitude;
+		set_dive_site_gps(ds, ds->latitude, longitude);
 	}
 
 }
@@ -1201,8 +1204,10 @@ static void gps_location(char *buffer, struct dive_site *ds)
 {
 	char *end;
 
-	ds->latitude = parse_degrees(buffer, &end);
-	ds->longitude = parse_degrees(end, &end);
+	degrees_t latitude = parse_degrees(buffer, &end);
+	degrees_t longitude = parse_degrees(end, &end);
+
+	set_dive_site_gps(ds, latitude, longitude);
 }
 
 /* this is in qthelper.cpp, so including the .h file is a pain */
@@ -1224,9 +1229,9 @@ static void gps_in_dive(char *buffer, struct dive *dive)
 			// remember the original coordinates so we can create the correct dive site later
 			cur_latitude = latitude;
 			cur_longitude = longitude;
-			dive->dive_site_uuid = uuid;
+			set_dive_site_uuid(dive, uuid);
 		} else {
-			dive->dive_site_uuid = create_dive_site_with_gps("", latitude, longitude, dive->when);
+			set_dive_site_uuid(dive, create_dive_site_with_gps("", latitude, longitude, dive->when));
 			ds = get_dive_site_by_uuid(dive->dive_site_uuid);
 		}
 	} else {
@@ -1242,8 +1247,7 @@ static void gps_in_dive(char *buffer, struct dive *dive)
 			ds->notes = add_to_string(ds->notes, translate("gettextFromC", "multiple GPS locations for this dive site; also %s\n"), coords);
 			free((void *)coords);
 		} else {
-			ds->latitude = latitude;
-			ds->longitude = longitude;
+			set_dive_site_gps(ds, latitude, longitude);
 		}
 	}
 }
@@ -1289,26 +1293,24 @@ static void add_dive_site(char *ds_name, struct dive *dive)
 				// way around
 				uint32_t exact_match_uuid = get_dive_site_uuid_by_gps_and_name(buffer, ds->latitude, ds->longitude);
 				if (exact_match_uuid) {
-					dive->dive_site_uuid = exact_match_uuid;
+					set_dive_site_uuid(dive, exact_match_uuid);
 				} else {
-					dive->dive_site_uuid = create_dive_site(buffer, dive->when);
+					set_dive_site_uuid(dive, create_dive_site(buffer, dive->when));
 					struct dive_site *newds = get_dive_site_by_uuid(dive->dive_site_uuid);
 					if (cur_latitude.udeg || cur_longitude.udeg) {
 						// we started this uuid with GPS data, so lets use those
-						newds->latitude = cur_latitude;
-						newds->longitude = cur_longitude;
+						set_dive_site_gps(newds, cur_latitude, cur_longitude);
 					} else {
-						newds->latitude = ds->latitude;
-						newds->longitude = ds->longitude;
+						set_dive_site_gps(newds, ds->latitude, ds->longitude);
 					}
 					newds->notes = add_to_string(newds->notes, translate("gettextFromC", "additional name for site: %s\n"), ds->name);
 				}
 			} else {
 				// add the existing dive site to the current dive
-				dive->dive_site_uuid = uuid;
+				set_dive_site_uuid(dive, uuid);
 			}
 		} else {
-			dive->dive_site_uuid = create_dive_site(buffer, dive->when);
+			set_dive_site_uuid(dive, create_dive_site(buffer, dive->when));
 		}
 	}
 	free(to_free);
@@ -2852,7 +2854,7 @@ extern int cobalt_location(void *handle, int columns, char **data, char **column
 			sprintf(tmp, "%s / %s", location, data[0]);
 			free(location);
 			location = NULL;
-			cur_dive->dive_site_uuid = find_or_create_dive_site_with_name(tmp, cur_dive->when);
+			set_dive_site_uuid(cur_dive, find_or_create_dive_site_with_name(tmp, cur_dive->when));
 			free(tmp);
 		} else {
 			location = strdup(data[0]);
@@ -3289,7 +3291,7 @@ extern int divinglog_dive(void *param, int columns, char **data, char **column)
 	cur_dive->when = (time_t)(atol(data[1]));
 
 	if (data[2])
-		cur_dive->dive_site_uuid = find_or_create_dive_site_with_name(data[2], cur_dive->when);
+		set_dive_site_uuid(cur_dive, find_or_create_dive_site_with_name(data[2], cur_dive->when));
 
 	if (data[3])
 		utf8_string(data[3], &cur_dive->buddy);
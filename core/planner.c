@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <string.h>
+#include <stddef.h>
 #include "dive.h"
 #include "deco.h"
 #include "divelist.h"
@@ -18,14 +19,15 @@
 
 #define TIMESTEP 2 /* second */
 #define DECOTIMESTEP 60 /* seconds. Unit of deco stop times */
+#define LONG_STOP_STEPS 4 /* deco time steps after which we stop trying to ascend after every single one */
 
-int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
+static const int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
 				  30000, 33000, 36000, 39000, 42000, 45000, 48000, 51000, 54000, 57000,
 				  60000, 63000, 66000, 69000, 72000, 75000, 78000, 81000, 84000, 87000,
 				  90000, 100000, 110000, 120000, 130000, 140000, 150000, 160000, 170000,
 				  180000, 190000, 200000, 220000, 240000, 260000, 280000, 300000,
 				  320000, 340000, 360000, 380000 };
-int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
+static const int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
 				30480, 33528, 36576, 39624, 42672, 45720, 48768, 51816, 54864, 57912,
 				60960, 64008, 67056, 70104, 73152, 76200, 79248, 82296, 85344, 88392,
 				91440, 101600, 111760, 121920, 132080, 142240, 152400, 162560, 172720,
@@ -35,14 +37,7 @@ int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 2133
 double plangflow, plangfhigh;
 bool plan_verbatim, plan_display_runtime, plan_display_duration, plan_display_transitions;
 
-extern double regressiona();
-extern double regressionb();
-extern void reset_regression();
-
-pressure_t first_ceiling_pressure, max_bottom_ceiling_pressure = {};
-
 const char *disclaimer;
-int plot_depth = 0;
 #if DEBUG_PLAN
 void dump_plan(struct diveplan *diveplan)
 {
@@ -116,24 +111,136 @@ int get_gasidx(struct dive *dive, struct gasmix *mix)
 	return find_best_gasmix_match(mix, dive->cylinder, 0);
 }
 
-void interpolate_transition(struct dive *dive, duration_t t0, duration_t t1, depth_t d0, depth_t d1, const struct gasmix *gasmix, o2pressure_t po2)
+void interpolate_transition(struct deco_state *ds, struct dive *dive, duration_t t0, duration_t t1, depth_t d0, depth_t d1, const struct gasmix *gasmix, o2pressure_t po2)
 {
 	uint32_t j;
 
 	for (j = t0.seconds; j < t1.seconds; j++) {
 		int depth = interpolate(d0.mm, d1.mm, j - t0.seconds, t1.seconds - t0.seconds);
-		add_segment(depth_to_bar(depth, dive), gasmix, 1, po2.mbar, dive, prefs.bottomsac);
+		add_segment(ds, depth_to_bar(depth, dive), gasmix, 1, po2.mbar, dive, prefs.bottomsac);
 	}
 	if (d1.mm > d0.mm)
-		calc_crushing_pressure(depth_to_bar(d1.mm, &displayed_dive));
+		calc_crushing_pressure(ds, depth_to_bar(d1.mm, dive));
+}
+
+/* What went into one sample of a planned dive, and the tissues after it */
+struct plan_checkpoint {
+	int time, depth;
+	struct gasmix gas;
+	int setpoint;
+	struct deco_state ds;
+};
+
+/* The checkpoints of the samples of one replay, and what it started from */
+struct plan_replay {
+	struct deco_state start;
+	enum deco_mode mode;
+	bool planner;
+	int bottomsac, surface_pressure, salinity;
+	enum dive_comp_type divemode;
+	unsigned int used;
+	int nr, allocated;
+	struct plan_checkpoint *checkpoint;
+};
+
+/* The deco state without the factor cache, which doesn't change the results */
+static bool same_deco_start(const struct deco_state *a, const struct deco_state *b)
+{
+	size_t start = offsetof(struct deco_state, tissue_n2_sat);
+	size_t end = offsetof(struct deco_state, factor_cache);
+
+	return a->settings.gf_low == b->settings.gf_low && a->settings.gf_high == b->settings.gf_high &&
+	       a->settings.gf_low_at_maxdepth == b->settings.gf_low_at_maxdepth &&
+	       a->settings.vpmb_conservatism == b->settings.vpmb_conservatism &&
+	       !memcmp((const char *)a + start, (const char *)b + start, end - start);
+}
+
+/*
+ * The replay that started from the same tissues under the same circumstances,
+ * or the one that wasn't used for the longest time, emptied for this one.
+ */
+static struct plan_replay *get_plan_replay(struct plan_checkpoints *checkpoints, const struct deco_state *ds, const struct dive *dive)
+{
+	struct plan_replay *replay = NULL;
+	int i;
+
+	for (i = 0; i < PLAN_REPLAYS; i++) {
+		struct plan_replay *r = checkpoints->replay[i];
+
+		if (!r) {
+			r = checkpoints->replay[i] = calloc(1, sizeof(struct plan_replay));
+			r->nr = -1;
+		}
+		if (r->nr >= 0 && r->mode == ds->settings.deco_mode && r->planner == ds->settings.in_planner &&
+		    r->bottomsac == prefs.bottomsac && r->surface_pressure == dive->surface_pressure.mbar &&
+		    r->salinity == dive->salinity && r->divemode == dive->dc.divemode && same_deco_start(&r->start, ds)) {
+			replay = r;
+			break;
+		}
+		if (!replay || r->used < replay->used)
+			replay = r;
+	}
+	if (i == PLAN_REPLAYS) {
+		replay->start = *ds;
+		replay->mode = ds->settings.deco_mode;
+		replay->planner = ds->settings.in_planner;
+		replay->bottomsac = prefs.bottomsac;
+		replay->surface_pressure = dive->surface_pressure.mbar;
+		replay->salinity = dive->salinity;
+		replay->divemode = dive->dc.divemode;
+		replay->nr = 0;
+	}
+	replay->used = ++checkpoints->used;
+	return replay;
+}
+
+static void add_plan_checkpoint(struct plan_replay *replay, const struct sample *sample, const struct gasmix *gas, o2pressure_t setpoint, const struct deco_state *ds)
+{
+	struct plan_checkpoint *checkpoint;
+
+	if (replay->nr >= replay->allocated) {
+		replay->allocated = (replay->allocated + 8) * 3 / 2;
+		replay->checkpoint = realloc(replay->checkpoint, replay->allocated * sizeof(struct plan_checkpoint));
+	}
+	checkpoint = replay->checkpoint + replay->nr++;
+	checkpoint->time = sample->time.seconds;
+	checkpoint->depth = sample->depth.mm;
+	checkpoint->gas = *gas;
+	checkpoint->setpoint = setpoint.mbar;
+	checkpoint->ds = *ds;
+}
+
+static bool same_plan_checkpoint(const struct plan_checkpoint *checkpoint, const struct sample *sample, const struct gasmix *gas, o2pressure_t setpoint)
+{
+	return checkpoint->time == sample->time.seconds && checkpoint->depth == sample->depth.mm &&
+	       gasmix_distance(&checkpoint->gas, gas) == 0 && checkpoint->setpoint == setpoint.mbar;
 }
 
-/* returns the tissue tolerance at the end of this (partial) dive */
-unsigned int tissue_at_end(struct dive *dive, char **cached_datap)
+void free_plan_checkpoints(struct plan_checkpoints *checkpoints)
+{
+	int i;
+
+	for (i = 0; i < PLAN_REPLAYS; i++) {
+		if (checkpoints->replay[i])
+			free(checkpoints->replay[i]->checkpoint);
+		free(checkpoints->replay[i]);
+		checkpoints->replay[i] = NULL;
+	}
+}
+
+/*
+ * returns the tissue tolerance at the end of this (partial) dive
+ *
+ * With checkpoints, the tissues after every sample are kept: when the same
+ * dive is replayed from the same tissues with only later waypoints changed,
+ * it picks up after the last sample that is still the same.
+ */
+unsigned int tissue_at_end(struct deco_state *ds, struct dive *dive, char **cached_datap, struct plan_checkpoints *checkpoints)
 {
 	struct divecomputer *dc;
 	struct sample *sample, *psample;
-	int i;
+	struct plan_replay *replay = NULL;
+	int i = 0;
 	depth_t lastdepth = {};
 	duration_t t0 = {}, t1 = {};
 	struct gasmix gas;
@@ -142,17 +249,35 @@ unsigned int tissue_at_end(struct dive *dive, char **cached_datap)
 	if (!dive)
 		return 0;
 	if (*cached_datap) {
-		restore_deco_state(*cached_datap);
+		restore_deco_state(ds, *cached_datap);
 	} else {
-		surface_interval = init_decompression(dive);
-		cache_deco_state(cached_datap);
+		surface_interval = init_decompression(ds, dive, &ds->settings);
+		cache_deco_state(ds, cached_datap);
 	}
 	dc = &dive->dc;
 	if (!dc->samples)
 		return 0;
 	psample = sample = dc->sample;
 
-	for (i = 0; i < dc->samples; i++, sample++) {
+	if (checkpoints) {
+		replay = get_plan_replay(checkpoints, ds, dive);
+		while (i < replay->nr && i < dc->samples) {
+			o2pressure_t setpoint = i ? sample[-1].setpoint : sample[0].setpoint;
+
+			get_gas_at_time(dive, dc, t0, &gas);
+			if (!same_plan_checkpoint(replay->checkpoint + i, sample, &gas, setpoint))
+				break;
+			psample = sample;
+			t0 = sample->time;
+			i++;
+			sample++;
+		}
+		replay->nr = i;
+		if (i)
+			*ds = replay->checkpoint[i - 1].ds;
+	}
+
+	for (; i < dc->samples; i++, sample++) {
 		o2pressure_t setpoint;
 
 		if (i)
@@ -174,21 +299,23 @@ unsigned int tissue_at_end(struct dive *dive, char **cached_datap)
 		 * portion of the dive.
 		 * Remember the value for later.
 		 */
-		if ((decoMode() == VPMB) && (lastdepth.mm > sample->depth.mm)) {
+		if ((ds->settings.deco_mode == VPMB) && (lastdepth.mm > sample->depth.mm)) {
 			pressure_t ceiling_pressure;
-			nuclear_regeneration(t0.seconds);
-			vpmb_start_gradient();
-			ceiling_pressure.mbar = depth_to_mbar(deco_allowed_depth(tissue_tolerance_calc(dive,
+			nuclear_regeneration(ds, t0.seconds);
+			vpmb_start_gradient(ds);
+			ceiling_pressure.mbar = depth_to_mbar(deco_allowed_depth(tissue_tolerance_calc(ds, dive,
 													depth_to_bar(lastdepth.mm, dive)),
 										dive->surface_pressure.mbar / 1000.0,
 										dive,
 										1),
 								dive);
-			if (ceiling_pressure.mbar > max_bottom_ceiling_pressure.mbar)
-				max_bottom_ceiling_pressure.mbar = ceiling_pressure.mbar;
+			if (ceiling_pressure.mbar > ds->max_bottom_ceiling_pressure.mbar)
+				ds->max_bottom_ceiling_pressure.mbar = ceiling_pressure.mbar;
 		}
 
-		interpolate_transition(dive, t0, t1, lastdepth, sample->depth, &gas, setpoint);
+		interpolate_transition(ds, dive, t0, t1, lastdepth, sample->depth, &gas, setpoint);
+		if (replay)
+			add_plan_checkpoint(replay, sample, &gas, setpoint, ds);
 		psample = sample;
 		t0 = t1;
 	}
@@ -251,9 +378,9 @@ static void update_cylinder_pressure(struct dive *d, int old_depth, int new_dept
 	}
 }
 
-/* simply overwrite the data in the displayed_dive
+/* simply overwrite the data in the given dive
  * return false if something goes wrong */
-static void create_dive_from_plan(struct diveplan *diveplan, bool track_gas)
+static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive, bool track_gas)
 {
 	struct divedatapoint *dp;
 	struct divecomputer *dc;
@@ -264,7 +391,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, bool track_gas)
 	int lasttime = 0;
 	int lastdepth = 0;
 	int lastcylid = 0;
-	enum dive_comp_type type = displayed_dive.dc.divemode;
+	enum dive_comp_type type = dive->dc.divemode;
 
 	if (!diveplan || !diveplan->dp)
 		return;
@@ -272,24 +399,22 @@ static void create_dive_from_plan(struct diveplan *diveplan, bool track_gas)
 	printf("in create_dive_from_plan\n");
 	dump_plan(diveplan);
 #endif
-	displayed_dive.salinity = diveplan->salinity;
+	dive->salinity = diveplan->salinity;
 	// reset the cylinders and clear out the samples and events of the
 	// displayed dive so we can restart
-	reset_cylinders(&displayed_dive, track_gas);
-	dc = &displayed_dive.dc;
-	dc->when = displayed_dive.when = diveplan->when;
+	reset_cylinders(dive, track_gas);
+	dc = &dive->dc;
+	dc->when = dive->when = diveplan->when;
 	dc->surface_pressure.mbar = diveplan->surface_pressure;
 	dc->salinity = diveplan->salinity;
-	free(dc->sample);
-	dc->sample = NULL;
+	// keep the memory of the samples, a plan is recreated for every change
 	dc->samples = 0;
-	dc->alloc_samples = 0;
 	while ((ev = dc->events)) {
 		dc->events = dc->events->next;
 		free(ev);
 	}
 	dp = diveplan->dp;
-	cyl = &displayed_dive.cylinder[lastcylid];
+	cyl = &dive->cylinder[lastcylid];
 	sample = prepare_sample(dc);
 	sample->setpoint.mbar = dp->setpoint;
 	sample->sac.mliter = prefs.bottomsac;
@@ -324,8 +449,8 @@ static void create_dive_from_plan(struct diveplan *diveplan, bool track_gas)
 		/* Make sure we have the new gas, and create a gas change event */
 		if (dp->cylinderid != lastcylid) {
 			/* need to insert a first sample for the new gas */
-			add_gas_switch_event(&displayed_dive, dc, lasttime + 1, dp->cylinderid);
-			cyl = &displayed_dive.cylinder[dp->cylinderid];
+			add_gas_switch_event(dive, dc, lasttime + 1, dp->cylinderid);
+			cyl = &dive->cylinder[dp->cylinderid];
 			sample = prepare_sample(dc);
 			sample[-1].setpoint.mbar = po2;
 			sample->time.seconds = lasttime + 1;
@@ -348,7 +473,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, bool track_gas)
 		sample->manually_entered = dp->entered;
 		sample->sac.mliter = dp->entered ? prefs.bottomsac : prefs.decosac;
 		if (track_gas && !sample[-1].setpoint.mbar) {    /* Don't track gas usage for CCR legs of dive */
-			update_cylinder_pressure(&displayed_dive, sample[-1].depth.mm, depth, time - sample[-1].time.seconds,
+			update_cylinder_pressure(dive, sample[-1].depth.mm, depth, time - sample[-1].time.seconds,
 					dp->entered ? diveplan->bottomsac : diveplan->decosac, cyl, !dp->entered);
 			if (cyl->type.workingpressure.mbar)
 				sample->cylinderpressure.mbar = cyl->end.mbar;
@@ -358,7 +483,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, bool track_gas)
 	}
 	dc->divemode = type;
 #if DEBUG_PLAN & 32
-	save_dive(stdout, &displayed_dive);
+	save_dive(stdout, dive);
 #endif
 	return;
 }
@@ -420,12 +545,12 @@ struct gaschanges {
 };
 
 
-static struct gaschanges *analyze_gaslist(struct diveplan *diveplan, int *gaschangenr, int depth, int *asc_cylinder)
+static struct gaschanges *analyze_gaslist(struct diveplan *diveplan, struct dive *dive, int *gaschangenr, int depth, int *asc_cylinder)
 {
 	int nr = 0;
 	struct gaschanges *gaschanges = NULL;
 	struct divedatapoint *dp = diveplan->dp;
-	int best_depth = displayed_dive.cylinder[*asc_cylinder].depth.mm;
+	int best_depth = dive->cylinder[*asc_cylinder].depth.mm;
 	while (dp) {
 		if (dp->time == 0) {
 			if (dp->depth <= depth) {
@@ -457,7 +582,7 @@ static struct gaschanges *analyze_gaslist(struct diveplan *diveplan, int *gascha
 	for (nr = 0; nr < *gaschangenr; nr++) {
 		int idx = gaschanges[nr].gasidx;
 		printf("gaschange nr %d: @ %5.2lfm gasidx %d (%s)\n", nr, gaschanges[nr].depth / 1000.0,
-		       idx, gasname(&displayed_dive.cylinder[idx].gasmix));
+		       idx, gasname(&dive->cylinder[idx].gasmix));
 	}
 #endif
 	return gaschanges;
@@ -808,6 +933,7 @@ static void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool
 
 	dive->cns = 0;
 	dive->maxcns = 0;
+	dive->cylinder_info.valid = false;
 	update_cylinder_related_info(dive);
 	snprintf(temp, sz_temp, "%s", translate("gettextFromC", "CNS"));
 	len += snprintf(buffer + len, sz_buffer - len, "<div><br>%s: %i%%", temp, dive->cns);
@@ -914,15 +1040,15 @@ int ascent_velocity(int depth, int avg_depth, int bottom_time)
 	}
 }
 
-void track_ascent_gas(int depth, cylinder_t *cylinder, int avg_depth, int bottom_time, bool safety_stop)
+void track_ascent_gas(struct dive *dive, int depth, cylinder_t *cylinder, int avg_depth, int bottom_time, bool safety_stop)
 {
 	while (depth > 0) {
 		int deltad = ascent_velocity(depth, avg_depth, bottom_time) * TIMESTEP;
 		if (deltad > depth)
 			deltad = depth;
-		update_cylinder_pressure(&displayed_dive, depth, depth - deltad, TIMESTEP, prefs.decosac, cylinder, true);
+		update_cylinder_pressure(dive, depth, depth - deltad, TIMESTEP, prefs.decosac, cylinder, true);
 		if (depth <= 5000 && depth >= (5000 - deltad) && safety_stop) {
-			update_cylinder_pressure(&displayed_dive, 5000, 5000, 180, prefs.decosac, cylinder, true);
+			update_cylinder_pressure(dive, 5000, 5000, 180, prefs.decosac, cylinder, true);
 			safety_stop = false;
 		}
 		depth -= deltad;
@@ -930,49 +1056,114 @@ void track_ascent_gas(int depth, cylinder_t *cylinder, int avg_depth, int bottom
 }
 
 // Determine whether ascending to the next stop will break the ceiling.  Return true if the ascent is ok, false if it isn't.
-bool trial_ascent(int trial_depth, int stoplevel, int avg_depth, int bottom_time, struct gasmix *gasmix, int po2, double surface_pressure)
+bool trial_ascent(struct deco_state *ds, struct dive *dive, int trial_depth, int stoplevel, int avg_depth, int bottom_time, struct gasmix *gasmix, int po2, double surface_pressure)
 {
 
 	bool clear_to_ascend = true;
-	char *trial_cache = NULL;
+	struct deco_snapshot trial_snapshot;
 
 	// For consistency with other VPM-B implementations, we should not start the ascent while the ceiling is
 	// deeper than the next stop (thus the offgasing during the ascent is ignored).
 	// However, we still need to make sure we don't break the ceiling due to on-gassing during ascent.
-	if (decoMode() == VPMB && (deco_allowed_depth(tissue_tolerance_calc(&displayed_dive,
-										 depth_to_bar(stoplevel, &displayed_dive)),
-							   surface_pressure, &displayed_dive, 1) > stoplevel))
+	if (ds->settings.deco_mode == VPMB && (deco_allowed_depth(tissue_tolerance_calc(ds, dive,
+										 depth_to_bar(stoplevel, dive)),
+							   surface_pressure, dive, 1) > stoplevel))
 		return false;
 
-	cache_deco_state(&trial_cache);
+	save_deco_snapshot(ds, &trial_snapshot);
 	while (trial_depth > stoplevel) {
 		int deltad = ascent_velocity(trial_depth, avg_depth, bottom_time) * TIMESTEP;
 		if (deltad > trial_depth) /* don't test against depth above surface */
 			deltad = trial_depth;
-		add_segment(depth_to_bar(trial_depth, &displayed_dive),
+		add_segment(ds, depth_to_bar(trial_depth, dive),
 			    gasmix,
-			    TIMESTEP, po2, &displayed_dive, prefs.decosac);
-		if (deco_allowed_depth(tissue_tolerance_calc(&displayed_dive, depth_to_bar(trial_depth, &displayed_dive)),
-				       surface_pressure, &displayed_dive, 1) > trial_depth - deltad) {
+			    TIMESTEP, po2, dive, prefs.decosac);
+		if (deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(trial_depth, dive)),
+				       surface_pressure, dive, 1) > trial_depth - deltad) {
 			/* We should have stopped */
 			clear_to_ascend = false;
 			break;
 		}
 		trial_depth -= deltad;
 	}
-	restore_deco_state(trial_cache);
-	free(trial_cache);
+	restore_deco_snapshot(ds, &trial_snapshot);
 	return clear_to_ascend;
 }
 
+/* Wait at a deco stop for the given number of deco time steps, each ending at a whole minute of runtime */
+static void wait_at_stop(struct deco_state *ds, struct dive *dive, int *clock, int steps, int depth, struct gasmix *gasmix, int po2)
+{
+	while (steps-- > 0) {
+		int this_decotimestep = DECOTIMESTEP - *clock % DECOTIMESTEP;
+
+		add_segment(ds, depth_to_bar(depth, dive), gasmix, this_decotimestep, po2, dive, prefs.decosac);
+		*clock += this_decotimestep;
+	}
+}
+
+/*
+ * We can't ascend from this stop right now. How many deco time steps do we have
+ * to wait until trial_ascent() lets us go? Rather than trying the ascent after every
+ * step, keep doubling the waiting time until it is clear and then bisect. This only
+ * works on copies of the deco state, stepped the same way plan() steps the real one,
+ * so the answer is exactly what trying after every step would have given - provided
+ * waiting longer never hurts. That is the case unless one of the compartments still
+ * taking up gas could get loaded enough to block the ascent; then return 1 and let
+ * plan() try after the next step as usual.
+ * Don't wait for more than max_steps.
+ */
+static int stop_steps_until_clear(struct deco_state *ds, struct dive *dive, int clock, int depth, int stoplevel, int avg_depth, int bottom_time,
+				  struct gasmix *gasmix, int po2, double surface_pressure, int max_steps)
+{
+	struct deco_state low_state, probe;
+	int low = 0, high = 1, low_clock = clock, probe_clock;
+
+	if (max_steps <= 1 ||
+	    deco_allowed_depth(ongassing_tolerance_limit(ds, depth_to_bar(depth, dive), gasmix, po2, dive),
+			       surface_pressure, dive, 1) > stoplevel)
+		return 1;
+
+	low_state = *ds;
+	while (1) {
+		probe = low_state;
+		probe_clock = low_clock;
+		wait_at_stop(&probe, dive, &probe_clock, high - low, depth, gasmix, po2);
+		if (trial_ascent(&probe, dive, depth, stoplevel, avg_depth, bottom_time, gasmix, po2, surface_pressure))
+			break;
+		if (high == max_steps)
+			return max_steps;
+		low = high;
+		low_state = probe;
+		low_clock = probe_clock;
+		high = MIN(2 * high, max_steps);
+	}
+
+	/* Still stuck after low steps, clear after high steps */
+	while (high - low > 1) {
+		int mid = (low + high) / 2;
+
+		probe = low_state;
+		probe_clock = low_clock;
+		wait_at_stop(&probe, dive, &probe_clock, mid - low, depth, gasmix, po2);
+		if (trial_ascent(&probe, dive, depth, stoplevel, avg_depth, bottom_time, gasmix, po2, surface_pressure)) {
+			high = mid;
+		} else {
+			low = mid;
+			low_state = probe;
+			low_clock = probe_clock;
+		}
+	}
+	return high;
+}
+
 /* Determine if there is enough gas for the dive.  Return true if there is enough.
  * Also return true if this cannot be calculated because the cylinder doesn't have
  * size or a starting pressure.
  */
-bool enough_gas(int current_cylinder)
+bool enough_gas(struct dive *dive, int current_cylinder)
 {
 	cylinder_t *cyl;
-	cyl = &displayed_dive.cylinder[current_cylinder];
+	cyl = &dive->cylinder[current_cylinder];
 
 	if (!cyl->start.mbar)
 		return true;
@@ -982,9 +1173,16 @@ bool enough_gas(int current_cylinder)
 		return true;
 }
 
-// Work out the stops. Return value is if there were any mandatory stops.
-
-bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool show_disclaimer)
+/*
+ * Work out the stops and turn the plan into the samples, events and gas use of
+ * dive. This only touches the deco state and the dive it is given and uses the
+ * GF and conservatism of the plan rather than the global ones, so several plans
+ * can be calculated at the same time (see plan_sweep()). The deco mode comes
+ * from settings, which have to be taken with get_deco_settings() on the main
+ * thread. Return value is if there were any mandatory stops.
+ */
+bool calculate_plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, char **cached_datap, bool is_planner,
+		    const struct deco_settings *settings, int *error)
 {
 	int bottom_depth;
 	int bottom_gi;
@@ -992,7 +1190,7 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 	bool is_final_plan = true;
 	int deco_time;
 	int previous_deco_time;
-	char *bottom_cache = NULL;
+	struct deco_snapshot bottom_snapshot;
 	struct sample *sample;
 	int po2;
 	int transitiontime, gi;
@@ -1001,8 +1199,8 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 	int depth;
 	struct gaschanges *gaschanges = NULL;
 	int gaschangenr;
-	int *decostoplevels;
-	int decostoplevelcount;
+	int decostoplevels[sizeof(decostoplevels_metric) / sizeof(int)];
+	const int decostoplevelcount = sizeof(decostoplevels) / sizeof(int);
 	int *stoplevels = NULL;
 	bool stopping = false;
 	bool pendinggaschange = false;
@@ -1014,27 +1212,26 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 	int o2time = 0;
 	int breaktime = -1;
 	int breakcylinder = 0;
-	int error = 0;
 	bool decodive = false;
 	int first_stop_depth = 0;
+	int wait_steps, stop_steps;
+	struct deco_settings own = *settings;
 
-	set_gf(diveplan->gflow, diveplan->gfhigh, prefs.gf_low_at_maxdepth);
-	set_vpmb_conservatism(diveplan->vpmb_conservatism);
+	set_deco_settings_gf(&own, diveplan->gflow, diveplan->gfhigh, prefs.gf_low_at_maxdepth);
+	set_deco_settings_vpmb_conservatism(&own, diveplan->vpmb_conservatism);
+	*error = 0;
 	if (!diveplan->surface_pressure)
 		diveplan->surface_pressure = SURFACE_PRESSURE;
-	displayed_dive.surface_pressure.mbar = diveplan->surface_pressure;
-	clear_deco(displayed_dive.surface_pressure.mbar / 1000.0);
-	max_bottom_ceiling_pressure.mbar = first_ceiling_pressure.mbar = 0;
-	create_dive_from_plan(diveplan, is_planner);
+	dive->surface_pressure.mbar = diveplan->surface_pressure;
+	clear_deco(ds, dive->surface_pressure.mbar / 1000.0, &own);
+	ds->max_bottom_ceiling_pressure.mbar = ds->first_ceiling_pressure.mbar = 0;
+	create_dive_from_plan(diveplan, dive, is_planner);
 
 	// Do we want deco stop array in metres or feet?
-	if (prefs.units.length == METERS ) {
-		decostoplevels = decostoplevels_metric;
-		decostoplevelcount = sizeof(decostoplevels_metric) / sizeof(int);
-	} else {
-		decostoplevels = decostoplevels_imperial;
-		decostoplevelcount = sizeof(decostoplevels_imperial) / sizeof(int);
-	}
+	if (prefs.units.length == METERS )
+		memcpy(decostoplevels, decostoplevels_metric, sizeof(decostoplevels));
+	else
+		memcpy(decostoplevels, decostoplevels_imperial, sizeof(decostoplevels));
 
 	/* If the user has selected last stop to be at 6m/20', we need to get rid of the 3m/10' stop.
 	 * Otherwise reinstate the last stop 3m/10' stop.
@@ -1045,13 +1242,13 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 		*(decostoplevels + 1) = M_OR_FT(3,10);
 
 	/* Let's start at the last 'sample', i.e. the last manually entered waypoint. */
-	sample = &displayed_dive.dc.sample[displayed_dive.dc.samples - 1];
+	sample = &dive->dc.sample[dive->dc.samples - 1];
 
-	current_cylinder = get_cylinderid_at_time(&displayed_dive, &displayed_dive.dc, sample->time);
-	gas = displayed_dive.cylinder[current_cylinder].gasmix;
+	current_cylinder = get_cylinderid_at_time(dive, &dive->dc, sample->time);
+	gas = dive->cylinder[current_cylinder].gasmix;
 
 	po2 = sample->setpoint.mbar;
-	depth = displayed_dive.dc.sample[displayed_dive.dc.samples - 1].depth.mm;
+	depth = dive->dc.sample[dive->dc.samples - 1].depth.mm;
 	average_max_depth(diveplan, &avg_depth, &max_depth);
 	last_ascend_rate = ascent_velocity(depth, avg_depth, bottom_time);
 
@@ -1059,7 +1256,7 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 	if (!is_planner) {
 		transitiontime = depth / 75; /* this still needs to be made configurable */
 		plan_add_segment(diveplan, transitiontime, 0, current_cylinder, po2, false);
-		create_dive_from_plan(diveplan, is_planner);
+		create_dive_from_plan(diveplan, dive, is_planner);
 		return(false);
 	}
 
@@ -1076,7 +1273,7 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 		gaschanges = NULL;
 		gaschangenr = 0;
 	} else {
-		gaschanges = analyze_gaslist(diveplan, &gaschangenr, depth, &best_first_ascend_cylinder);
+		gaschanges = analyze_gaslist(diveplan, dive, &gaschangenr, depth, &best_first_ascend_cylinder);
 	}
 	/* Find the first potential decostopdepth above current depth */
 	for (stopidx = 0; stopidx < decostoplevelcount; stopidx++)
@@ -1089,33 +1286,33 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 	stopidx += gaschangenr;
 
 	/* Keep time during the ascend */
-	bottom_time = clock = previous_point_time = displayed_dive.dc.sample[displayed_dive.dc.samples - 1].time.seconds;
+	bottom_time = clock = previous_point_time = dive->dc.sample[dive->dc.samples - 1].time.seconds;
 	gi = gaschangenr - 1;
 
 	/* Set tissue tolerance and initial vpmb gradient at start of ascent phase */
-	diveplan->surface_interval = tissue_at_end(&displayed_dive, cached_datap);
-	nuclear_regeneration(clock);
-	vpmb_start_gradient();
+	diveplan->surface_interval = tissue_at_end(ds, dive, cached_datap, diveplan->checkpoints);
+	nuclear_regeneration(ds, clock);
+	vpmb_start_gradient(ds);
 
-	if(decoMode() == RECREATIONAL) {
+	if(ds->settings.deco_mode == RECREATIONAL) {
 		bool safety_stop = prefs.safetystop && max_depth >= 10000;
-		track_ascent_gas(depth, &displayed_dive.cylinder[current_cylinder], avg_depth, bottom_time, safety_stop);
+		track_ascent_gas(dive, depth, &dive->cylinder[current_cylinder], avg_depth, bottom_time, safety_stop);
 		// How long can we stay at the current depth and still directly ascent to the surface?
 		do {
-			add_segment(depth_to_bar(depth, &displayed_dive),
-				    &displayed_dive.cylinder[current_cylinder].gasmix,
-				    DECOTIMESTEP, po2, &displayed_dive, prefs.bottomsac);
-			update_cylinder_pressure(&displayed_dive, depth, depth, DECOTIMESTEP, prefs.bottomsac, &displayed_dive.cylinder[current_cylinder], false);
+			add_segment(ds, depth_to_bar(depth, dive),
+				    &dive->cylinder[current_cylinder].gasmix,
+				    DECOTIMESTEP, po2, dive, prefs.bottomsac);
+			update_cylinder_pressure(dive, depth, depth, DECOTIMESTEP, prefs.bottomsac, &dive->cylinder[current_cylinder], false);
 			clock += DECOTIMESTEP;
-		} while (trial_ascent(depth, 0, avg_depth, bottom_time, &displayed_dive.cylinder[current_cylinder].gasmix,
+		} while (trial_ascent(ds, dive, depth, 0, avg_depth, bottom_time, &dive->cylinder[current_cylinder].gasmix,
 				      po2, diveplan->surface_pressure / 1000.0) &&
-			 enough_gas(current_cylinder));
+			 enough_gas(dive, current_cylinder));
 
 		// We did stay one DECOTIMESTEP too many.
 		// In the best of all worlds, we would roll back also the last add_segment in terms of caching deco state, but
 		// let's ignore that since for the eventual ascent in recreational mode, nobody looks at the ceiling anymore,
 		// so we don't really have to compute the deco state.
-		update_cylinder_pressure(&displayed_dive, depth, depth, -DECOTIMESTEP, prefs.bottomsac, &displayed_dive.cylinder[current_cylinder], false);
+		update_cylinder_pressure(dive, depth, depth, -DECOTIMESTEP, prefs.bottomsac, &dive->cylinder[current_cylinder], false);
 		clock -= DECOTIMESTEP;
 		plan_add_segment(diveplan, clock - previous_point_time, depth, current_cylinder, po2, true);
 		previous_point_time = clock;
@@ -1142,9 +1339,7 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 			}
 		} while (depth > 0);
 		plan_add_segment(diveplan, clock - previous_point_time, 0, current_cylinder, po2, false);
-		create_dive_from_plan(diveplan, is_planner);
-		add_plan_to_notes(diveplan, &displayed_dive, show_disclaimer, error);
-		fixup_dc_duration(&displayed_dive.dc);
+		create_dive_from_plan(diveplan, dive, is_planner);
 
 		free(stoplevels);
 		free(gaschanges);
@@ -1153,7 +1348,7 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 
 	if (best_first_ascend_cylinder != current_cylinder) {
 		current_cylinder = best_first_ascend_cylinder;
-		gas = displayed_dive.cylinder[current_cylinder].gasmix;
+		gas = dive->cylinder[current_cylinder].gasmix;
 
 #if DEBUG_PLAN & 16
 		printf("switch to gas %d (%d/%d) @ %5.2lfm\n", best_first_ascend_cylinder,
@@ -1162,10 +1357,10 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 	}
 
 	// VPM-B or Buehlmann Deco
-	tissue_at_end(&displayed_dive, cached_datap);
+	tissue_at_end(ds, dive, cached_datap, diveplan->checkpoints);
 	previous_deco_time = 100000000;
 	deco_time = 10000000;
-	cache_deco_state(&bottom_cache);  // Lets us make several iterations
+	save_deco_snapshot(ds, &bottom_snapshot);  // Lets us make several iterations
 	bottom_depth = depth;
 	bottom_gi = gi;
 	bottom_gas = gas;
@@ -1173,12 +1368,12 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 
 	//CVA
 	do {
-		is_final_plan = (decoMode() == BUEHLMANN) || (previous_deco_time - deco_time < 10);  // CVA time converges
+		is_final_plan = (ds->settings.deco_mode == BUEHLMANN) || (previous_deco_time - deco_time < 10);  // CVA time converges
 		if (deco_time != 10000000)
-			vpmb_next_gradient(deco_time, diveplan->surface_pressure / 1000.0);
+			vpmb_next_gradient(ds, deco_time, diveplan->surface_pressure / 1000.0);
 
 		previous_deco_time = deco_time;
-		restore_deco_state(bottom_cache);
+		restore_deco_snapshot(ds, &bottom_snapshot);
 
 		depth = bottom_depth;
 		gi = bottom_gi;
@@ -1191,21 +1386,21 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 		breaktime = -1;
 		breakcylinder = 0;
 		o2time = 0;
-		first_ceiling_pressure.mbar = depth_to_mbar(deco_allowed_depth(tissue_tolerance_calc(&displayed_dive,
-												     depth_to_bar(depth, &displayed_dive)),
+		ds->first_ceiling_pressure.mbar = depth_to_mbar(deco_allowed_depth(tissue_tolerance_calc(ds, dive,
+												     depth_to_bar(depth, dive)),
 									    diveplan->surface_pressure / 1000.0,
-									    &displayed_dive,
+									    dive,
 									    1),
-							 &displayed_dive);
-		if (max_bottom_ceiling_pressure.mbar > first_ceiling_pressure.mbar)
-			first_ceiling_pressure.mbar = max_bottom_ceiling_pressure.mbar;
+							 dive);
+		if (ds->max_bottom_ceiling_pressure.mbar > ds->first_ceiling_pressure.mbar)
+			ds->first_ceiling_pressure.mbar = ds->max_bottom_ceiling_pressure.mbar;
 
 		last_ascend_rate = ascent_velocity(depth, avg_depth, bottom_time);
-		if ((current_cylinder = get_gasidx(&displayed_dive, &gas)) == -1) {
+		if ((current_cylinder = get_gasidx(dive, &gas)) == -1) {
 			report_error(translate("gettextFromC", "Can't find gas %s"), gasname(&gas));
 			current_cylinder = 0;
 		}
-		reset_regression();
+		reset_regression(ds);
 		while (1) {
 			/* We will break out when we hit the surface */
 			do {
@@ -1221,14 +1416,14 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 				if (depth - deltad < stoplevels[stopidx])
 					deltad = depth - stoplevels[stopidx];
 
-				add_segment(depth_to_bar(depth, &displayed_dive),
-								&displayed_dive.cylinder[current_cylinder].gasmix,
-								TIMESTEP, po2, &displayed_dive, prefs.decosac);
+				add_segment(ds, depth_to_bar(depth, dive),
+								&dive->cylinder[current_cylinder].gasmix,
+								TIMESTEP, po2, dive, prefs.decosac);
 				clock += TIMESTEP;
 				depth -= deltad;
 				/* Print VPM-Gradient as gradient factor, this has to be done from within deco.c */
 				if (decodive)
-					plot_depth = depth;
+					ds->plot_depth = depth;
 			} while (depth > 0 && depth > stoplevels[stopidx]);
 
 			if (depth <= 0)
@@ -1249,20 +1444,20 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 
 				if (current_cylinder != gaschanges[gi].gasidx) {
 					if (!prefs.switch_at_req_stop ||
-							!trial_ascent(depth, stoplevels[stopidx - 1], avg_depth, bottom_time,
-							&displayed_dive.cylinder[current_cylinder].gasmix, po2, diveplan->surface_pressure / 1000.0) || get_o2(&displayed_dive.cylinder[current_cylinder].gasmix) < 160) {
+							!trial_ascent(ds, dive, depth, stoplevels[stopidx - 1], avg_depth, bottom_time,
+							&dive->cylinder[current_cylinder].gasmix, po2, diveplan->surface_pressure / 1000.0) || get_o2(&dive->cylinder[current_cylinder].gasmix) < 160) {
 						current_cylinder = gaschanges[gi].gasidx;
-						gas = displayed_dive.cylinder[current_cylinder].gasmix;
+						gas = dive->cylinder[current_cylinder].gasmix;
 #if DEBUG_PLAN & 16
 						printf("switch to gas %d (%d/%d) @ %5.2lfm\n", gaschanges[gi].gasidx,
 							(get_o2(&gas) + 5) / 10, (get_he(&gas) + 5) / 10, gaschanges[gi].depth / 1000.0);
 #endif
 						/* Stop for the minimum duration to switch gas */
-						add_segment(depth_to_bar(depth, &displayed_dive),
-							&displayed_dive.cylinder[current_cylinder].gasmix,
-							prefs.min_switch_duration, po2, &displayed_dive, prefs.decosac);
+						add_segment(ds, depth_to_bar(depth, dive),
+							&dive->cylinder[current_cylinder].gasmix,
+							prefs.min_switch_duration, po2, dive, prefs.decosac);
 						clock += prefs.min_switch_duration;
-						if (prefs.doo2breaks && get_o2(&displayed_dive.cylinder[current_cylinder].gasmix) == 1000)
+						if (prefs.doo2breaks && get_o2(&dive->cylinder[current_cylinder].gasmix) == 1000)
 							o2time += prefs.min_switch_duration;
 					} else {
 						/* The user has selected the option to switch gas only at required stops.
@@ -1276,10 +1471,15 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 			--stopidx;
 
 			/* Save the current state and try to ascend to the next stopdepth */
+			wait_steps = -1;
+			stop_steps = 0;
 			while (1) {
-				/* Check if ascending to next stop is clear, go back and wait if we hit the ceiling on the way */
-				if (trial_ascent(depth, stoplevels[stopidx], avg_depth, bottom_time,
-						&displayed_dive.cylinder[current_cylinder].gasmix, po2, diveplan->surface_pressure / 1000.0))
+				/* Check if ascending to next stop is clear, go back and wait if we hit the ceiling on the way.
+				 * No need to check while we know we still have to wait */
+				if (wait_steps > 0)
+					wait_steps--;
+				else if (trial_ascent(ds, dive, depth, stoplevels[stopidx], avg_depth, bottom_time,
+						&dive->cylinder[current_cylinder].gasmix, po2, diveplan->surface_pressure / 1000.0))
 					break; /* We did not hit the ceiling */
 
 				/* Add a minute of deco time and then try again */
@@ -1301,39 +1501,48 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 				 */
 				if (pendinggaschange) {
 					current_cylinder = gaschanges[gi + 1].gasidx;
-					gas = displayed_dive.cylinder[current_cylinder].gasmix;
+					gas = dive->cylinder[current_cylinder].gasmix;
 #if DEBUG_PLAN & 16
 					printf("switch to gas %d (%d/%d) @ %5.2lfm\n", gaschanges[gi + 1].gasidx,
 						(get_o2(&gas) + 5) / 10, (get_he(&gas) + 5) / 10, gaschanges[gi + 1].depth / 1000.0);
 #endif
 					/* Stop for the minimum duration to switch gas */
-					add_segment(depth_to_bar(depth, &displayed_dive),
-						&displayed_dive.cylinder[current_cylinder].gasmix,
-						prefs.min_switch_duration, po2, &displayed_dive, prefs.decosac);
+					add_segment(ds, depth_to_bar(depth, dive),
+						&dive->cylinder[current_cylinder].gasmix,
+						prefs.min_switch_duration, po2, dive, prefs.decosac);
 					clock += prefs.min_switch_duration;
-					if (prefs.doo2breaks && get_o2(&displayed_dive.cylinder[current_cylinder].gasmix) == 1000)
+					if (prefs.doo2breaks && get_o2(&dive->cylinder[current_cylinder].gasmix) == 1000)
 						o2time += prefs.min_switch_duration;
 					pendinggaschange = false;
 				}
 
+				/* If this turns out to be a long stop, find out how long up front.
+				 * Not if o2 breaks are going to change the gas on the way, though,
+				 * and not for VPM-B where a single tolerance calculation costs about
+				 * as much as the trial ascents it would save */
+				if (wait_steps < 0 && !prefs.doo2breaks && ds->settings.deco_mode != VPMB && ++stop_steps >= LONG_STOP_STEPS)
+					wait_steps = stop_steps_until_clear(ds, dive, clock, depth, stoplevels[stopidx], avg_depth, bottom_time,
+									    &dive->cylinder[current_cylinder].gasmix, po2,
+									    diveplan->surface_pressure / 1000.0, (48 * 3600 - clock) / DECOTIMESTEP) - 1;
+
 				/* Deco stop should end when runtime is at a whole minute */
 				int this_decotimestep;
 				this_decotimestep = DECOTIMESTEP - clock % DECOTIMESTEP;
 
-				add_segment(depth_to_bar(depth, &displayed_dive),
-								&displayed_dive.cylinder[current_cylinder].gasmix,
-								this_decotimestep, po2, &displayed_dive, prefs.decosac);
+				add_segment(ds, depth_to_bar(depth, dive),
+								&dive->cylinder[current_cylinder].gasmix,
+								this_decotimestep, po2, dive, prefs.decosac);
 				clock += this_decotimestep;
 				/* Finish infinite deco */
 				if(clock >= 48 * 3600 && depth >= 6000) {
-					error = LONGDECO;
+					*error = LONGDECO;
 					break;
 				}
 				if (prefs.doo2breaks) {
 					/* The backgas breaks option limits time on oxygen to 12 minutes, followed by 6 minutes on
 					 * backgas (first defined gas).  This could be customized if there were demand.
 					 */
-					if (get_o2(&displayed_dive.cylinder[current_cylinder].gasmix) == 1000) {
+					if (get_o2(&dive->cylinder[current_cylinder].gasmix) == 1000) {
 						o2time += DECOTIMESTEP;
 						if (o2time >= 12 * 60) {
 							breaktime = 0;
@@ -1342,7 +1551,7 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 								plan_add_segment(diveplan, clock - previous_point_time, depth, current_cylinder, po2, false);
 							previous_point_time = clock;
 							current_cylinder = 0;
-							gas = displayed_dive.cylinder[current_cylinder].gasmix;
+							gas = dive->cylinder[current_cylinder].gasmix;
 						}
 					} else {
 						if (breaktime >= 0) {
@@ -1353,7 +1562,7 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 									plan_add_segment(diveplan, clock - previous_point_time, depth, current_cylinder, po2, false);
 								previous_point_time = clock;
 								current_cylinder = breakcylinder;
-								gas = displayed_dive.cylinder[current_cylinder].gasmix;
+								gas = dive->cylinder[current_cylinder].gasmix;
 								breaktime = -1;
 							}
 						}
@@ -1373,21 +1582,129 @@ bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool
 	} while (!is_final_plan);
 
 	plan_add_segment(diveplan, clock - previous_point_time, 0, current_cylinder, po2, false);
-	if(decoMode() == VPMB) {
-		diveplan->eff_gfhigh = rint(100.0 * regressionb());
-		diveplan->eff_gflow = rint(100*(regressiona() * first_stop_depth + regressionb()));
+	if(ds->settings.deco_mode == VPMB) {
+		diveplan->eff_gfhigh = rint(100.0 * regressionb(ds));
+		diveplan->eff_gflow = rint(100*(regressiona(ds) * first_stop_depth + regressionb(ds)));
 	}
 
-	create_dive_from_plan(diveplan, is_planner);
-	add_plan_to_notes(diveplan, &displayed_dive, show_disclaimer, error);
-	fixup_dc_duration(&displayed_dive.dc);
+	create_dive_from_plan(diveplan, dive, is_planner);
 
 	free(stoplevels);
 	free(gaschanges);
-	free(bottom_cache);
 	return decodive;
 }
 
+/* Write down what calculate_plan() came up with. Unlike that, this has to happen on the main thread */
+void finish_plan(struct diveplan *diveplan, struct dive *dive, bool is_planner, bool show_disclaimer, int error)
+{
+	/* if all we wanted was the dive there is nothing to write down */
+	if (is_planner) {
+		add_plan_to_notes(diveplan, dive, show_disclaimer, error);
+		fixup_dc_duration(&dive->dc);
+	}
+}
+
+// Work out the stops and write the plan into the notes of dive. Return value is if there were any mandatory stops.
+bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, char **cached_datap, bool is_planner, bool show_disclaimer)
+{
+	int error;
+	struct deco_settings settings;
+	bool decodive;
+
+	get_deco_settings(&settings);
+	decodive = calculate_plan(ds, diveplan, dive, cached_datap, is_planner, &settings, &error);
+
+	finish_plan(diveplan, dive, is_planner, show_disclaimer, error);
+	return decodive;
+}
+
+/*
+ * The cells of a sweep (or a plan calculated in the background) can be calculated
+ * at the same time, but they share a few things with the rest of the program that
+ * have to be set up beforehand: the names of the events they add and the tissue
+ * checkpoints of the dives before dive (see init_decompression()). The deco
+ * settings they are to be calculated with are taken here, too.
+ */
+void prepare_plan_sweep(struct dive *dive, struct deco_settings *settings)
+{
+	struct deco_state ds;
+
+	remember_event("gaschange");
+	remember_event("SP change");
+	get_deco_settings(settings);
+	settings->gf_low_at_maxdepth = prefs.gf_low_at_maxdepth;
+	init_decompression(&ds, dive, settings);
+}
+
+/*
+ * Calculate base with the changes of cell, on a copy of dive. Only the waypoints
+ * the user entered are taken from base: the deepest ones are moved by the depth
+ * change and everything from the last one of them on by the bottom time change.
+ */
+void plan_sweep_cell(const struct diveplan *base, struct dive *dive, const struct deco_settings *settings, struct plan_sweep_cell *cell)
+{
+	struct diveplan diveplan = *base;
+	struct divedatapoint *dp, **lastdp = &diveplan.dp;
+	struct deco_state ds;
+	struct dive copy;
+	char *cache = NULL;
+	int i, error, lasttime = 0, maxdepth = 0, bottom_end = 0;
+
+	cell->valid = false;
+	cell->decodive = false;
+	cell->runtime = 0;
+	memset(cell->gas_used, 0, sizeof(cell->gas_used));
+
+	for (dp = base->dp; dp; dp = dp->next) {
+		if (dp->time && dp->entered && dp->depth >= maxdepth) {
+			maxdepth = dp->depth;
+			bottom_end = dp->time;
+		}
+	}
+	diveplan.dp = NULL;
+	/* those belong to the base plan, and the cells run side by side */
+	diveplan.checkpoints = NULL;
+	for (dp = base->dp; dp; dp = dp->next) {
+		int time = dp->time, depth = dp->depth;
+
+		/* the ascent is what we are going to calculate */
+		if (time && !dp->entered)
+			continue;
+		/* special entries that just inform the algorithm about additional gases stay as they are */
+		if (time) {
+			if (depth == maxdepth)
+				depth += cell->depth_delta;
+			if (time >= bottom_end)
+				time += cell->bottom_time_delta;
+			if (depth <= 0 || time <= lasttime) {
+				free_dps(&diveplan);
+				return;
+			}
+			lasttime = time;
+		}
+		*lastdp = create_dp(time, depth, dp->cylinderid, dp->setpoint);
+		(*lastdp)->entered = dp->entered;
+		lastdp = &(*lastdp)->next;
+	}
+	if (cell->gflow != -1)
+		diveplan.gflow = cell->gflow;
+	if (cell->gfhigh != -1)
+		diveplan.gfhigh = cell->gfhigh;
+
+	memset(&copy, 0, sizeof(copy));
+	copy_dive(dive, &copy);
+	cell->decodive = calculate_plan(&ds, &diveplan, &copy, &cache, true, settings, &error);
+	cell->valid = true;
+	if (copy.dc.samples)
+		cell->runtime = copy.dc.sample[copy.dc.samples - 1].time.seconds;
+	for (i = 0; i < MAX_CYLINDERS; i++)
+		cell->gas_used[i] = copy.cylinder[i].gas_used;
+
+	free(cache);
+	free_dps(&diveplan);
+	clear_dive(&copy);
+}
+
 /*
  * Get a value in tenths (so "10.2" == 102, "9" = 90)
  *
@@ -22,6 +22,32 @@ extern int get_gasidx(struct dive *dive, struct gasmix *mix);
 extern bool diveplan_empty(struct diveplan *diveplan);
 
 extern void free_dps(struct diveplan *diveplan);
+
+/* One plan of a sweep: how it differs from the base plan, and what came out */
+struct plan_sweep_cell {
+	short gflow, gfhigh;		// -1 to keep those of the base plan
+	int bottom_time_delta;		// seconds
+	int depth_delta;		// mm
+	bool valid;			// false if the changes don't leave a sensible plan
+	bool decodive;
+	int runtime;			// seconds
+	volume_t gas_used[MAX_CYLINDERS];
+};
+
+/* The tissues after every sample of the last replays of the waypoints of a plan,
+ * see tissue_at_end() - a plan goes through them twice, from different tissues.
+ * Set diveplan->checkpoints to one of these that starts out zeroed, and free it
+ * with free_plan_checkpoints() */
+#define PLAN_REPLAYS 2
+struct plan_replay;
+struct plan_checkpoints {
+	struct plan_replay *replay[PLAN_REPLAYS];
+	unsigned int used;
+};
+
+extern void free_plan_checkpoints(struct plan_checkpoints *checkpoints);
+extern void prepare_plan_sweep(struct dive *dive, struct deco_settings *settings);
+extern void plan_sweep_cell(const struct diveplan *base, struct dive *dive, const struct deco_settings *settings, struct plan_sweep_cell *cell);
 extern struct dive *planned_dive;
 extern char *cache_data;
 extern const char *disclaimer;
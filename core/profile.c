@@ -26,12 +26,8 @@
 int selected_dive = -1; /* careful: 0 is a valid value */
 unsigned int dc_number = 0;
 
-static struct plot_data *last_pi_entry_new = NULL;
 void populate_pressure_information(struct dive *, struct divecomputer *, struct plot_info *, int);
 
-extern bool in_planner();
-extern pressure_t first_ceiling_pressure;
-
 #ifdef DEBUG_PI
 /* debugging tool - not normally used */
 static void dump_pi(struct plot_info *pi)
@@ -241,6 +237,65 @@ static void analyze_plot_info_minmax(struct plot_info *pi, int entry_index)
 	plot_entry->max = max;
 }
 
+/* Do the time stamps of the plot entries never go backwards? */
+static bool plot_entries_in_order(const struct plot_info *pi)
+{
+	int i;
+
+	for (i = 1; i < pi->nr; i++) {
+		if (pi->entry[i].sec < pi->entry[i - 1].sec)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * The same as analyze_plot_info_minmax() for all entries at once, if their
+ * time stamps are in order: then the intervals only ever move forward, and
+ * two queues of entry indices hold the candidates for the minimum and the
+ * maximum of the current interval, in order of depth. Every entry goes in
+ * and out of them once, instead of being looked at for every entry within
+ * 4.5 minutes.
+ */
+static void analyze_plot_info_minmax_all(struct plot_info *pi)
+{
+	int nr = pi->nr;
+	int *minq = malloc(nr * sizeof(int));
+	int *maxq = malloc(nr * sizeof(int));
+	int minhead = 0, mintail = 0, maxhead = 0, maxtail = 0;
+	int i, start = 0, end = 0;
+
+	for (i = 0; i < nr; i++) {
+		struct plot_data *entry = pi->entry + i;
+
+		/* Add everything up to the end of the interval. On equal
+		 * depths the earlier entry stays, like in the loop above */
+		while (end < nr && pi->entry[end].sec <= entry->sec + HALF_INTERVAL) {
+			int depth = pi->entry[end].depth;
+
+			while (mintail > minhead && pi->entry[minq[mintail - 1]].depth > depth)
+				mintail--;
+			minq[mintail++] = end;
+			while (maxtail > maxhead && pi->entry[maxq[maxtail - 1]].depth < depth)
+				maxtail--;
+			maxq[maxtail++] = end;
+			end++;
+		}
+		/* ..and drop what is before its start */
+		while (pi->entry[start].sec < entry->sec - HALF_INTERVAL)
+			start++;
+		while (minq[minhead] < start)
+			minhead++;
+		while (maxq[maxhead] < start)
+			maxhead++;
+
+		entry->min = minq[minhead];
+		entry->max = maxq[maxhead];
+	}
+	free(minq);
+	free(maxq);
+}
+
 static velocity_t velocity(int speed)
 {
 	velocity_t v;
@@ -303,8 +358,13 @@ struct plot_info *analyze_plot_info(struct plot_info *pi)
 	}
 
 	/* get minmax data */
-	for (i = 0; i < nr; i++)
-		analyze_plot_info_minmax(pi, i);
+	pi->in_order = plot_entries_in_order(pi);
+	if (pi->in_order) {
+		analyze_plot_info_minmax_all(pi);
+	} else {
+		for (i = 0; i < nr; i++)
+			analyze_plot_info_minmax(pi, i);
+	}
 
 	return pi;
 }
@@ -448,7 +508,7 @@ struct plot_info calculate_max_limits_new(struct dive *dive, struct divecomputer
 {
 	struct divecomputer *dc = &(dive->dc);
 	bool seen = false;
-	static struct plot_info pi;
+	struct plot_info pi;
 	int maxdepth = dive->maxdepth.mm;
 	unsigned int maxtime = 0;
 	int maxpressure = 0, minpressure = INT_MAX;
@@ -470,16 +530,15 @@ struct plot_info calculate_max_limits_new(struct dive *dive, struct divecomputer
 	do {
 		if (dc == given_dc)
 			seen = true;
-		int i = dc->samples;
+		int i;
 		int lastdepth = 0;
-		struct sample *s = dc->sample;
 		struct event *ev;
 
-		while (--i >= 0) {
-			int depth = s->depth.mm;
-			int pressure = s->cylinderpressure.mbar;
-			int temperature = s->temperature.mkelvin;
-			int heartbeat = s->heartbeat;
+		for (i = 0; i < dc->samples; i++) {
+			int depth = dc_sample_depth(dc, i).mm;
+			int pressure = dc_sample_cylinderpressure(dc, i).mbar;
+			int temperature = dc_sample_temperature(dc, i).mkelvin;
+			int heartbeat = dc_sample_heartbeat(dc, i);
 
 			if (!mintemp && temperature < mintemp)
 				mintemp = temperature;
@@ -496,12 +555,11 @@ struct plot_info calculate_max_limits_new(struct dive *dive, struct divecomputer
 				minhr = heartbeat;
 
 			if (depth > maxdepth)
-				maxdepth = s->depth.mm;
+				maxdepth = depth;
 			if ((depth > SURFACE_THRESHOLD || lastdepth > SURFACE_THRESHOLD) &&
-			    s->time.seconds > maxtime)
-				maxtime = s->time.seconds;
+			    dc_sample_time(dc, i).seconds > maxtime)
+				maxtime = dc_sample_time(dc, i).seconds;
 			lastdepth = depth;
-			s++;
 		}
 
 		/* Make sure we can fit all events */
@@ -583,11 +641,10 @@ struct plot_data *populate_plot_entries(struct dive *dive, struct divecomputer *
 		ev = ev->next;
 	for (i = 0; i < dc->samples; i++) {
 		struct plot_data *entry = plot_data + idx;
-		struct sample *sample = dc->sample + i;
-		int time = sample->time.seconds;
+		int time = dc_sample_time(dc, i).seconds;
 		int offset, delta;
-		int depth = sample->depth.mm;
-		int sac = sample->sac.mliter;
+		int depth = dc_sample_depth(dc, i).mm;
+		int sac = dc_sample_sac(dc, i).mliter;
 
 		/* Add intermediate plot entries if required */
 		delta = time - lasttime;
@@ -623,34 +680,34 @@ struct plot_data *populate_plot_entries(struct dive *dive, struct divecomputer *
 		entry->depth = depth;
 
 		entry->running_sum = (entry - 1)->running_sum + (time - (entry - 1)->sec) * (depth + (entry - 1)->depth) / 2;
-		entry->stopdepth = sample->stopdepth.mm;
-		entry->stoptime = sample->stoptime.seconds;
-		entry->ndl = sample->ndl.seconds;
-		entry->tts = sample->tts.seconds;
-		pi->has_ndl |= sample->ndl.seconds;
-		entry->in_deco = sample->in_deco;
-		entry->cns = sample->cns;
+		entry->stopdepth = dc_sample_stopdepth(dc, i).mm;
+		entry->stoptime = dc_sample_stoptime(dc, i).seconds;
+		entry->ndl = dc_sample_ndl(dc, i).seconds;
+		entry->tts = dc_sample_tts(dc, i).seconds;
+		pi->has_ndl |= dc_sample_ndl(dc, i).seconds;
+		entry->in_deco = dc_sample_in_deco(dc, i);
+		entry->cns = dc_sample_cns(dc, i);
 		if (dc->divemode == CCR) {
-			entry->o2pressure.mbar = entry->o2setpoint.mbar = sample->setpoint.mbar;     // for rebreathers
-			entry->o2sensor[0].mbar = sample->o2sensor[0].mbar; // for up to three rebreather O2 sensors
-			entry->o2sensor[1].mbar = sample->o2sensor[1].mbar;
-			entry->o2sensor[2].mbar = sample->o2sensor[2].mbar;
+			entry->o2pressure.mbar = entry->o2setpoint.mbar = dc_sample_setpoint(dc, i).mbar;     // for rebreathers
+			entry->o2sensor[0].mbar = dc_sample_o2sensor(dc, i, 0).mbar; // for up to three rebreather O2 sensors
+			entry->o2sensor[1].mbar = dc_sample_o2sensor(dc, i, 1).mbar;
+			entry->o2sensor[2].mbar = dc_sample_o2sensor(dc, i, 2).mbar;
 		} else {
-			entry->pressures.o2 = sample->setpoint.mbar / 1000.0;
+			entry->pressures.o2 = dc_sample_setpoint(dc, i).mbar / 1000.0;
 		}
 		/* FIXME! sensor index -> cylinder index translation! */
 		//		entry->cylinderindex = sample->sensor;
-		SENSOR_PRESSURE(entry) = sample->cylinderpressure.mbar;
-		O2CYLINDER_PRESSURE(entry) = sample->o2cylinderpressure.mbar;
-		if (sample->temperature.mkelvin)
-			entry->temperature = lasttemp = sample->temperature.mkelvin;
+		SENSOR_PRESSURE(entry) = dc_sample_cylinderpressure(dc, i).mbar;
+		O2CYLINDER_PRESSURE(entry) = dc_sample_o2cylinderpressure(dc, i).mbar;
+		if (dc_sample_temperature(dc, i).mkelvin)
+			entry->temperature = lasttemp = dc_sample_temperature(dc, i).mkelvin;
 		else
 			entry->temperature = lasttemp;
-		entry->heartbeat = sample->heartbeat;
-		entry->bearing = sample->bearing.degrees;
-		entry->sac = sample->sac.mliter;
-		if (sample->rbt.seconds)
-			entry->rbt = sample->rbt.seconds;
+		entry->heartbeat = dc_sample_heartbeat(dc, i);
+		entry->bearing = dc_sample_bearing(dc, i).degrees;
+		entry->sac = dc_sample_sac(dc, i).mliter;
+		if (dc_sample_rbt(dc, i).seconds)
+			entry->rbt = dc_sample_rbt(dc, i).seconds;
 		/* skip events that happened at this time */
 		while (ev && (int)ev->time.seconds == time)
 			ev = ev->next;
@@ -726,11 +783,12 @@ static void populate_cylinder_pressure_data(int idx, int start, int end, struct
  * Calculate the sac rate between the two plot entries 'first' and 'last'.
  *
  * Everything in between has a cylinder pressure, and it's all the same
- * cylinder.
+ * cylinder. The depth pressure times the time from every entry to the
+ * next is in 'atmseconds', see calculate_sac().
  */
-static int sac_between(struct dive *dive, struct plot_data *first, struct plot_data *last)
+static int sac_between(struct dive *dive, struct plot_info *pi, struct plot_data *first, struct plot_data *last, const double *atmseconds)
 {
-	int airuse;
+	int airuse, i;
 	double pressuretime;
 	pressure_t a, b;
 	cylinder_t *cyl;
@@ -748,13 +806,10 @@ static int sac_between(struct dive *dive, struct plot_data *first, struct plot_d
 
 	/* Calculate depthpressure integrated over time */
 	pressuretime = 0.0;
-	do {
-		int depth = (first[0].depth + first[1].depth) / 2;
-		int time = first[1].sec - first[0].sec;
-		double atm = depth_to_atm(depth, dive);
-
-		pressuretime += atm * time;
-	} while (++first < last);
+	for (i = first - pi->entry; i < last - pi->entry; i++)
+		pressuretime += atmseconds[i];
+	if (!pressuretime)
+		return 0;
 
 	/* Turn "atmseconds" into "atmminutes" */
 	pressuretime /= 60;
@@ -763,11 +818,21 @@ static int sac_between(struct dive *dive, struct plot_data *first, struct plot_d
 	return rint(airuse / pressuretime);
 }
 
+/* Can the SAC rate be calculated across these two neighbouring entries? */
+static bool sac_continues(struct plot_data *prev, struct plot_data *next)
+{
+	if (prev->cylinderindex != next->cylinderindex)
+		return false;
+	if (prev->depth < SURFACE_THRESHOLD && next->depth < SURFACE_THRESHOLD)
+		return false;
+	return GET_PRESSURE(prev) && GET_PRESSURE(next);
+}
+
 /*
  * Try to do the momentary sac rate for this entry, averaging over one
  * minute.
  */
-static void fill_sac(struct dive *dive, struct plot_info *pi, int idx)
+static void fill_sac(struct dive *dive, struct plot_info *pi, int idx, const double *atmseconds)
 {
 	struct plot_data *entry = pi->entry + idx;
 	struct plot_data *first, *last;
@@ -787,14 +852,10 @@ static void fill_sac(struct dive *dive, struct plot_info *pi, int idx)
 	time = entry->sec - 30;
 	while (idx > 0) {
 		struct plot_data *prev = first-1;
-		if (prev->cylinderindex != first->cylinderindex)
-			break;
-		if (prev->depth < SURFACE_THRESHOLD && first->depth < SURFACE_THRESHOLD)
+		if (!sac_continues(prev, first))
 			break;
 		if (prev->sec < time)
 			break;
-		if (!GET_PRESSURE(prev))
-			break;
 		idx--;
 		first = prev;
 	}
@@ -804,25 +865,72 @@ static void fill_sac(struct dive *dive, struct plot_info *pi, int idx)
 	time = first->sec + 60;
 	while (++idx < pi->nr) {
 		struct plot_data *next = last+1;
-		if (next->cylinderindex != last->cylinderindex)
-			break;
-		if (next->depth < SURFACE_THRESHOLD && last->depth < SURFACE_THRESHOLD)
+		if (!sac_continues(last, next))
 			break;
 		if (next->sec > time)
 			break;
-		if (!GET_PRESSURE(next))
-			break;
 		last = next;
 	}
 
 	/* Ok, now calculate the SAC between 'first' and 'last' */
-	entry->sac = sac_between(dive, first, last);
+	entry->sac = sac_between(dive, pi, first, last, atmseconds);
+}
+
+/*
+ * The same as fill_sac() for all entries at once, if their time stamps
+ * are in order. Within a run of entries that fill_sac() walks through
+ * without stopping, 'first' and 'last' only ever move forward.
+ */
+static void fill_sac_all(struct dive *dive, struct plot_info *pi, const double *atmseconds)
+{
+	int i, run = 0, back = 0, ahead = 0;
+
+	for (i = 0; i < pi->nr; i++) {
+		struct plot_data *entry = pi->entry + i;
+		int first;
+
+		/* the start of the run that entry i belongs to */
+		if (i > 0 && !sac_continues(entry - 1, entry))
+			run = i;
+		if (entry->sac || !GET_PRESSURE(entry))
+			continue;
+
+		/* the first entry at most 30 seconds back.. */
+		while (pi->entry[back].sec < entry->sec - 30)
+			back++;
+		first = MAX(back, run);
+		/* ..and the last one at most a minute after that, in the same run */
+		if (ahead < first)
+			ahead = first;
+		while (ahead + 1 < pi->nr && sac_continues(pi->entry + ahead, pi->entry + ahead + 1) &&
+		       pi->entry[ahead + 1].sec <= pi->entry[first].sec + 60)
+			ahead++;
+
+		entry->sac = sac_between(dive, pi, pi->entry + first, pi->entry + ahead, atmseconds);
+	}
 }
 
 static void calculate_sac(struct dive *dive, struct plot_info *pi)
 {
-	for (int i = 0; i < pi->nr; i++)
-		fill_sac(dive, pi, i);
+	double *atmseconds = malloc((pi->nr + 1) * sizeof(double));
+	int i;
+
+	/* the steps of the integral, so that sac_between() doesn't have to work out the same ones again and again */
+	for (i = 0; i + 1 < pi->nr; i++) {
+		struct plot_data *entry = pi->entry + i;
+		int depth = (entry[0].depth + entry[1].depth) / 2;
+		int time = entry[1].sec - entry[0].sec;
+
+		atmseconds[i] = depth_to_atm(depth, dive) * time;
+	}
+
+	if (plot_entries_in_order(pi)) {
+		fill_sac_all(dive, pi, atmseconds);
+	} else {
+		for (i = 0; i < pi->nr; i++)
+			fill_sac(dive, pi, i, atmseconds);
+	}
+	free(atmseconds);
 }
 
 static void populate_secondary_sensor_data(struct divecomputer *dc, struct plot_info *pi)
@@ -864,7 +972,86 @@ static void setup_gas_sensor_pressure(struct dive *dive, struct divecomputer *dc
 
 #ifndef SUBSURFACE_MOBILE
 /* calculate DECO STOP / TTS / NDL */
-static void calculate_ndl_tts(struct plot_data *entry, struct dive *dive, double surface_pressure)
+/* Load the tissues of ds for steps time steps at the depth of the entry, starting
+ * from the state start, and check whether that leaves us with a ceiling */
+static bool ceiling_after_steps(struct deco_state *ds, const struct deco_state *start, int steps, struct plot_data *entry, struct dive *dive, double surface_pressure, int time_stepsize)
+{
+	*ds = *start;
+	add_segment_repeated(ds, depth_to_bar(entry->depth, dive), &dive->cylinder[entry->cylinderindex].gasmix,
+			     time_stepsize, steps, entry->o2pressure.mbar, dive);
+	return deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, 1) > 0;
+}
+
+/*
+ * Find the NDL without adding one time step after the other. At constant depth
+ * and gas the tissue loadings after any number of steps follow in closed form
+ * and every compartment loads or unloads monotonously, so there is exactly one
+ * step at which the ceiling appears and we can find it by bisection.
+ *
+ * This gives the same ndl_calc as the stepping loop in calculate_ndl_tts() and
+ * leaves the same tissue tolerances behind. Returns false if that loop has to be
+ * used instead: the tissues don't move monotonously, or we are doing VPM-B, where
+ * every step also updates the crushing pressures.
+ */
+static bool calculate_ndl_closed_form(struct deco_state *ds, struct plot_data *entry, struct dive *dive, double surface_pressure, int time_stepsize)
+{
+	struct deco_state start = *ds;
+	int max_steps, low, high;
+
+	if (ds->settings.deco_mode == VPMB)
+		return false;
+	if (entry->ndl_calc >= MAX_PROFILE_DECO)
+		return true;
+	max_steps = DIV_UP(MAX_PROFILE_DECO - entry->ndl_calc, time_stepsize);
+
+	/* Check the step before running out of time first - the stepping loop
+	 * doesn't look at the ceiling after the last one */
+	if (!add_segment_repeated(ds, depth_to_bar(entry->depth, dive), &dive->cylinder[entry->cylinderindex].gasmix,
+				  time_stepsize, max_steps - 1, entry->o2pressure.mbar, dive))
+		return false;
+	if (deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, 1) <= 0) {
+		/* plenty of time */
+		add_segment_repeated(ds, depth_to_bar(entry->depth, dive), &dive->cylinder[entry->cylinderindex].gasmix,
+				     time_stepsize, 1, entry->o2pressure.mbar, dive);
+		entry->ndl_calc += max_steps * time_stepsize;
+		return true;
+	}
+
+	/* no ceiling right now, one after max_steps - 1 steps */
+	low = 0;
+	high = max_steps - 1;
+	while (high - low > 1) {
+		int mid = (low + high) / 2;
+		if (ceiling_after_steps(ds, &start, mid, entry, dive, surface_pressure, time_stepsize))
+			high = mid;
+		else
+			low = mid;
+	}
+	ceiling_after_steps(ds, &start, high, entry, dive, surface_pressure, time_stepsize);
+	entry->ndl_calc += high * time_stepsize;
+	return true;
+}
+
+/*
+ * The NDL from entry on, in entry->ndl_calc, leaving ds with the tissues at the
+ * end of it. Without a closed_form, this adds one time step after the other -
+ * calculate_ndl_closed_form() has to give the same results.
+ */
+void calculate_ndl(struct deco_state *ds, struct plot_data *entry, struct dive *dive, double surface_pressure, bool closed_form)
+{
+	const int time_stepsize = 60;
+
+	if (closed_form && calculate_ndl_closed_form(ds, entry, dive, surface_pressure, time_stepsize))
+		return;
+	/* stop if the ndl is above max_ndl seconds, and call it plenty of time */
+	while (entry->ndl_calc < MAX_PROFILE_DECO && deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, 1) <= 0) {
+		entry->ndl_calc += time_stepsize;
+		add_segment(ds, depth_to_bar(entry->depth, dive),
+					       &dive->cylinder[entry->cylinderindex].gasmix, time_stepsize, entry->o2pressure.mbar, dive, prefs.bottomsac);
+	}
+}
+
+static void calculate_ndl_tts(struct deco_state *ds, struct plot_data *entry, struct dive *dive, double surface_pressure)
 {
 	/* FIXME: This should be configurable */
 	/* ascent speed up to first deco stop */
@@ -877,13 +1064,17 @@ static void calculate_ndl_tts(struct plot_data *entry, struct dive *dive, double
 	const int time_stepsize = 60;
 	const int deco_stepsize = 3000;
 	/* at what depth is the current deco-step? */
-	int next_stop = ROUND_UP(deco_allowed_depth(tissue_tolerance_calc(dive, depth_to_bar(entry->depth, dive)),
+	int next_stop = ROUND_UP(deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)),
 						    surface_pressure, dive, 1), deco_stepsize);
 	int ascent_depth = entry->depth;
 	/* at what time should we give up and say that we got enuff NDL? */
 	int cylinderindex = entry->cylinderindex;
-	/* If iterating through a dive, entry->tts_calc needs to be reset */
+	/* If iterating through a dive, the results of the previous iteration need to be reset */
 	entry->tts_calc = 0;
+	entry->ndl_calc = 0;
+	entry->stoptime_calc = 0;
+	entry->stopdepth_calc = 0;
+	entry->in_deco_calc = false;
 
 	/* If we don't have a ceiling yet, calculate ndl. Don't try to calculate
 	 * a ndl for lower values than 3m it would take forever */
@@ -892,12 +1083,7 @@ static void calculate_ndl_tts(struct plot_data *entry, struct dive *dive, double
 			entry->ndl = MAX_PROFILE_DECO;
 			return;
 		}
-		/* stop if the ndl is above max_ndl seconds, and call it plenty of time */
-		while (entry->ndl_calc < MAX_PROFILE_DECO && deco_allowed_depth(tissue_tolerance_calc(dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, 1) <= 0) {
-			entry->ndl_calc += time_stepsize;
-			add_segment(depth_to_bar(entry->depth, dive),
-						       &dive->cylinder[cylinderindex].gasmix, time_stepsize, entry->o2pressure.mbar, dive, prefs.bottomsac);
-		}
+		calculate_ndl(ds, entry, dive, surface_pressure, true);
 		/* we don't need to calculate anything else */
 		return;
 	}
@@ -907,14 +1093,13 @@ static void calculate_ndl_tts(struct plot_data *entry, struct dive *dive, double
 
 	/* Add segments for movement to stopdepth */
 	for (; ascent_depth > next_stop; ascent_depth -= ascent_mm_per_step, entry->tts_calc += ascent_s_per_step) {
-		add_segment(depth_to_bar(ascent_depth, dive),
+		add_segment(ds, depth_to_bar(ascent_depth, dive),
 			    &dive->cylinder[cylinderindex].gasmix, ascent_s_per_step, entry->o2pressure.mbar, dive, prefs.decosac);
-		next_stop = ROUND_UP(deco_allowed_depth(tissue_tolerance_calc(dive, depth_to_bar(ascent_depth, dive)), surface_pressure, dive, 1), deco_stepsize);
+		next_stop = ROUND_UP(deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(ascent_depth, dive)), surface_pressure, dive, 1), deco_stepsize);
 	}
 	ascent_depth = next_stop;
 
 	/* And how long is the current deco-step? */
-	entry->stoptime_calc = 0;
 	entry->stopdepth_calc = next_stop;
 	next_stop -= deco_stepsize;
 
@@ -927,13 +1112,13 @@ static void calculate_ndl_tts(struct plot_data *entry, struct dive *dive, double
 		entry->tts_calc += time_stepsize;
 		if (entry->tts_calc > MAX_PROFILE_DECO)
 			break;
-		add_segment(depth_to_bar(ascent_depth, dive),
+		add_segment(ds, depth_to_bar(ascent_depth, dive),
 			    &dive->cylinder[cylinderindex].gasmix, time_stepsize, entry->o2pressure.mbar, dive, prefs.decosac);
 
-		if (deco_allowed_depth(tissue_tolerance_calc(dive, depth_to_bar(ascent_depth,dive)), surface_pressure, dive, 1) <= next_stop) {
+		if (deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(ascent_depth,dive)), surface_pressure, dive, 1) <= next_stop) {
 			/* move to the next stop and add the travel between stops */
 			for (; ascent_depth > next_stop; ascent_depth -= ascent_mm_per_deco_step, entry->tts_calc += ascent_s_per_deco_step)
-				add_segment(depth_to_bar(ascent_depth, dive),
+				add_segment(ds, depth_to_bar(ascent_depth, dive),
 					    &dive->cylinder[cylinderindex].gasmix, ascent_s_per_deco_step, entry->o2pressure.mbar, dive, prefs.decosac);
 			ascent_depth = next_stop;
 			next_stop -= deco_stepsize;
@@ -941,18 +1126,98 @@ static void calculate_ndl_tts(struct plot_data *entry, struct dive *dive, double
 	}
 }
 
+/* The tissues at an entry whose NDL and TTS a VPM-B CVA iteration put off */
+struct cva_ndl_tts {
+	int idx;
+	struct deco_snapshot snapshot;
+	pressure_t first_ceiling_pressure;
+};
+
+/* Fill in the tissue columns of entry idx, if there are any */
+static void set_tissue_percentages(struct deco_state *ds, struct plot_info *pi, int idx, struct dive *dive, double surface_pressure)
+{
+	struct plot_data *entry = pi->entry + idx;
+	int *ceilings = plot_tissue_ceilings(pi, idx);
+	int *percentages = plot_tissue_percentages(pi, idx);
+	int j;
+
+	if (!ceilings && !percentages)
+		return;
+	for (j = 0; j < 16; j++) {
+		double m_value = ds->buehlmann_inertgas_a[j] + entry->ambpressure / ds->buehlmann_inertgas_b[j];
+		if (ceilings)
+			ceilings[j] = deco_allowed_depth(ds->tolerated_by_tissue[j], surface_pressure, dive, 1);
+		if (percentages)
+			percentages[j] = ds->tissue_inertgas_saturation[j] < entry->ambpressure ?
+						ds->tissue_inertgas_saturation[j] / entry->ambpressure * AMB_PERCENTAGE :
+						AMB_PERCENTAGE + (ds->tissue_inertgas_saturation[j] - entry->ambpressure) / (m_value - entry->ambpressure) * (100.0 - AMB_PERCENTAGE);
+	}
+}
+
+/*
+ * Only the NDL and TTS of the last CVA iteration end up in the plot, and
+ * which iteration that is shows at its end. So the iterations put off all
+ * NDL and TTS calculations that don't feed back into the deco time, and
+ * the last one catches up on them here, with the gradients it used.
+ *
+ * The entries within 30 seconds of a calculation take its values. Those
+ * with the same time stamp also saw the tissue state it left behind.
+ */
+static void finish_cva_ndl_tts(struct deco_state *ds, struct dive *dive, struct plot_info *pi,
+			       const struct cva_ndl_tts *todo, int nr_todo, double surface_pressure)
+{
+	struct deco_state end_state = *ds;
+	int i, k, ci;
+
+	for (k = 0; k < nr_todo; k++) {
+		struct plot_data *entry = pi->entry + todo[k].idx;
+		bool same_tissues = true;
+
+		restore_deco_snapshot(ds, &todo[k].snapshot);
+		for (ci = 0; ci < 16; ci++)
+			ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
+		ds->first_ceiling_pressure = todo[k].first_ceiling_pressure;
+		calculate_ndl_tts(ds, entry, dive, surface_pressure);
+		for (i = todo[k].idx + 1; i < pi->nr - 1 && pi->entry[i].sec - entry->sec < 30; i++) {
+			struct plot_data *next = pi->entry + i;
+
+			same_tissues = same_tissues && next->sec == next[-1].sec;
+			if (same_tissues)
+				set_tissue_percentages(ds, pi, i, dive, surface_pressure);
+			next->stoptime_calc = next[-1].stoptime_calc;
+			next->stopdepth_calc = next[-1].stopdepth_calc;
+			next->tts_calc = next[-1].tts_calc;
+			next->ndl_calc = next[-1].ndl_calc;
+		}
+	}
+	*ds = end_state;
+}
+
+static bool plot_cancelled(const struct plot_info *pi)
+{
+	return pi->cancelled && pi->cancelled(pi->cancel_data);
+}
+
 /* Let's try to do some deco calculations.
  */
-void calculate_deco_information(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool print_mode)
+void calculate_deco_information(struct deco_state *ds, struct deco_state *planner_ds, struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool print_mode)
 {
 	int i, count_iteration = 0;
 	double surface_pressure = (dc->surface_pressure.mbar ? dc->surface_pressure.mbar : get_surface_pressure_in_mbar(dive, true)) / 1000.0;
 	bool first_iteration = true;
 	int deco_time = 0, prev_deco_time = 10000000;
 	char *cache_data_initial = NULL;
+	struct cva_ndl_tts *cva_todo = NULL;
+	int nr_cva_todo = 0, cva_todo_alloc = 0;
 	/* For VPM-B outside the planner, cache the initial deco state for CVA iterations */
-	if (decoMode() == VPMB && !in_planner())
-		cache_deco_state(&cache_data_initial);
+	if (ds->settings.deco_mode == VPMB && !ds->settings.in_planner)
+		cache_deco_state(ds, &cache_data_initial);
+	/* In the planner, the VPM-B gradients are the ones the plan was calculated with */
+	if (ds->settings.deco_mode == VPMB && ds->settings.in_planner && planner_ds) {
+		memcpy(ds->bottom_n2_gradient, planner_ds->bottom_n2_gradient, sizeof(ds->bottom_n2_gradient));
+		memcpy(ds->bottom_he_gradient, planner_ds->bottom_he_gradient, sizeof(ds->bottom_he_gradient));
+		ds->first_ceiling_pressure = planner_ds->first_ceiling_pressure;
+	}
 	/* For VPM-B outside the planner, iterate until deco time converges (usually one or two iterations after the initial)
 	 * Set maximum number of iterations to 10 just in case */
 	while ((abs(prev_deco_time - deco_time) >= 30) && (count_iteration < 10)) {
@@ -962,8 +1227,11 @@ void calculate_deco_information(struct dive *dive, struct divecomputer *dc, stru
 			int j, t0 = (entry - 1)->sec, t1 = entry->sec;
 			int time_stepsize = 20;
 
+			if (plot_cancelled(pi))
+				break;
+
 			entry->ambpressure = depth_to_bar(entry->depth, dive);
-			entry->gfline = get_gf(entry->ambpressure, dive) * (100.0 - AMB_PERCENTAGE) + AMB_PERCENTAGE;
+			entry->gfline = get_gf(ds, entry->ambpressure, dive) * (100.0 - AMB_PERCENTAGE) + AMB_PERCENTAGE;
 			if (t0 > t1) {
 				fprintf(stderr, "non-monotonous dive stamps %d %d\n", t0, t1);
 				int xchg = t1;
@@ -974,7 +1242,7 @@ void calculate_deco_information(struct dive *dive, struct divecomputer *dc, stru
 				time_stepsize = t1 - t0;
 			for (j = t0 + time_stepsize; j <= t1; j += time_stepsize) {
 				int depth = interpolate(entry[-1].depth, entry[0].depth, j - t0, t1 - t0);
-				add_segment(depth_to_bar(depth, dive),
+				add_segment(ds, depth_to_bar(depth, dive),
 					&dive->cylinder[entry->cylinderindex].gasmix, time_stepsize, entry->o2pressure.mbar, dive, entry->sac);
 				if ((t1 - j < time_stepsize) && (j < t1))
 					time_stepsize = t1 - j;
@@ -983,30 +1251,30 @@ void calculate_deco_information(struct dive *dive, struct divecomputer *dc, stru
 				entry->ceiling = (entry - 1)->ceiling;
 			} else {
 				/* Keep updating the VPM-B gradients until the start of the ascent phase of the dive. */
-				if (decoMode() == VPMB && !in_planner() && (entry - 1)->ceiling >= first_ceiling && first_iteration == true) {
-					nuclear_regeneration(t1);
-					vpmb_start_gradient();
+				if (ds->settings.deco_mode == VPMB && !ds->settings.in_planner && (entry - 1)->ceiling >= first_ceiling && first_iteration == true) {
+					nuclear_regeneration(ds, t1);
+					vpmb_start_gradient(ds);
 					/* For CVA calculations, start by guessing deco time = dive time remaining */
 					deco_time = pi->maxtime - t1;
-					vpmb_next_gradient(deco_time, surface_pressure / 1000.0);
+					vpmb_next_gradient(ds, deco_time, surface_pressure / 1000.0);
 				}
-				entry->ceiling = deco_allowed_depth(tissue_tolerance_calc(dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, !prefs.calcceiling3m);
+				entry->ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, !prefs.calcceiling3m);
 				if (prefs.calcceiling3m)
-					current_ceiling = deco_allowed_depth(tissue_tolerance_calc(dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, true);
+					current_ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, true);
 				else
 					current_ceiling = entry->ceiling;
 				/* If using VPM-B outside the planner, take first_ceiling_pressure as the deepest ceiling */
-				if (decoMode() == VPMB && !in_planner()) {
+				if (ds->settings.deco_mode == VPMB && !ds->settings.in_planner) {
 					if  (current_ceiling > first_ceiling) {
 						time_deep_ceiling = t1;
 						first_ceiling = current_ceiling;
-						first_ceiling_pressure.mbar = depth_to_mbar(first_ceiling, dive);
+						ds->first_ceiling_pressure.mbar = depth_to_mbar(first_ceiling, dive);
 						if (first_iteration) {
-							nuclear_regeneration(t1);
-							vpmb_start_gradient();
+							nuclear_regeneration(ds, t1);
+							vpmb_start_gradient(ds);
 							/* For CVA calculations, start by guessing deco time = dive time remaining */
 							deco_time = pi->maxtime - t1;
-							vpmb_next_gradient(deco_time, surface_pressure / 1000.0);
+							vpmb_next_gradient(ds, deco_time, surface_pressure / 1000.0);
 						}
 					}
 					// Use the point where the ceiling clears as the end of deco phase for CVA calculations
@@ -1016,20 +1284,14 @@ void calculate_deco_information(struct dive *dive, struct divecomputer *dc, stru
 						time_clear_ceiling = t1;
 				}
 			}
-			for (j = 0; j < 16; j++) {
-				double m_value = buehlmann_inertgas_a[j] + entry->ambpressure / buehlmann_inertgas_b[j];
-				entry->ceilings[j] = deco_allowed_depth(tolerated_by_tissue[j], surface_pressure, dive, 1);
-				entry->percentages[j] = tissue_inertgas_saturation[j] < entry->ambpressure ?
-								tissue_inertgas_saturation[j] / entry->ambpressure * AMB_PERCENTAGE :
-								AMB_PERCENTAGE + (tissue_inertgas_saturation[j] - entry->ambpressure) / (m_value - entry->ambpressure) * (100.0 - AMB_PERCENTAGE);
-			}
+			set_tissue_percentages(ds, pi, i, dive, surface_pressure);
 
 			/* should we do more calculations?
 			* We don't for print-mode because this info doesn't show up there
 			* If the ceiling hasn't cleared by the last data point, we need tts for VPM-B CVA calculation
 			* It is not necessary to do these calculation on the first VPMB iteration, except for the last data point */
-			if ((prefs.calcndltts && !print_mode && (decoMode() != VPMB || in_planner() || !first_iteration)) ||
-			    (decoMode() == VPMB && !in_planner() && i == pi->nr - 1)) {
+			if ((prefs.calcndltts && !print_mode && (ds->settings.deco_mode != VPMB || ds->settings.in_planner || !first_iteration)) ||
+			    (ds->settings.deco_mode == VPMB && !ds->settings.in_planner && i == pi->nr - 1)) {
 				/* only calculate ndl/tts on every 30 seconds */
 				if ((entry->sec - last_ndl_tts_calc_time) < 30 && i != pi->nr - 1) {
 					struct plot_data *prev_entry = (entry - 1);
@@ -1041,39 +1303,59 @@ void calculate_deco_information(struct dive *dive, struct divecomputer *dc, stru
 				}
 				last_ndl_tts_calc_time = entry->sec;
 
+				/* For VPM-B outside the planner, only the TTS at the end of the dive (and
+				 * whatever shares its time stamp) feeds back into the CVA iteration - leave
+				 * the rest to the last iteration, see finish_cva_ndl_tts() */
+				if (ds->settings.deco_mode == VPMB && !ds->settings.in_planner && t0 != t1 && entry->sec != pi->entry[pi->nr - 1].sec) {
+					if (nr_cva_todo == cva_todo_alloc) {
+						cva_todo_alloc = (cva_todo_alloc + 16) * 3 / 2;
+						cva_todo = realloc(cva_todo, cva_todo_alloc * sizeof(*cva_todo));
+					}
+					cva_todo[nr_cva_todo].idx = i;
+					save_deco_snapshot(ds, &cva_todo[nr_cva_todo].snapshot);
+					cva_todo[nr_cva_todo].first_ceiling_pressure = ds->first_ceiling_pressure;
+					nr_cva_todo++;
+					continue;
+				}
+
 				/* We are going to mess up deco state, so store it for later restore */
-				char *cache_data = NULL;
-				cache_deco_state(&cache_data);
-				calculate_ndl_tts(entry, dive, surface_pressure);
-				if (decoMode() == VPMB && !in_planner() && i == pi->nr - 1)
+				struct deco_snapshot snapshot;
+				save_deco_snapshot(ds, &snapshot);
+				calculate_ndl_tts(ds, entry, dive, surface_pressure);
+				if (ds->settings.deco_mode == VPMB && !ds->settings.in_planner && i == pi->nr - 1)
 					final_tts = entry->tts_calc;
 				/* Restore "real" deco state for next real time step */
-				restore_deco_state(cache_data);
-				free(cache_data);
+				restore_deco_snapshot(ds, &snapshot);
 			}
 		}
-		if (decoMode() == VPMB && !in_planner()) {
+		if (plot_cancelled(pi))
+			break;
+		if (ds->settings.deco_mode == VPMB && !ds->settings.in_planner) {
 			prev_deco_time = deco_time;
 			// Do we need to update deco_time?
 			if (final_tts > 0)
 				deco_time = pi->maxtime + final_tts - time_deep_ceiling;
 			else if (time_clear_ceiling > 0)
 				deco_time = time_clear_ceiling - time_deep_ceiling;
-			vpmb_next_gradient(deco_time, surface_pressure / 1000.0);
+			if (abs(prev_deco_time - deco_time) < 30 || count_iteration == 9)
+				finish_cva_ndl_tts(ds, dive, pi, cva_todo, nr_cva_todo, surface_pressure);
+			nr_cva_todo = 0;
+			vpmb_next_gradient(ds, deco_time, surface_pressure / 1000.0);
 			final_tts = 0;
 			last_ndl_tts_calc_time = 0;
 			first_ceiling = 0;
 			first_iteration = false;
 			count_iteration ++;
-			restore_deco_state(cache_data_initial);
+			restore_deco_state(ds, cache_data_initial);
 		} else {
 			// With Buhlmann, or not in planner, iterating isn't needed.  This makes the while condition false.
 			prev_deco_time = deco_time = 0;
 		}
 	}
 	free(cache_data_initial);
+	free(cva_todo);
 #if DECO_CALC_DEBUG & 1
-	dump_tissues();
+	dump_tissues(ds);
 #endif
 }
 #endif
@@ -1228,15 +1510,32 @@ static void debug_print_profiledata(struct plot_info *pi)
  * This also makes sure that we have extra empty events on both
  * sides, so that you can do end-points without having to worry
  * about it.
+ *
+ * The plot data belongs to the caller, who has to release it with
+ * free_plot_info_data(). All state is local to the call, so different
+ * dives can be plotted on different threads.
  */
-void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast)
+void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *planner_ds)
 {
-	int o2, he, o2max;
 #ifndef SUBSURFACE_MOBILE
-	init_decompression(dive);
+	struct deco_state plot_deco_state;
+	init_decompression(&plot_deco_state, dive, NULL);
 #endif
-	/* Create the new plot data */
-	free((void *)last_pi_entry_new);
+	create_plot_info_without_deco(dive, dc, pi, fast);
+#ifndef SUBSURFACE_MOBILE
+	calculate_deco_information(&plot_deco_state, planner_ds, dive, dc, pi, false); /* and ceiling information, using gradient factor values in Preferences) */
+#endif
+}
+
+/*
+ * All of create_plot_info_new() except the ceilings, NDL, TTS and tissue
+ * columns. Nothing else depends on those, so calculate_deco_information()
+ * can fill them in later - also on another thread, with the deco state
+ * from init_decompression() and copies of the dive and the plot info.
+ */
+void create_plot_info_without_deco(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast)
+{
+	int o2, he, o2max;
 
 	get_dive_gas(dive, &o2, &he, &o2max);
 	if (dc->divemode == FREEDIVE){
@@ -1250,7 +1549,11 @@ void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plo
 			pi->dive_type = AIR;
 	}
 
-	last_pi_entry_new = populate_plot_entries(dive, dc, pi);
+	populate_plot_entries(dive, dc, pi);
+	if (pi->columns & PLOT_TISSUE_CEILINGS)
+		pi->ceilings = calloc(pi->nr * 16, sizeof(int));
+	if (pi->columns & PLOT_TISSUE_PERCENTAGES)
+		pi->percentages = calloc(pi->nr * 16, sizeof(int));
 
 	check_gas_change_events(dive, dc, pi);   /* Populate the gas index from the gas change events */
 	check_setpoint_events(dive, dc, pi);     /* Populate setpoints */
@@ -1262,9 +1565,6 @@ void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plo
 	}
 	fill_o2_values(dc, pi, dive);			 /* .. and insert the O2 sensor data having 0 values. */
 	calculate_sac(dive, pi);			 /* Calculate sac */
-#ifndef SUBSURFACE_MOBILE
-	calculate_deco_information(dive, dc, pi, false); /* and ceiling information, using gradient factor values in Preferences) */
-#endif
 	calculate_gas_information_new(dive, pi);	 /* Calculate gas partial pressures */
 
 #ifdef DEBUG_GAS
@@ -1275,6 +1575,17 @@ void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plo
 	analyze_plot_info(pi);
 }
 
+void free_plot_info_data(struct plot_info *pi)
+{
+	free(pi->entry);
+	free(pi->ceilings);
+	free(pi->percentages);
+	pi->entry = NULL;
+	pi->ceilings = NULL;
+	pi->percentages = NULL;
+	pi->nr = 0;
+}
+
 struct divecomputer *select_dc(struct dive *dive)
 {
 	unsigned int max = number_of_computers(dive);
@@ -1396,11 +1707,12 @@ static void plot_string(struct plot_info *pi, struct plot_data *entry, struct me
 	if (entry->ceiling) {
 		depthvalue = get_depth_units(entry->ceiling, NULL, &depth_unit);
 		put_format(b, translate("gettextFromC", "Calculated ceiling %.0f%s\n"), depthvalue, depth_unit);
-		if (prefs.calcalltissues) {
+		int *ceilings = plot_tissue_ceilings(pi, entry - pi->entry);
+		if (prefs.calcalltissues && ceilings) {
 			int k;
 			for (k = 0; k < 16; k++) {
-				if (entry->ceilings[k]) {
-					depthvalue = get_depth_units(entry->ceilings[k], NULL, &depth_unit);
+				if (ceilings[k]) {
+					depthvalue = get_depth_units(ceilings[k], NULL, &depth_unit);
 					put_format(b, translate("gettextFromC", "Tissue %.0fmin: %.1f%s\n"), buehlmann_N2_t_halflife[k], depthvalue, depth_unit);
 				}
 			}
@@ -1418,18 +1730,43 @@ static void plot_string(struct plot_info *pi, struct plot_data *entry, struct me
 	strip_mb(b);
 }
 
-struct plot_data *get_plot_details_new(struct plot_info *pi, int time, struct membuffer *mb)
+/*
+ * The first entry at or after the given time, or the last one if the
+ * dive is shorter than that. When the time stamps are in order that's
+ * a binary search, as it is looked up for every mouse move.
+ */
+struct plot_data *get_plot_entry(struct plot_info *pi, int time)
 {
-	struct plot_data *entry = NULL;
-	int i;
+	int low = 0, high = pi->nr - 1;
 
-	for (i = 0; i < pi->nr; i++) {
-		entry = pi->entry + i;
-		if (entry->sec >= time)
-			break;
+	if (pi->nr <= 0)
+		return NULL;
+	if (!pi->in_order) {
+		while (low < high && pi->entry[low].sec < time)
+			low++;
+		return pi->entry + low;
+	}
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (pi->entry[mid].sec < time)
+			low = mid + 1;
+		else
+			high = mid;
 	}
+	return pi->entry + low;
+}
+
+void get_plot_entry_details(struct plot_info *pi, struct plot_data *entry, struct membuffer *mb)
+{
+	plot_string(pi, entry, mb, pi->has_ndl);
+}
+
+struct plot_data *get_plot_details_new(struct plot_info *pi, int time, struct membuffer *mb)
+{
+	struct plot_data *entry = get_plot_entry(pi, time);
+
 	if (entry)
-		plot_string(pi, entry, mb, pi->has_ndl);
+		get_plot_entry_details(pi, entry, mb);
 	return (entry);
 }
 
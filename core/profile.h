@@ -16,6 +16,7 @@ typedef enum {
 } velocity_t;
 
 struct membuffer;
+struct deco_state;
 struct divecomputer;
 struct plot_info;
 struct plot_data {
@@ -32,8 +33,6 @@ struct plot_data {
 	/* Depth info */
 	int depth;
 	int ceiling;
-	int ceilings[16];
-	int percentages[16];
 	int ndl;
 	int tts;
 	int rbt;
@@ -74,8 +73,13 @@ struct plot_info calculate_max_limits_new(struct dive *dive, struct divecomputer
 void compare_samples(struct plot_data *e1, struct plot_data *e2, char *buf, int bufsize, int sum);
 struct plot_data *populate_plot_entries(struct dive *dive, struct divecomputer *dc, struct plot_info *pi);
 struct plot_info *analyze_plot_info(struct plot_info *pi);
-void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast);
-void calculate_deco_information(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool print_mode);
+void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *planner_ds);
+void create_plot_info_without_deco(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast);
+void free_plot_info_data(struct plot_info *pi);
+void calculate_deco_information(struct deco_state *ds, struct deco_state *planner_ds, struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool print_mode);
+void calculate_ndl(struct deco_state *ds, struct plot_data *entry, struct dive *dive, double surface_pressure, bool closed_form);
+struct plot_data *get_plot_entry(struct plot_info *pi, int time);
+void get_plot_entry_details(struct plot_info *pi, struct plot_data *entry, struct membuffer *mb);
 struct plot_data *get_plot_details_new(struct plot_info *pi, int time, struct membuffer *);
 
 /*
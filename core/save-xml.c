@@ -189,77 +189,77 @@ static void show_index(struct membuffer *b, int value, const char *pre, const ch
 		show_integer(b, value, pre, post);
 }
 
-static void save_sample(struct membuffer *b, struct sample *sample, struct sample *old)
+static void save_sample(struct membuffer *b, struct divecomputer *dc, int idx, struct sample *old)
 {
-	put_format(b, "  <sample time='%u:%02u min'", FRACTION(sample->time.seconds, 60));
-	put_milli(b, " depth='", sample->depth.mm, " m'");
-	if (sample->temperature.mkelvin && sample->temperature.mkelvin != old->temperature.mkelvin) {
-		put_temperature(b, sample->temperature, " temp='", " C'");
-		old->temperature = sample->temperature;
+	put_format(b, "  <sample time='%u:%02u min'", FRACTION(dc_sample_time(dc, idx).seconds, 60));
+	put_milli(b, " depth='", dc_sample_depth(dc, idx).mm, " m'");
+	if (dc_sample_temperature(dc, idx).mkelvin && dc_sample_temperature(dc, idx).mkelvin != old->temperature.mkelvin) {
+		put_temperature(b, dc_sample_temperature(dc, idx), " temp='", " C'");
+		old->temperature = dc_sample_temperature(dc, idx);
 	}
-	put_pressure(b, sample->cylinderpressure, " pressure='", " bar'");
-	put_pressure(b, sample->o2cylinderpressure, " o2pressure='", " bar'");
+	put_pressure(b, dc_sample_cylinderpressure(dc, idx), " pressure='", " bar'");
+	put_pressure(b, dc_sample_o2cylinderpressure(dc, idx), " o2pressure='", " bar'");
 
 	/*
 	 * We only show sensor information for samples with pressure, and only if it
 	 * changed from the previous sensor we showed.
 	 */
-	if (sample->cylinderpressure.mbar && sample->sensor != old->sensor) {
-		put_format(b, " sensor='%d'", sample->sensor);
-		old->sensor = sample->sensor;
+	if (dc_sample_cylinderpressure(dc, idx).mbar && dc_sample_sensor(dc, idx) != old->sensor) {
+		put_format(b, " sensor='%d'", dc_sample_sensor(dc, idx));
+		old->sensor = dc_sample_sensor(dc, idx);
 	}
 
 	/* the deco/ndl values are stored whenever they change */
-	if (sample->ndl.seconds != old->ndl.seconds) {
-		put_format(b, " ndl='%u:%02u min'", FRACTION(sample->ndl.seconds, 60));
-		old->ndl = sample->ndl;
+	if (dc_sample_ndl(dc, idx).seconds != old->ndl.seconds) {
+		put_format(b, " ndl='%u:%02u min'", FRACTION(dc_sample_ndl(dc, idx).seconds, 60));
+		old->ndl = dc_sample_ndl(dc, idx);
 	}
-	if (sample->tts.seconds != old->tts.seconds) {
-		put_format(b, " tts='%u:%02u min'", FRACTION(sample->tts.seconds, 60));
-		old->tts = sample->tts;
+	if (dc_sample_tts(dc, idx).seconds != old->tts.seconds) {
+		put_format(b, " tts='%u:%02u min'", FRACTION(dc_sample_tts(dc, idx).seconds, 60));
+		old->tts = dc_sample_tts(dc, idx);
 	}
-	if (sample->rbt.seconds)
-		put_format(b, " rbt='%u:%02u min'", FRACTION(sample->rbt.seconds, 60));
-	if (sample->in_deco != old->in_deco) {
-		put_format(b, " in_deco='%d'", sample->in_deco ? 1 : 0);
-		old->in_deco = sample->in_deco;
+	if (dc_sample_rbt(dc, idx).seconds)
+		put_format(b, " rbt='%u:%02u min'", FRACTION(dc_sample_rbt(dc, idx).seconds, 60));
+	if (dc_sample_in_deco(dc, idx) != old->in_deco) {
+		put_format(b, " in_deco='%d'", dc_sample_in_deco(dc, idx) ? 1 : 0);
+		old->in_deco = dc_sample_in_deco(dc, idx);
 	}
-	if (sample->stoptime.seconds != old->stoptime.seconds) {
-		put_format(b, " stoptime='%u:%02u min'", FRACTION(sample->stoptime.seconds, 60));
-		old->stoptime = sample->stoptime;
+	if (dc_sample_stoptime(dc, idx).seconds != old->stoptime.seconds) {
+		put_format(b, " stoptime='%u:%02u min'", FRACTION(dc_sample_stoptime(dc, idx).seconds, 60));
+		old->stoptime = dc_sample_stoptime(dc, idx);
 	}
 
-	if (sample->stopdepth.mm != old->stopdepth.mm) {
-		put_milli(b, " stopdepth='", sample->stopdepth.mm, " m'");
-		old->stopdepth = sample->stopdepth;
+	if (dc_sample_stopdepth(dc, idx).mm != old->stopdepth.mm) {
+		put_milli(b, " stopdepth='", dc_sample_stopdepth(dc, idx).mm, " m'");
+		old->stopdepth = dc_sample_stopdepth(dc, idx);
 	}
 
-	if (sample->cns != old->cns) {
-		put_format(b, " cns='%u%%'", sample->cns);
-		old->cns = sample->cns;
+	if (dc_sample_cns(dc, idx) != old->cns) {
+		put_format(b, " cns='%u%%'", dc_sample_cns(dc, idx));
+		old->cns = dc_sample_cns(dc, idx);
 	}
 
-	if ((sample->o2sensor[0].mbar) && (sample->o2sensor[0].mbar != old->o2sensor[0].mbar)) {
-		put_milli(b, " sensor1='", sample->o2sensor[0].mbar, " bar'");
-		old->o2sensor[0] = sample->o2sensor[0];
+	if ((dc_sample_o2sensor(dc, idx, 0).mbar) && (dc_sample_o2sensor(dc, idx, 0).mbar != old->o2sensor[0].mbar)) {
+		put_milli(b, " sensor1='", dc_sample_o2sensor(dc, idx, 0).mbar, " bar'");
+		old->o2sensor[0] = dc_sample_o2sensor(dc, idx, 0);
 	}
 
-	if ((sample->o2sensor[1].mbar) && (sample->o2sensor[1].mbar != old->o2sensor[1].mbar)) {
-		put_milli(b, " sensor2='", sample->o2sensor[1].mbar, " bar'");
-		old->o2sensor[1] = sample->o2sensor[1];
+	if ((dc_sample_o2sensor(dc, idx, 1).mbar) && (dc_sample_o2sensor(dc, idx, 1).mbar != old->o2sensor[1].mbar)) {
+		put_milli(b, " sensor2='", dc_sample_o2sensor(dc, idx, 1).mbar, " bar'");
+		old->o2sensor[1] = dc_sample_o2sensor(dc, idx, 1);
 	}
 
-	if ((sample->o2sensor[2].mbar) && (sample->o2sensor[2].mbar != old->o2sensor[2].mbar)) {
-		put_milli(b, " sensor3='", sample->o2sensor[2].mbar, " bar'");
-		old->o2sensor[2] = sample->o2sensor[2];
+	if ((dc_sample_o2sensor(dc, idx, 2).mbar) && (dc_sample_o2sensor(dc, idx, 2).mbar != old->o2sensor[2].mbar)) {
+		put_milli(b, " sensor3='", dc_sample_o2sensor(dc, idx, 2).mbar, " bar'");
+		old->o2sensor[2] = dc_sample_o2sensor(dc, idx, 2);
 	}
 
-	if (sample->setpoint.mbar != old->setpoint.mbar) {
-		put_milli(b, " po2='", sample->setpoint.mbar, " bar'");
-		old->setpoint = sample->setpoint;
+	if (dc_sample_setpoint(dc, idx).mbar != old->setpoint.mbar) {
+		put_milli(b, " po2='", dc_sample_setpoint(dc, idx).mbar, " bar'");
+		old->setpoint = dc_sample_setpoint(dc, idx);
 	}
-	show_index(b, sample->heartbeat, "heartbeat='", "'");
-	show_index(b, sample->bearing.degrees, "bearing='", "'");
+	show_index(b, dc_sample_heartbeat(dc, idx), "heartbeat='", "'");
+	show_index(b, dc_sample_bearing(dc, idx).degrees, "bearing='", "'");
 	put_format(b, " />\n");
 }
 
@@ -328,14 +328,13 @@ static void show_date(struct membuffer *b, timestamp_t when)
 		   tm.tm_hour, tm.tm_min, tm.tm_sec);
 }
 
-static void save_samples(struct membuffer *b, int nr, struct sample *s)
+static void save_samples(struct membuffer *b, struct divecomputer *dc)
 {
 	struct sample dummy = {};
+	int i;
 
-	while (--nr >= 0) {
-		save_sample(b, s, &dummy);
-		s++;
-	}
+	for (i = 0; i < dc->samples; i++)
+		save_sample(b, dc, i, &dummy);
 }
 
 static void save_dc(struct membuffer *b, struct dive *dive, struct divecomputer *dc)
@@ -365,7 +364,7 @@ static void save_dc(struct membuffer *b, struct dive *dive, struct divecomputer
 	put_duration(b, dc->surfacetime, "  <surfacetime>", " min</surfacetime>\n");
 	save_extra_data(b, dc->extra_data);
 	save_events(b, dive, dc->events);
-	save_samples(b, dc->samples, dc->sample);
+	save_samples(b, dc);
 
 	put_format(b, "  </divecomputer>\n");
 }
@@ -528,7 +527,7 @@ void save_dives_buffer(struct membuffer *b, const bool select_only)
 		if (dive_site_is_empty(ds)) {
 			for_each_dive(j, d) {
 				if (d->dive_site_uuid == ds->uuid)
-					d->dive_site_uuid = 0;
+					set_dive_site_uuid(d, 0);
 			}
 			delete_dive_site(ds->uuid);
 			i--; // since we just deleted that one
@@ -116,6 +116,7 @@ static int sortfn(const void *_a, const void *_b)
 void sort_table(struct dive_table *table)
 {
 	qsort(table->dives, table->nr, sizeof(struct dive *), sortfn);
+	update_dive_index(table);
 }
 
 const char *weekday(int wday)
@@ -905,7 +905,7 @@ static bool process_raw_buffer(device_data_t *devdata, uint32_t deviceid, char *
 		} else if (!is_log && dive && !strcmp(tag, "divespot_id")) {
 			int divespot_id = atoi(val);
 			if (divespot_id != -1) {
-				dive->dive_site_uuid = create_dive_site("from Uemis", dive->when);
+				set_dive_site_uuid(dive, create_dive_site("from Uemis", dive->when));
 				uemis_mark_divelocation(dive->dc.diveid, divespot_id, dive->dive_site_uuid);
 			}
 #if UEMIS_DEBUG & 2
@@ -1105,7 +1105,7 @@ static void get_uemis_divespot(const char *mountpath, int divespot_id, struct di
 				/* if the uuid's are the same, the new site is a duplicate and can be deleted */
 				if (nds->uuid != ods->uuid) {
 					delete_dive_site(nds->uuid);
-					dive->dive_site_uuid = ods->uuid;
+					set_dive_site_uuid(dive, ods->uuid);
 				}
 			}
 		} else {
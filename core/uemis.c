@@ -172,9 +172,10 @@ void uemis_set_divelocation(int divespot, char *text, double longitude, double l
 		if (hp->divespot == divespot) {
 			struct dive_site *ds = get_dive_site_by_uuid(hp->dive_site_uuid);
 			if (ds) {
+				degrees_t lat = { round(latitude * 1000000) }, lon = { round(longitude * 1000000) };
+
 				ds->name = strdup(text);
-				ds->longitude.udeg = round(longitude * 1000000);
-				ds->latitude.udeg = round(latitude * 1000000);
+				set_dive_site_gps(ds, lat, lon);
 			}
 		}
 		hp = hp->next;
@@ -24,8 +24,8 @@
 #include "core/metrics.h"
 #include "core/helpers.h"
 
-//                                #  Date  Rtg Dpth  Dur  Tmp Wght Suit  Cyl  Gas  SAC  OTU  CNS  Px  Loc
-static int defaultWidth[] =    {  70, 140, 90,  50,  50,  50,  50,  70,  50,  50,  70,  50,  50,  5, 500};
+//                                #  Date  Rtg Dpth  Dur  Tmp Wght Suit  Cyl  Gas  SAC  OTU  CNS  Px  Loc Ceil   GF Deco
+static int defaultWidth[] =    {  70, 140, 90,  50,  50,  50,  50,  70,  50,  50,  70,  50,  50,  5, 500,  50,  50,  50};
 
 DiveListView::DiveListView(QWidget *parent) : QTreeView(parent), mouseClickSelection(false), sortColumn(0),
 	currentOrder(Qt::DescendingOrder), dontEmitDiveChangedSignal(false), selectionSaved(false)
@@ -109,8 +109,8 @@ DiveListView::~DiveListView()
 	QSettings settings;
 	settings.beginGroup("ListWidget");
 	// don't set a width for the last column - location is supposed to be "the rest"
-	for (int i = DiveTripModel::NR; i < DiveTripModel::COLUMNS - 1; i++) {
-		if (isColumnHidden(i))
+	for (int i = DiveTripModel::NR; i < DiveTripModel::COLUMNS; i++) {
+		if (isColumnHidden(i) || i == DiveTripModel::LOCATION)
 			continue;
 		// we used to hardcode them all to 100 - so that might still be in the settings
 		if (columnWidth(i) == 100 || columnWidth(i) == defaultWidth[i])
@@ -118,7 +118,7 @@ DiveListView::~DiveListView()
 		else
 			settings.setValue(QString("colwidth%1").arg(i), columnWidth(i));
 	}
-	settings.remove(QString("colwidth%1").arg(DiveTripModel::COLUMNS - 1));
+	settings.remove(QString("colwidth%1").arg(DiveTripModel::LOCATION));
 	settings.endGroup();
 }
 
@@ -282,6 +282,7 @@ void DiveListView::unselectDives()
 	for_each_dive (i, dive) {
 		dive->selected = false;
 	}
+	invalidate_dive_site_counts();
 }
 
 QList<dive_trip_t *> DiveListView::selectedTrips()
@@ -482,7 +483,10 @@ void DiveListView::reloadHeaderActions()
 						    i == DiveTripModel::TOTALWEIGHT ||
 						    i == DiveTripModel::SUIT ||
 						    i == DiveTripModel::CYLINDER ||
-						    i == DiveTripModel::SAC);
+						    i == DiveTripModel::SAC ||
+						    i == DiveTripModel::MAXCEILING ||
+						    i == DiveTripModel::SURFACEGF ||
+						    i == DiveTripModel::DECOTIME);
 			bool shown = s.value(settingName, showHeaderFirstRun).toBool();
 			a->setCheckable(true);
 			a->setChecked(shown);
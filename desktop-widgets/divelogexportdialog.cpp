@@ -240,6 +240,10 @@ void DiveLogExportDialog::export_TeX(const char *filename, const bool selected_o
 	bool need_pagebreak = false;
 
 	struct membuffer buf = {};
+	ProfileWidget2 *profile = MainWindow::instance()->graphics();
+	// the profiles of the next few dives are calculated at once, on all cores
+	int batchSize = 4 * QThreadPool::globalInstance()->maxThreadCount();
+	int precalculatedUpTo = 0;
 
 	put_format(&buf, "\\input subsurfacetemplate\n");
 	put_format(&buf, "%% This is a plain TeX file. Compile with pdftex, not pdflatex!\n");
@@ -249,8 +253,16 @@ void DiveLogExportDialog::export_TeX(const char *filename, const bool selected_o
 		if (selected_only && !dive->selected)
 			continue;
 
+		if (i >= precalculatedUpTo) {
+			QVector<struct dive *> dives;
+			struct dive *next;
+			for (precalculatedUpTo = i; dives.count() < batchSize && (next = get_dive(precalculatedUpTo)) != NULL; precalculatedUpTo++) {
+				if (!selected_only || next->selected)
+					dives.append(next);
+			}
+			profile->precalculateProfiles(dives);
+		}
 		QString filename = "profile%1.png";
-		ProfileWidget2 *profile = MainWindow::instance()->graphics();
 		profile->plotDive(dive, true);
 		profile->setToolTipVisibile(false);
 		QPixmap pix = QPixmap::grabWidget(profile);
@@ -301,6 +313,7 @@ void DiveLogExportDialog::export_TeX(const char *filename, const bool selected_o
 		put_format(&buf, "\\def\\buddy{%s}\n", dive->buddy ? dive->buddy : "");
 		put_format(&buf, "\\page\n");
 	}
+	profile->clearPrecalculatedProfiles();
 
 	put_format(&buf, "\\bye\n");
 
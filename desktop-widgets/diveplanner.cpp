@@ -282,6 +282,70 @@ void DivePlannerWidget::printDecoPlan()
 	MainWindow::instance()->printPlan();
 }
 
+static QString signedDepth(int mm)
+{
+	int frac;
+	const char *unit;
+	double depth = get_depth_units(mm, &frac, &unit);
+
+	return QString("%1%2 %3").arg(mm > 0 ? "+" : "").arg(depth, 0, 'f', frac).arg(unit);
+}
+
+/* A table of how runtime and gas use change with the gradient factors, the bottom time
+ * and the depth, the way instructors like to hand them out with a plan */
+void DivePlannerWidget::sweepDecoPlan()
+{
+	QVector<QPair<int, int> > gfs;
+	QVector<int> bottomTimeDeltas, depthDeltas;
+	bool used[MAX_CYLINDERS] = {};
+
+	gfs << qMakePair(-1, -1);
+	if (prefs.planner_deco_mode != VPMB)
+		gfs << qMakePair(30, 70) << qMakePair(40, 85) << qMakePair(50, 80);
+	bottomTimeDeltas << -600 << -300 << 0 << 300 << 600;
+	depthDeltas << -M_OR_FT(3, 10) << 0 << M_OR_FT(3, 10);
+	QVector<struct plan_sweep_cell> cells = plannerModel->sweepPlan(gfs, bottomTimeDeltas, depthDeltas);
+	if (cells.isEmpty())
+		return;
+
+	Q_FOREACH (const struct plan_sweep_cell &cell, cells) {
+		for (int i = 0; i < MAX_CYLINDERS; i++)
+			if (cell.gas_used[i].mliter)
+				used[i] = true;
+	}
+	QString table = QString("<table><tr><th>%1</th><th>%2</th><th>%3</th><th>%4</th>")
+				.arg(tr("GF"), tr("Depth"), tr("Bottom time"), tr("Runtime"));
+	for (int i = 0; i < MAX_CYLINDERS; i++)
+		if (used[i])
+			table += QString("<th>%1</th>").arg(gasname(&displayed_dive.cylinder[i].gasmix));
+	table += "</tr>";
+	Q_FOREACH (const struct plan_sweep_cell &cell, cells) {
+		if (!cell.valid)
+			continue;
+		table += "<tr><td>";
+		if (cell.gflow == -1)
+			table += tr("as planned");
+		else
+			table += QString("%1/%2").arg(cell.gflow).arg(cell.gfhigh);
+		table += QString("</td><td>%1</td><td>%2%3 %4</td><td>%5 %6</td>")
+				.arg(cell.depth_delta ? signedDepth(cell.depth_delta) : QString("±0"))
+				.arg(cell.bottom_time_delta > 0 ? "+" : (cell.bottom_time_delta ? "" : "±"))
+				.arg(cell.bottom_time_delta / 60).arg(tr("min"))
+				.arg((cell.runtime + 30) / 60).arg(tr("min"));
+		for (int i = 0; i < MAX_CYLINDERS; i++) {
+			if (!used[i])
+				continue;
+			int frac;
+			const char *unit;
+			double volume = get_volume_units(cell.gas_used[i].mliter, &frac, &unit);
+			table += QString("<td>%1 %2</td>").arg(volume, 0, 'f', frac).arg(unit);
+		}
+		table += "</tr>";
+	}
+	table += "</table>";
+	MainWindow::instance()->plannerDetails()->divePlanOutput()->append(table);
+}
+
 PlannerSettingsWidget::PlannerSettingsWidget(QWidget *parent, Qt::WindowFlags f) : QWidget(parent, f)
 {
 	ui.setupUi(this);
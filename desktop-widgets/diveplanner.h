@@ -52,6 +52,7 @@ slots:
 	void heightChanged(const int height);
 	void salinityChanged(const double salinity);
 	void printDecoPlan();
+	void sweepDecoPlan();
 	void setSurfacePressure(int surface_pressure);
 	void setSalinity(int salinity);
 
@@ -97,6 +98,7 @@ class PlannerDetails : public QWidget {
 public:
 	explicit PlannerDetails(QWidget *parent = 0);
 	QPushButton *printPlan() const { return ui.printPlan; }
+	QPushButton *sweepPlan() const { return ui.sweepPlan; }
 	QTextEdit *divePlanOutput() const { return ui.divePlanOutput; }
 
 private:
@@ -137,8 +137,7 @@ void LocationInformationWidget::acceptChanges()
 	else
 		currentDs = get_dive_site_by_uuid(create_dive_site_from_current_dive(uiString));
 
-	currentDs->latitude = displayed_dive_site.latitude;
-	currentDs->longitude = displayed_dive_site.longitude;
+	set_dive_site_gps(currentDs, displayed_dive_site.latitude, displayed_dive_site.longitude);
 	if (!same_string(uiString, currentDs->name)) {
 		free(currentDs->name);
 		currentDs->name = copy_string(uiString);
@@ -155,13 +154,15 @@ void LocationInformationWidget::acceptChanges()
 	}
 	if (!ui.diveSiteCoordinates->text().isEmpty()) {
 		double lat, lon;
+		degrees_t latitude, longitude;
 		parseGpsText(ui.diveSiteCoordinates->text(), &lat, &lon);
-		currentDs->latitude.udeg = lat * 1000000.0;
-		currentDs->longitude.udeg = lon * 1000000.0;
+		latitude.udeg = lat * 1000000.0;
+		longitude.udeg = lon * 1000000.0;
+		set_dive_site_gps(currentDs, latitude, longitude);
 	}
 	if (dive_site_is_empty(currentDs)) {
 		LocationInformationModel::instance()->removeRow(get_divesite_idx(currentDs));
-		displayed_dive.dive_site_uuid = 0;
+		set_dive_site_uuid(&displayed_dive, 0);
 	}
 	copy_dive_site(currentDs, &displayed_dive_site);
 	mark_divelist_changed(true);
@@ -856,8 +856,7 @@ uint32_t MainTab::updateDiveSite(uint32_t pickedUuid, int divenr)
 			newDs->uuid = pickedUuid;
 			qDebug() << "Creating and copying dive site";
 		} else if (newDs->latitude.udeg == 0 && newDs->longitude.udeg == 0) {
-			newDs->latitude.udeg = origDs->latitude.udeg;
-			newDs->longitude.udeg = origDs->longitude.udeg;
+			set_dive_site_gps(newDs, origDs->latitude, origDs->longitude);
 			qDebug() << "Copying GPS information";
 		}
 	}
@@ -870,7 +869,7 @@ uint32_t MainTab::updateDiveSite(uint32_t pickedUuid, int divenr)
 		}
 	}
 
-	cd->dive_site_uuid = pickedUuid;
+	set_dive_site_uuid(cd, pickedUuid);
 	qDebug() << "Setting the dive site id on the dive:" << pickedUuid;
 	return pickedUuid;
 }
@@ -1041,7 +1040,7 @@ void MainTab::acceptChanges()
 		// code below triggers an update of the display without re-initializing displayed_dive
 		// so let's make sure here that our data is consistent now that we have handled the
 		// dive sites
-		displayed_dive.dive_site_uuid = current_dive->dive_site_uuid;
+		set_dive_site_uuid(&displayed_dive, current_dive->dive_site_uuid);
 		struct dive_site *ds = get_dive_site_by_uuid(displayed_dive.dive_site_uuid);
 		if (ds)
 			copy_dive_site(ds, &displayed_dive_site);
@@ -1454,7 +1453,7 @@ void MainTab::on_location_diveSiteSelected()
 		return;
 
 	if (ui.location->text().isEmpty()) {
-		displayed_dive.dive_site_uuid = 0;
+		set_dive_site_uuid(&displayed_dive, 0);
 		markChangedWidget(ui.location);
 		emit diveSiteChanged(0);
 		return;
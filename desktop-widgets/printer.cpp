@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <QPainter>
+#include <QThreadPool>
 #ifdef USE_WEBENGINE
 #include <QtWebEngineWidgets>
 #else
@@ -14,6 +15,15 @@
 #endif
 #include "profile-widget/profilewidget2.h"
 
+#ifndef USE_WEBENGINE
+// dive id field should be dive_{{dive_no}} se we remove the first 5 characters
+static struct dive *profileDive(const QWebElement &element)
+{
+	QString diveIdString = element.attribute("id");
+	return get_dive_by_uniq_id(diveIdString.remove(0, 5).toInt(0, 10));
+}
+#endif
+
 Printer::Printer(QPaintDevice *paintDevice, print_options *printOptions, template_options *templateOptions,  PrintMode printMode)
 {
 	this->paintDevice = paintDevice;
@@ -164,17 +174,22 @@ void Printer::render(int Pages = 0)
 	}
 	profile->setFontPrintScale(printFontScale);
 
-	int elemNo = 0;
+	// the profiles are calculated a few pages ahead, on all cores at once
+	int batchSize = 4 * QThreadPool::globalInstance()->maxThreadCount();
+	int elemNo = 0, precalculatedUpTo = 0;
 	for (int i = 0; i < Pages; i++) {
 		// render the base Html template
 		webView->page()->mainFrame()->render(&painter, QWebFrame::ContentsLayer);
 
 		// render all the dive profiles in the current page
 		while (elemNo < collection.count() && collection.at(elemNo).geometry().y() < viewPort.y() + viewPort.height()) {
-			// dive id field should be dive_{{dive_no}} se we remove the first 5 characters
-			QString diveIdString = collection.at(elemNo).attribute("id");
-			int diveId = diveIdString.remove(0, 5).toInt(0, 10);
-			putProfileImage(collection.at(elemNo).geometry(), viewPort, &painter, get_dive_by_uniq_id(diveId), profile);
+			if (elemNo == precalculatedUpTo) {
+				QVector<struct dive *> dives;
+				for (; precalculatedUpTo < collection.count() && precalculatedUpTo < elemNo + batchSize; precalculatedUpTo++)
+					dives.append(profileDive(collection.at(precalculatedUpTo)));
+				profile->precalculateProfiles(dives);
+			}
+			putProfileImage(collection.at(elemNo).geometry(), viewPort, &painter, profileDive(collection.at(elemNo)), profile);
 			elemNo++;
 		}
 
@@ -188,6 +203,7 @@ void Printer::render(int Pages = 0)
 			static_cast<QPrinter*>(paintDevice)->newPage();
 	}
 	painter.end();
+	profile->clearPrecalculatedProfiles();
 #endif
 
 	// return profle settings
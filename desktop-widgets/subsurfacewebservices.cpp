@@ -42,10 +42,9 @@ static void copy_gps_location(struct dive *from, struct dive *to)
 		struct dive_site *gds = get_dive_site_for_dive(from);
 		if (!ds) {
 			// simply link to the one created for the fake dive
-			to->dive_site_uuid = gds->uuid;
+			set_dive_site_uuid(to, gds->uuid);
 		} else {
-			ds->latitude = gds->latitude;
-			ds->longitude = gds->longitude;
+			set_dive_site_gps(ds, gds->latitude, gds->longitude);
 			if (same_string(ds->name, ""))
 				ds->name = copy_string(gds->name);
 		}
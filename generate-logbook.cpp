@@ -0,0 +1,86 @@
+/* Make up large logbooks for scale testing */
+
+#include <QString>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+
+#include "qt-gui.h"
+#include "qthelper.h"
+#include "dive.h"
+#include "git2.h"
+#include "git-access.h"
+#include "subsurfacestartup.h"
+#include "generate-logbook.h"
+
+static int intValue(const QCommandLineParser &parser, const QCommandLineOption &option, int value)
+{
+	return parser.isSet(option) ? parser.value(option).toInt() : value;
+}
+
+int main(int argc, char **argv)
+{
+	QApplication *application = new QApplication(argc, argv);
+	struct logbook_shape shape;
+
+	git_libgit2_init();
+	copy_prefs(&default_prefs, &prefs);
+	init_qt_late();
+	default_logbook_shape(&shape);
+
+	QCommandLineParser parser;
+	QCommandLineOption outputOption(QStringList() << "o" << "output",
+					"Write the logbook to <file>, or to the git repository <directory[branch]>",
+					"file");
+	parser.addOption(outputOption);
+	QCommandLineOption divesOption(QStringList() << "dives",
+				       QString("Make up <n> dives (default: %1)").arg(shape.dives),
+				       "n");
+	parser.addOption(divesOption);
+	QCommandLineOption sitesOption(QStringList() << "sites",
+				       QString("Spread them over <n> dive sites (default: %1)").arg(shape.dive_sites),
+				       "n");
+	parser.addOption(sitesOption);
+	QCommandLineOption rateOption(QStringList() << "rate",
+				      QString("One sample every <s> seconds (default: %1)").arg(shape.sample_rate),
+				      "s");
+	parser.addOption(rateOption);
+	QCommandLineOption computersOption(QStringList() << "computers",
+					   QString("<n> dive computers per dive (default: %1)").arg(shape.dive_computers),
+					   "n");
+	parser.addOption(computersOption);
+	QCommandLineOption ccrOption(QStringList() << "ccr",
+				     QString("<p> percent of the dives on a rebreather (default: %1)").arg(shape.ccr_percent),
+				     "p");
+	parser.addOption(ccrOption);
+	QCommandLineOption seedOption(QStringList() << "seed",
+				      QString("Different seeds make different logbooks (default: %1)").arg(shape.seed),
+				      "n");
+	parser.addOption(seedOption);
+
+	parser.process(*application);
+
+	QString output = parser.value(outputOption);
+	if (output.isEmpty()) {
+		qDebug() << "need --output";
+		exit(1);
+	}
+	shape.dives = intValue(parser, divesOption, shape.dives);
+	shape.dive_sites = intValue(parser, sitesOption, shape.dive_sites);
+	shape.sample_rate = qMax(intValue(parser, rateOption, shape.sample_rate), 1);
+	shape.dive_computers = qMax(intValue(parser, computersOption, shape.dive_computers), 1);
+	shape.ccr_percent = intValue(parser, ccrOption, shape.ccr_percent);
+	shape.seed = intValue(parser, seedOption, shape.seed);
+
+	// a new git repository has to exist before we can save into it
+	if (output.endsWith(']') && !QDir(output.left(output.indexOf('['))).exists() &&
+	    git_create_local_repo(qPrintable(output)))
+		exit(1);
+
+	generate_logbook(&shape, &dive_table);
+	if (save_dives(qPrintable(output))) {
+		fprintf(stderr, "saving %s failed\n", qPrintable(output));
+		exit(1);
+	}
+	exit(0);
+}
@@ -560,13 +560,15 @@ void QMLManager::refreshDiveList()
 static void setupDivesite(struct dive *d, struct dive_site *ds, double lat, double lon, const char *locationtext)
 {
 	if (ds) {
-		ds->latitude.udeg = lat * 1000000;
-		ds->longitude.udeg = lon * 1000000;
+		degrees_t latData, lonData;
+		latData.udeg = lat * 1000000;
+		lonData.udeg = lon * 1000000;
+		set_dive_site_gps(ds, latData, lonData);
 	} else {
 		degrees_t latData, lonData;
 		latData.udeg = lat;
 		lonData.udeg = lon;
-		d->dive_site_uuid = create_dive_site_with_gps(locationtext, latData, lonData, d->when);
+		set_dive_site_uuid(d, create_dive_site_with_gps(locationtext, latData, lonData, d->when));
 	}
 }
 
@@ -682,7 +684,7 @@ bool QMLManager::checkLocation(DiveObjectHelper *myDive, struct dive *d, QString
 	if (myDive->location() != location) {
 		diveChanged = true;
 		ds = get_dive_site_by_uuid(create_dive_site(qPrintable(location), d->when));
-		d->dive_site_uuid = ds->uuid;
+		set_dive_site_uuid(d, ds->uuid);
 	}
 	// now make sure that the GPS coordinates match - if the user changed the name but not
 	// the GPS coordinates, this still does the right thing as the now new dive site will
@@ -93,6 +93,55 @@ bool AbstractProfilePolygonItem::shouldCalculateStuff(const QModelIndex &topLeft
 	return true;
 }
 
+// The width of a device pixel in scene coordinates, or 0 if we aren't on screen
+qreal AbstractProfilePolygonItem::pixelWidth() const
+{
+	if (!scene() || scene()->views().isEmpty())
+		return 0.0;
+	ProfileWidget2 *view = qobject_cast<ProfileWidget2 *>(scene()->views().first());
+	// printers have a much finer resolution than the widget, they get everything
+	if (!view || view->getPrintMode())
+		return 0.0;
+	qreal scale = view->transform().m11() * view->devicePixelRatio();
+	return scale > 0.0 ? 1.0 / scale : 0.0;
+}
+
+QPolygonF AbstractProfilePolygonItem::decimate(const QPolygonF &poly, QVector<int> *rows) const
+{
+	qreal width = pixelWidth();
+	if (width <= 0.0 || poly.count() <= 4)
+		return poly;
+
+	QPolygonF result;
+	QVector<int> keptRows;
+	int count = poly.count();
+	for (int i = 0; i < count;) {
+		// the points up to end fall into the same pixel column - the profile can go
+		// back in time (the reported ceiling does), so a new column starts a new group
+		qreal column = floor(poly[i].x() / width);
+		int end = i + 1, top = i, bottom = i;
+		while (end < count && floor(poly[end].x() / width) == column) {
+			if (poly[end].y() < poly[top].y())
+				top = end;
+			if (poly[end].y() > poly[bottom].y())
+				bottom = end;
+			end++;
+		}
+		int keep[4] = { i, qMin(top, bottom), qMax(top, bottom), end - 1 };
+		for (int k = 0; k < 4; k++) {
+			if (k && keep[k] == keep[k - 1])
+				continue;
+			result.append(poly[keep[k]]);
+			if (rows)
+				keptRows.append(rows->at(keep[k]));
+		}
+		i = end;
+	}
+	if (rows)
+		*rows = keptRows;
+	return result;
+}
+
 void AbstractProfilePolygonItem::modelDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
 	Q_UNUSED(topLeft);
@@ -103,13 +152,15 @@ void AbstractProfilePolygonItem::modelDataChanged(const QModelIndex &topLeft, co
 	// is an array of QPointF's, so we basically get the point from the model, convert
 	// to our coordinates, store. no painting is done here.
 	QPolygonF poly;
+	polygonRows.clear();
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
 		qreal horizontalValue = dataModel->index(i, hDataColumn).data().toReal();
 		qreal verticalValue = dataModel->index(i, vDataColumn).data().toReal();
 		QPointF point(hAxis->posAtValue(horizontalValue), vAxis->posAtValue(verticalValue));
 		poly.append(point);
+		polygonRows.append(i);
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly, &polygonRows));
 
 	qDeleteAll(texts);
 	texts.clear();
@@ -146,12 +197,11 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 	pen.setWidth(2);
 	QPolygonF poly = polygon();
 	// This paints the colors of the velocities.
-	for (int i = 1, count = dataModel->rowCount(); i < count; i++) {
-		QModelIndex colorIndex = dataModel->index(i, DivePlotDataModel::COLOR);
+	for (int i = 1, count = qMin(polygonRows.count(), poly.count()); i < count; i++) {
+		QModelIndex colorIndex = dataModel->index(polygonRows[i], DivePlotDataModel::COLOR);
 		pen.setBrush(QBrush(colorIndex.data(Qt::BackgroundRole).value<QColor>()));
 		painter->setPen(pen);
-		if (i < poly.count())
-			painter->drawLine(poly[i - 1], poly[i]);
+		painter->drawLine(poly[i - 1], poly[i]);
 	}
 	painter->restore();
 }
@@ -159,10 +209,12 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 int DiveProfileItem::maxCeiling(int row)
 {
 	int max = -1;
-	plot_data *entry = dataModel->data().entry + row;
+	int *ceilings = plot_tissue_ceilings(&dataModel->data(), row);
+	if (!ceilings)
+		return max;
 	for (int tissue = 0; tissue < 16; tissue++) {
-		if (max < entry->ceilings[tissue])
-			max = entry->ceilings[tissue];
+		if (max < ceilings[tissue])
+			max = ceilings[tissue];
 	}
 	return max;
 }
@@ -191,7 +243,8 @@ void DiveProfileItem::modelDataChanged(const QModelIndex &topLeft, const QModelI
 			// Don't scream if we violate the ceiling by a few cm
 			if (entry->depth < max - 100 && entry->sec > 0) {
 				profileColor = QColor(Qt::red);
-				if (!eventAdded) {
+				// the polygon is rebuilt whenever the zoom changes, only warn once
+				if (!eventAdded && !get_next_event(displayed_dive.dc.events, "planned waypoint above ceiling")) {
 					add_event(&displayed_dive.dc, entry->sec, SAMPLE_EVENT_CEILING, -1, max / 1000, "planned waypoint above ceiling");
 					eventAdded = true;
 				}
@@ -201,7 +254,7 @@ void DiveProfileItem::modelDataChanged(const QModelIndex &topLeft, const QModelI
 #endif
 	/* Show any ceiling we may have encountered */
 	if (prefs.dcceiling && !prefs.redceiling) {
-		QPolygonF p = polygon();
+		QPolygonF p;
 		plot_data *entry = dataModel->data().entry + dataModel->rowCount() - 1;
 		for (int i = dataModel->rowCount() - 1; i >= 0; i--, entry--) {
 			if (!entry->in_deco) {
@@ -211,7 +264,8 @@ void DiveProfileItem::modelDataChanged(const QModelIndex &topLeft, const QModelI
 				p.append(QPointF(hAxis->posAtValue(entry->sec), vAxis->posAtValue(qMin(entry->stopdepth, entry->depth))));
 			}
 		}
-		setPolygon(p);
+		// only the depth line gets the speed colors, so this part needs no rows
+		setPolygon(polygon() + decimate(p));
 	}
 
 	// This is the blueish gradient that the Depth Profile should have.
@@ -326,7 +380,7 @@ void DiveHeartrateItem::modelDataChanged(const QModelIndex &topLeft, const QMode
 		createTextItem(sec, hr);
 		last_printed_hr = hr;
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -372,12 +426,14 @@ void DivePercentageItem::modelDataChanged(const QModelIndex &topLeft, const QMod
 
 	// Ignore empty values. a heartrate of 0 would be a bad sign.
 	QPolygonF poly;
+	polygonRows.clear();
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
 		sec = dataModel->index(i, hDataColumn).data().toInt();
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(64 - 4 * tissueIndex));
 		poly.append(point);
+		polygonRows.append(i);
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly, &polygonRows));
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -419,15 +475,13 @@ void DivePercentageItem::paint(QPainter *painter, const QStyleOptionGraphicsItem
 	mypen.setWidthF(vAxis->posAtValue(0) - vAxis->posAtValue(4));
 	mypen.setCosmetic(false);
 	QPolygonF poly = polygon();
-	for (int i = 1, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		if (i < poly.count()) {
-			double value = dataModel->index(i, vDataColumn).data().toDouble();
-			int cyl = dataModel->index(i, DivePlotDataModel::CYLINDERINDEX).data().toInt();
-			int inert = 1000 - get_o2(&displayed_dive.cylinder[cyl].gasmix);
-			mypen.setBrush(QBrush(ColorScale(value, inert)));
-			painter->setPen(mypen);
-			painter->drawLine(poly[i - 1], poly[i]);
-		}
+	for (int i = 1, count = qMin(polygonRows.count(), poly.count()); i < count; i++) {
+		double value = dataModel->index(polygonRows[i], vDataColumn).data().toDouble();
+		int cyl = dataModel->index(polygonRows[i], DivePlotDataModel::CYLINDERINDEX).data().toInt();
+		int inert = 1000 - get_o2(&displayed_dive.cylinder[cyl].gasmix);
+		mypen.setBrush(QBrush(ColorScale(value, inert)));
+		painter->setPen(mypen);
+		painter->drawLine(poly[i - 1], poly[i]);
 	}
 	painter->restore();
 }
@@ -460,7 +514,7 @@ void DiveAmbPressureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(hr));
 		poly.append(point);
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -508,7 +562,7 @@ void DiveGFLineItem::modelDataChanged(const QModelIndex &topLeft, const QModelIn
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(hr));
 		poly.append(point);
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -570,7 +624,7 @@ void DiveTemperatureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 			createTextItem(sec, mkelvin);
 		last_printed_temp = mkelvin;
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 
 	/* it would be nice to print the end temperature, if it's
 	* different or if the last temperature print has been more
@@ -640,7 +694,7 @@ void DiveMeanDepthItem::modelDataChanged(const QModelIndex &topLeft, const QMode
 		poly.append(point);
 	}
 	lastRunningSum = meandepthvalue;
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 	createTextItem();
 }
 
@@ -685,8 +739,11 @@ void DiveGasPressureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 	int o2mbar;
 	QPolygonF boundingPoly, o2Poly; // This is the "Whole Item", but a pressure can be divided in N Polygons.
 	polygons.clear();
-	if (displayed_dive.dc.divemode == CCR)
+	pressureRows.clear();
+	if (displayed_dive.dc.divemode == CCR) {
 		polygons.append(o2Poly);
+		pressureRows.append(QVector<int>());
+	}
 
 	for (int i = 0, count = dataModel->rowCount(); i < count; i++) {
 		o2mbar = 0;
@@ -697,6 +754,7 @@ void DiveGasPressureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 
 		if ((int)entry->cylinderindex != last_index) {
 			polygons.append(QPolygonF()); // this is the polygon that will be actually drawn on screen.
+			pressureRows.append(QVector<int>());
 			last_index = entry->cylinderindex;
 		}
 		if (!mbar) {
@@ -706,13 +764,17 @@ void DiveGasPressureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 			QPointF o2point(hAxis->posAtValue(entry->sec), vAxis->posAtValue(o2mbar));
 			boundingPoly.push_back(o2point);
 			polygons.first().push_back(o2point);
+			pressureRows.first().push_back(i);
 		}
 
 		QPointF point(hAxis->posAtValue(entry->sec), vAxis->posAtValue(mbar));
 		boundingPoly.push_back(point);    // The BoundingRect
 		polygons.last().push_back(point); // The polygon thta will be plotted.
+		pressureRows.last().push_back(i);
 	}
-	setPolygon(boundingPoly);
+	for (int i = 0; i < polygons.count(); i++)
+		polygons[i] = decimate(polygons[i], &pressureRows[i]);
+	setPolygon(decimate(boundingPoly));
 	qDeleteAll(texts);
 	texts.clear();
 	int mbar, cyl;
@@ -825,10 +887,10 @@ void DiveGasPressureItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
 	pen.setCosmetic(true);
 	pen.setWidth(2);
 	painter->save();
-	struct plot_data *entry;
-	Q_FOREACH (const QPolygonF &poly, polygons) {
-		entry = dataModel->data().entry;
-		for (int i = 1, count = poly.count(); i < count; i++, entry++) {
+	for (int p = 0; p < polygons.count(); p++) {
+		const QPolygonF &poly = polygons[p];
+		for (int i = 1, count = poly.count(); i < count; i++) {
+			struct plot_data *entry = dataModel->data().entry + pressureRows[p][i];
 			if (entry->sac)
 				pen.setBrush(getSacColor(entry->sac, displayed_dive.sac));
 			else
@@ -922,6 +984,7 @@ void DiveReportedCeiling::modelDataChanged(const QModelIndex &topLeft, const QMo
 			p.append(QPointF(hAxis->posAtValue(entry->sec), vAxis->posAtValue(0)));
 		}
 	}
+	p = decimate(p);
 	setPolygon(p);
 	QLinearGradient pat(0, p.boundingRect().top(), 0, p.boundingRect().bottom());
 	// does the user want the ceiling in "surface color" or in red?
@@ -991,7 +1054,9 @@ void PartialPressureGasItem::modelDataChanged(const QModelIndex &topLeft, const
 			inAlertFragment = false;
 		}
 	}
-	setPolygon(poly);
+	for (int i = 0; i < alertPolygons.count(); i++)
+		alertPolygons[i] = decimate(alertPolygons[i]);
+	setPolygon(decimate(poly));
 	/*
 	createPPLegend(trUtf8("pN" UTF8_SUBSCRIPT_2),getColor(PN2), legendPos);
 	*/
@@ -61,12 +61,20 @@ protected:
 	 */
 	bool shouldCalculateStuff(const QModelIndex &topLeft, const QModelIndex &bottomRight);
 
+	/* A long dive has many more samples than the profile has pixels. This keeps the first, last,
+	 * highest and lowest point of each pixel column of the view, which looks the same on screen.
+	 * If rows is given, it holds the model row of each point of poly and is cut down alongside.
+	 */
+	QPolygonF decimate(const QPolygonF &poly, QVector<int> *rows = NULL) const;
+	qreal pixelWidth() const;
+
 	DiveCartesianAxis *hAxis;
 	DiveCartesianAxis *vAxis;
 	DivePlotDataModel *dataModel;
 	int hDataColumn;
 	int vDataColumn;
 	QList<DiveTextItem *> texts;
+	QVector<int> polygonRows; // the model row of each point of the polygon
 };
 
 class DiveProfileItem : public AbstractProfilePolygonItem {
@@ -170,6 +178,7 @@ private:
 	void plotPressureValue(int mbar, int sec, QFlags<Qt::AlignmentFlag> align, double offset);
 	void plotGasValue(int mbar, int sec, struct gasmix gasmix, QFlags<Qt::AlignmentFlag> align, double offset);
 	QVector<QPolygonF> polygons;
+	QVector<QVector<int> > pressureRows; // the model rows of the points of each polygon
 };
 
 class DiveCalculatedCeiling : public AbstractProfilePolygonItem {
@@ -9,6 +9,9 @@
 #include <QGraphicsView>
 #include <QStyleOptionGraphicsItem>
 #include "core/qthelper.h"
+#ifndef SUBSURFACE_MOBILE
+#include "desktop-widgets/preferences/preferencesdialog.h"
+#endif
 
 void ToolTipItem::addToolTip(const QString &toolTip, const QIcon &icon, const QPixmap& pixmap)
 {
@@ -160,6 +163,9 @@ ToolTipItem::ToolTipItem(QGraphicsItem *parent) : QGraphicsRectItem(parent),
 
 	setPen(QPen(Qt::white, 2));
 	refreshTime.start();
+#ifndef SUBSURFACE_MOBILE
+	connect(PreferencesDialog::instance(), SIGNAL(settingsChanged()), this, SLOT(clearPlotStrings()));
+#endif
 }
 
 ToolTipItem::~ToolTipItem()
@@ -227,6 +233,13 @@ void ToolTipItem::readPos()
 void ToolTipItem::setPlotInfo(const plot_info &plot)
 {
 	pInfo = plot;
+	clearPlotStrings();
+}
+
+void ToolTipItem::clearPlotStrings()
+{
+	plotStrings.clear();
+	lastTime = -1;
 }
 
 void ToolTipItem::setTimeAxis(DiveCartesianAxis *axis)
@@ -252,8 +265,17 @@ void ToolTipItem::refresh(const QPointF &pos)
 	lastTime = time;
 	clear();
 
-	mb.len = 0;
-	entry = get_plot_details_new(&pInfo, time, &mb);
+	entry = get_plot_entry(&pInfo, time);
+	if (entry) {
+		int idx = entry - pInfo.entry;
+		if (plotStrings.size() != pInfo.nr)
+			plotStrings.resize(pInfo.nr);
+		if (plotStrings[idx].isNull()) {
+			mb.len = 0;
+			get_plot_entry_details(&pInfo, entry, &mb);
+			plotStrings[idx] = QString::fromUtf8(mb.buffer, mb.len);
+		}
+	}
 
 	tissues.fill();
 	painter.setPen(QColor(0, 0, 0, 0));
@@ -273,10 +295,13 @@ void ToolTipItem::refresh(const QPointF &pos)
 		painter.drawLine(0, 60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / entry->ambpressure / 2,
 				16, 60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / entry->ambpressure /2);
 		painter.setPen(QColor(0, 0, 0, 127));
-		for (int i=0; i<16; i++) {
-			painter.drawLine(i, 60, i, 60 - entry->percentages[i] / 2);
+		int *percentages = plot_tissue_percentages(&pInfo, entry - pInfo.entry);
+		if (percentages) {
+			for (int i=0; i<16; i++) {
+				painter.drawLine(i, 60, i, 60 - percentages[i] / 2);
+			}
 		}
-		entryToolTip.second->setText(QString::fromUtf8(mb.buffer, mb.len));
+		entryToolTip.second->setText(plotStrings[entry - pInfo.entry]);
 	}
 	entryToolTip.first->setPixmap(tissues);
 
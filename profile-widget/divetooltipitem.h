@@ -48,6 +48,7 @@ public:
 public
 slots:
 	void setRect(const QRectF &rect);
+	void clearPlotStrings();
 
 private:
 	typedef QPair<QGraphicsPixmapItem *, QGraphicsSimpleTextItem *> ToolTip;
@@ -59,6 +60,9 @@ private:
 	QRectF nextRectangle;
 	DiveCartesianAxis *timeAxis;
 	plot_info pInfo;
+	// the details of the plot entries that were shown already, by entry index;
+	// they depend on the units and preferences and on the deco of the entries
+	QVector<QString> plotStrings;
 	int lastTime;
 	QTime refreshTime;
 	QList<QGraphicsItem*> oldSelection;
@@ -20,6 +20,9 @@
 #include "desktop-widgets/simplewidgets.h"
 #include "desktop-widgets/divepicturewidget.h"
 #include "core/qthelper.h"
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QAtomicInt>
 #endif
 
 #include <libdivecomputer/parser.h>
@@ -43,6 +46,137 @@
 // a couple of helpers we need
 extern bool haveFilesOnCommandLine();
 
+#ifndef SUBSURFACE_MOBILE
+// What calculate_deco_information() needs to run on its own: nothing in here
+// is shared with the main thread, other than the cancel flag
+struct ProfileDecoJob {
+	struct dive *dive;		// a snapshot of the displayed dive
+	struct divecomputer *dc;	// the one that is shown, of that snapshot
+	struct deco_state ds;
+	struct plot_info pi;		// a copy of the profile
+	QByteArray cacheKey;		// where the result goes into the cache, if anywhere
+	QAtomicInt cancelled;
+	QFutureWatcher<void> *watcher;
+};
+
+// A profile including the deco, as it was shown before
+struct CachedPlotInfo {
+	struct plot_info pi;
+
+	~CachedPlotInfo()
+	{
+		free_plot_info_data(&pi);
+	}
+};
+
+static void *copyColumn(const void *column, size_t size)
+{
+	void *copy;
+
+	if (!column)
+		return NULL;
+	copy = malloc(size);
+	memcpy(copy, column, size);
+	return copy;
+}
+
+static struct plot_info copyPlotInfo(const struct plot_info *pi)
+{
+	struct plot_info copy = *pi;
+
+	copy.entry = (struct plot_data *)copyColumn(pi->entry, pi->nr * sizeof(struct plot_data));
+	copy.ceilings = (int *)copyColumn(pi->ceilings, pi->nr * 16 * sizeof(int));
+	copy.percentages = (int *)copyColumn(pi->percentages, pi->nr * 16 * sizeof(int));
+	copy.cancelled = NULL;
+	copy.cancel_data = NULL;
+	return copy;
+}
+
+// in kB, for the plot info cache
+static int plotInfoCost(const struct plot_info *pi)
+{
+	size_t size = pi->nr * sizeof(struct plot_data);
+
+	if (pi->ceilings)
+		size += pi->nr * 16 * sizeof(int);
+	if (pi->percentages)
+		size += pi->nr * 16 * sizeof(int);
+	return size / 1024 + 1;
+}
+
+/*
+ * Everything a profile with its deco depends on: the dive itself - its id and
+ * its cache_generation, which changes with any edit - and the tissues it starts
+ * with, which sum up the dives before it. Then the preferences
+ * create_plot_info_new() looks at.
+ */
+static QByteArray plotInfoCacheKey(const struct dive *dive, int dc, const struct deco_state *ds, unsigned int columns)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	unsigned int version[] = { (unsigned int)dive->id, dive->cache_generation };
+	int settings[] = {
+		dc, (int)columns, (int)ds->settings.deco_mode, ds->settings.in_planner, ds->settings.vpmb_conservatism, ds->settings.gf_low_at_maxdepth,
+		prefs.calcndltts, prefs.calcceiling3m, prefs.calcalltissues, prefs.decosac, prefs.bottomsac,
+		prefs.pp_graphs.po2, prefs.pp_graphs.pn2, prefs.pp_graphs.phe, prefs.mod, prefs.ead,
+		prefs.hrgraph, prefs.show_sac, prefs.zoomed_plot
+	};
+	double factors[] = { ds->settings.gf_low, ds->settings.gf_high, prefs.modpO2 };
+	// the deco state field by field, leaving out the factor cache, which is
+	// only there to speed things up
+	const double *tissues[] = {
+		ds->tissue_n2_sat, ds->tissue_he_sat, ds->tolerated_by_tissue, ds->tissue_inertgas_saturation,
+		ds->buehlmann_inertgas_a, ds->buehlmann_inertgas_b,
+		ds->max_n2_crushing_pressure, ds->max_he_crushing_pressure, ds->crushing_onset_tension,
+		ds->n2_regen_radius, ds->he_regen_radius,
+		ds->bottom_n2_gradient, ds->bottom_he_gradient, ds->initial_n2_gradient, ds->initial_he_gradient
+	};
+	double pressures[] = { ds->max_ambient_pressure, ds->gf_low_pressure_this_dive, ds->sumy, ds->sumxy };
+	int state[] = {
+		ds->first_ceiling_pressure.mbar, ds->max_bottom_ceiling_pressure.mbar, ds->ci_pointing_to_guiding_tissue,
+		ds->plot_depth, ds->sumx, ds->sum1
+	};
+	qint64 sumxx = ds->sumxx;
+
+	hash.addData((const char *)version, sizeof(version));
+	hash.addData((const char *)settings, sizeof(settings));
+	hash.addData((const char *)factors, sizeof(factors));
+	for (unsigned int i = 0; i < sizeof(tissues) / sizeof(tissues[0]); i++)
+		hash.addData((const char *)tissues[i], sizeof(ds->tissue_n2_sat));
+	hash.addData((const char *)pressures, sizeof(pressures));
+	hash.addData((const char *)state, sizeof(state));
+	hash.addData((const char *)&sumxx, sizeof(sumxx));
+	return hash.result();
+}
+
+// asked by calculate_deco_information() on the thread of the job
+static bool decoJobCancelled(void *data)
+{
+	return ((ProfileDecoJob *)data)->cancelled.loadAcquire();
+}
+
+static void calculateDeco(ProfileDecoJob *job)
+{
+	calculate_deco_information(&job->ds, NULL, job->dive, job->dc, &job->pi, false);
+}
+
+// all of create_plot_info_new(), after init_decompression()
+static void calculateProfile(ProfileDecoJob *&job)
+{
+	create_plot_info_without_deco(job->dive, job->dc, &job->pi, false);
+	calculateDeco(job);
+}
+
+static void freeDecoJob(ProfileDecoJob *job)
+{
+	free_plot_info_data(&job->pi);
+	clear_dive(job->dive);
+	free(job->dive);
+	if (job->watcher)
+		job->watcher->deleteLater();
+	delete job;
+}
+#endif
+
 /* This is the global 'Item position' variable.
  * it should tell you where to position things up
  * on the canvas.
@@ -131,6 +265,10 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 	isPlotZoomed = prefs.zoomed_plot; // now it seems that 'prefs' has loaded our preferences
 
 	memset(&plotInfo, 0, sizeof(plotInfo));
+#ifndef SUBSURFACE_MOBILE
+	plotInfoCache.setMaxCost(64 * 1024);
+	precalculatedDc = -1;
+#endif
 
 	setupSceneAndFlags();
 	setupItemSizes();
@@ -168,6 +306,15 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 
 ProfileWidget2::~ProfileWidget2()
 {
+#ifndef SUBSURFACE_MOBILE
+	cancelDecoCalculations();
+	Q_FOREACH (ProfileDecoJob *job, decoJobs) {
+		job->watcher->waitForFinished();
+		freeDecoJob(job);
+	}
+	clearPrecalculatedProfiles();
+#endif
+	free_plot_info_data(&plotInfo);
 	delete background;
 	delete profileYAxis;
 	delete gasYAxis;
@@ -266,6 +413,8 @@ void ProfileWidget2::setupItemOnScene()
 #ifndef SUBSURFACE_MOBILE
 	toolTipItem->setZValue(9998);
 	toolTipItem->setTimeAxis(timeAxis);
+	// the deco of the entries is filled in later, or recalculated
+	connect(dataModel, SIGNAL(dataChanged(QModelIndex, QModelIndex)), toolTipItem, SLOT(clearPlotStrings()));
 	rulerItem->setZValue(9997);
 #endif
 	tankItem->setZValue(100);
@@ -602,6 +751,12 @@ void ProfileWidget2::plotDive(struct dive *d, bool force)
 	// data that we have
 	struct divecomputer *currentdc = select_dc(&displayed_dive);
 	Q_ASSERT(currentdc);
+#ifndef SUBSURFACE_MOBILE
+	// The deco calculations can take a while. When just looking at a logged
+	// dive, show its profile right away and add them when they are done
+	cancelDecoCalculations();
+	bool decoLater = currentdc && currentdc->samples && !printMode && currentState != ADD && currentState != PLAN;
+#endif
 	if (!currentdc || !currentdc->samples) {
 		currentdc = fake_dc(currentdc, false);
 	}
@@ -622,8 +777,41 @@ void ProfileWidget2::plotDive(struct dive *d, bool force)
 	 * so I'll *not* calculate everything if something is not being
 	 * shown.
 	 */
+	free_plot_info_data(&plotInfo);
 	plotInfo = calculate_max_limits_new(&displayed_dive, currentdc);
-	create_plot_info_new(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth);
+#ifndef SUBSURFACE_MOBILE
+	plotInfo.columns = plotColumns();
+#endif
+#ifndef SUBSURFACE_MOBILE
+	// flipping between the same few dives shouldn't redo their deco every time
+	struct deco_state decoStart;
+	QByteArray cacheKey;
+	CachedPlotInfo *cached = NULL, *precalculated = NULL;
+	if (currentState != ADD && currentState != PLAN && dc_number == precalculatedDc)
+		precalculated = precalculatedProfiles.take(d->id);
+	if (precalculated) {
+		plotInfo = precalculated->pi;
+		memset(&precalculated->pi, 0, sizeof(precalculated->pi));
+		delete precalculated;
+		decoLater = false;
+	} else if (decoLater) {
+		// this goes through the dives before the displayed one and may update
+		// their tissue checkpoints, so it has to happen on this thread
+		init_decompression(&decoStart, &displayed_dive, NULL);
+		// displayed_dive is a copy, with a cache generation of its own
+		cacheKey = plotInfoCacheKey(d, dc_number, &decoStart, plotInfo.columns);
+		cached = plotInfoCache.object(cacheKey);
+	}
+	if (precalculated) {
+		// done already
+	} else if (cached) {
+		plotInfo = copyPlotInfo(&cached->pi);
+		decoLater = false;
+	} else if (decoLater)
+		create_plot_info_without_deco(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth);
+	else
+#endif
+		create_plot_info_new(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth, DivePlannerPointsModel::instance()->getDecoState());
 	if (shouldCalculateMaxTime)
 		maxtime = get_maxtime(&plotInfo);
 
@@ -744,6 +932,10 @@ void ProfileWidget2::plotDive(struct dive *d, bool force)
 	}
 #endif
 	plotPictures();
+#ifndef SUBSURFACE_MOBILE
+	if (decoLater)
+		startDecoCalculation(&decoStart, cacheKey);
+#endif
 
 	// OK, how long did this take us? Anything above the second is way too long,
 	// so if we are calculation TTS / NDL then let's force that off.
@@ -756,9 +948,133 @@ void ProfileWidget2::plotDive(struct dive *d, bool force)
 	emit showError();
 }
 
+#ifndef SUBSURFACE_MOBILE
+// the tool tip shows the tissue percentages, the ceilings of all tissues
+// are only drawn on request and checked against a plan
+unsigned int ProfileWidget2::plotColumns()
+{
+	unsigned int columns = PLOT_TISSUE_PERCENTAGES;
+
+	if (prefs.calcalltissues || currentState == PLAN)
+		columns |= PLOT_TISSUE_CEILINGS;
+	return columns;
+}
+
+void ProfileWidget2::precalculateProfiles(const QVector<struct dive *> &dives)
+{
+	QList<ProfileDecoJob *> jobs;
+	QSet<int> seen;
+
+	clearPrecalculatedProfiles();
+	precalculatedDc = dc_number;
+	Q_FOREACH (struct dive *dive, dives) {
+		// the ones without samples are quick, plotDive() makes them up
+		if (!dive || seen.contains(dive->id))
+			continue;
+		seen.insert(dive->id);
+		ProfileDecoJob *job = new ProfileDecoJob;
+		job->dive = alloc_dive();
+		// as plotDive() does it, on a copy and with the dive computer shown
+		copy_dive(dive, job->dive);
+		job->dc = select_dc(job->dive);
+		if (!job->dc || !job->dc->samples) {
+			clear_dive(job->dive);
+			free(job->dive);
+			delete job;
+			continue;
+		}
+		// this updates the tissue checkpoints of the dives before, so not in parallel
+		init_decompression(&job->ds, job->dive, NULL);
+		job->pi = calculate_max_limits_new(job->dive, job->dc);
+		job->pi.columns = plotColumns();
+		job->cancelled.storeRelease(0);
+		job->watcher = NULL;
+		jobs.append(job);
+	}
+	QtConcurrent::blockingMap(jobs, calculateProfile);
+	for (int i = 0; i < jobs.count(); i++) {
+		CachedPlotInfo *profile = new CachedPlotInfo;
+		profile->pi = jobs[i]->pi;
+		memset(&jobs[i]->pi, 0, sizeof(jobs[i]->pi));
+		precalculatedProfiles.insert(jobs[i]->dive->id, profile);
+		freeDecoJob(jobs[i]);
+	}
+}
+
+void ProfileWidget2::clearPrecalculatedProfiles()
+{
+	qDeleteAll(precalculatedProfiles);
+	precalculatedProfiles.clear();
+	precalculatedDc = -1;
+}
+
+void ProfileWidget2::startDecoCalculation(struct deco_state *ds, const QByteArray &cacheKey)
+{
+	ProfileDecoJob *job = new ProfileDecoJob;
+
+	job->dive = alloc_dive();
+	copy_dive(&displayed_dive, job->dive);
+	job->dc = get_dive_dc(job->dive, dc_number);
+	job->ds = *ds;
+	job->pi = copyPlotInfo(&plotInfo);
+	job->cacheKey = cacheKey;
+	job->cancelled.storeRelease(0);
+	job->pi.cancelled = decoJobCancelled;
+	job->pi.cancel_data = job;
+	job->watcher = new QFutureWatcher<void>(this);
+	decoJobs.append(job);
+	connect(job->watcher, SIGNAL(finished()), this, SLOT(decoCalculated()));
+	job->watcher->setFuture(QtConcurrent::run(calculateDeco, job));
+}
+
+// The jobs notice this within a sample or two - they are deleted once they have
+void ProfileWidget2::cancelDecoCalculations()
+{
+	Q_FOREACH (ProfileDecoJob *job, decoJobs)
+		job->cancelled.storeRelease(1);
+}
+
+void ProfileWidget2::decoCalculated()
+{
+	ProfileDecoJob *job = NULL;
+
+	Q_FOREACH (ProfileDecoJob *j, decoJobs) {
+		if (j->watcher == sender())
+			job = j;
+	}
+	if (!job)
+		return;
+	decoJobs.removeOne(job);
+	// The profile hasn't changed since the job started, otherwise it would have
+	// been cancelled. Everybody holds on to these arrays, so fill in place
+	if (!job->cancelled.loadAcquire() && job->pi.nr == plotInfo.nr) {
+		memcpy(plotInfo.entry, job->pi.entry, plotInfo.nr * sizeof(struct plot_data));
+		if (plotInfo.ceilings)
+			memcpy(plotInfo.ceilings, job->pi.ceilings, plotInfo.nr * 16 * sizeof(int));
+		if (plotInfo.percentages)
+			memcpy(plotInfo.percentages, job->pi.percentages, plotInfo.nr * 16 * sizeof(int));
+		// the tool tip texts of the entries still show them without the deco
+		toolTipItem->clearPlotStrings();
+		dataModel->emitDataChanged();
+	}
+	// a cancelled job may have stopped half way
+	if (!job->cancelled.loadAcquire() && !job->cacheKey.isEmpty()) {
+		CachedPlotInfo *cached = new CachedPlotInfo;
+		cached->pi = job->pi;
+		cached->pi.cancelled = NULL;
+		cached->pi.cancel_data = NULL;
+		memset(&job->pi, 0, sizeof(job->pi));
+		plotInfoCache.insert(job->cacheKey, cached, plotInfoCost(&cached->pi));
+	}
+	freeDecoJob(job);
+}
+#endif
+
 void ProfileWidget2::recalcCeiling()
 {
 #ifndef SUBSURFACE_MOBILE
+	// that's done right here, anything still on its way would be outdated
+	cancelDecoCalculations();
 	diveCeiling->recalc();
 #endif
 }
@@ -848,6 +1164,16 @@ void ProfileWidget2::resizeEvent(QResizeEvent *event)
 	QGraphicsView::resizeEvent(event);
 	fitInView(sceneRect(), Qt::IgnoreAspectRatio);
 	fixBackgroundPos();
+	pixelSizeChanged();
+}
+
+// The profile items only keep as many points as there are pixels, a new
+// window size or zoom level needs a new set
+void ProfileWidget2::pixelSizeChanged()
+{
+	if (printMode || !dataModel->rowCount())
+		return;
+	dataModel->emitDataChanged();
 }
 
 #ifndef SUBSURFACE_MOBILE
@@ -865,6 +1191,8 @@ void ProfileWidget2::divePlannerHandlerClicked()
 	if (zoomLevel)
 		return;
 	shouldCalculateMaxDepth = false;
+	// the plan can't keep up with the mouse
+	DivePlannerPointsModel::instance()->setPlanInBackground(true);
 	replot();
 }
 
@@ -873,6 +1201,7 @@ void ProfileWidget2::divePlannerHandlerReleased()
 	if (zoomLevel)
 		return;
 	shouldCalculateMaxDepth = true;
+	DivePlannerPointsModel::instance()->setPlanInBackground(false);
 	replot();
 }
 
@@ -917,6 +1246,7 @@ void ProfileWidget2::wheelEvent(QWheelEvent *event)
 		scale(1.0 / zoomFactor, 1.0 / zoomFactor);
 		zoomLevel--;
 	}
+	pixelSizeChanged();
 	scrollViewTo(event->pos());
 	toolTipItem->setPos(mapToScene(toolTipPos));
 }
@@ -1293,14 +1623,8 @@ struct plot_data *ProfileWidget2::getEntryFromPos(QPointF pos)
 {
 	// find the time stamp corresponding to the mouse position
 	int seconds = timeAxis->valueAt(pos);
-	struct plot_data *entry = NULL;
 
-	for (int i = 0; i < plotInfo.nr; i++) {
-		entry = plotInfo.entry + i;
-		if ((int)entry->sec >= seconds)
-			break;
-	}
-	return entry;
+	return get_plot_entry(&plotInfo, seconds);
 }
 
 void ProfileWidget2::setReplot(bool state)
@@ -2,6 +2,7 @@
 #define PROFILEWIDGET2_H
 
 #include <QGraphicsView>
+#include <QCache>
 
 // /* The idea of this widget is to display and edit the profile.
 //  * It has:
@@ -47,6 +48,9 @@ class DiveHandler;
 class QGraphicsSimpleTextItem;
 class QModelIndex;
 class DivePictureItem;
+struct ProfileDecoJob;
+struct CachedPlotInfo;
+struct deco_state;
 
 class ProfileWidget2 : public QGraphicsView {
 	Q_OBJECT
@@ -83,6 +87,10 @@ public:
 #ifndef SUBSURFACE_MOBILE
 	virtual bool eventFilter(QObject *, QEvent *) override;
 	void clearHandlers();
+	// for printing and exporting: the profiles of these dives are calculated
+	// at once, on all cores, and plotDive() picks them up from there
+	void precalculateProfiles(const QVector<struct dive *> &dives);
+	void clearPrecalculatedProfiles();
 #endif
 	void recalcCeiling();
 	void setToolTipVisibile(bool visible);
@@ -137,6 +145,8 @@ slots: // Necessary to call from QAction's signals.
 
 	void divePlannerHandlerClicked();
 	void divePlannerHandlerReleased();
+
+	void decoCalculated();
 #endif
 
 protected:
@@ -157,6 +167,7 @@ protected:
 
 private: /*methods*/
 	void fixBackgroundPos();
+	void pixelSizeChanged();
 	void scrollViewTo(const QPoint &pos);
 	void setupSceneAndFlags();
 	void setupItemSizes();
@@ -164,6 +175,11 @@ private: /*methods*/
 	void setupItemOnScene();
 	void disconnectTemporaryConnections();
 	struct plot_data *getEntryFromPos(QPointF pos);
+#ifndef SUBSURFACE_MOBILE
+	void startDecoCalculation(struct deco_state *ds, const QByteArray &cacheKey);
+	void cancelDecoCalculations();
+	unsigned int plotColumns();
+#endif
 
 private:
 	DivePlotDataModel *dataModel;
@@ -212,6 +228,13 @@ private:
 	DiveLineItem *mouseFollowerVertical;
 	DiveLineItem *mouseFollowerHorizontal;
 	RulerItem2 *rulerItem;
+	// the deco calculations on other threads - only the last one can be for the current profile
+	QList<ProfileDecoJob *> decoJobs;
+	// the profiles of the dives shown last, with their deco - the cost is in kB
+	QCache<QByteArray, CachedPlotInfo> plotInfoCache;
+	// by dive id, all for the same dive computer number
+	QHash<int, CachedPlotInfo *> precalculatedProfiles;
+	int precalculatedDc;
 #endif
 	TankItem *tankItem;
 	bool isGrayscale;
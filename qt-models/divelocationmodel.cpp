@@ -126,6 +126,7 @@ void LocationInformationModel::update()
 	beginResetModel();
 	internalRowCount = dive_site_table.nr;
 	qSort(dive_site_table.dive_sites, dive_site_table.dive_sites + dive_site_table.nr, dive_site_less_than);
+	update_dive_site_index();
 	endResetModel();
 }
 
@@ -138,6 +139,7 @@ uint32_t LocationInformationModel::addDiveSite(const QString& name, timestamp_t
 	beginInsertRows(QModelIndex(), dive_site_table.nr + 2, dive_site_table.nr + 2);
 	uint32_t uuid = create_dive_site_with_gps(name.toUtf8().data(), latitude, longitude, divetime);
 	qSort(dive_site_table.dive_sites, dive_site_table.dive_sites + dive_site_table.nr, dive_site_less_than);
+	update_dive_site_index();
 	internalRowCount = dive_site_table.nr;
 	endInsertRows();
 	return uuid;
@@ -7,6 +7,8 @@
 #include "core/device.h"
 #include "core/subsurface-qt/SettingsObjectWrapper.h"
 
+#include <QtConcurrent>
+
 /* TODO: Port this to CleanerTableModel to remove a bit of boilerplate and
  * use the signal warningMessage() to communicate errors to the MainWindow.
  */
@@ -354,14 +356,33 @@ int DivePlannerPointsModel::rowCount(const QModelIndex &parent) const
 	return divepoints.count();
 }
 
+// A plan calculated on another thread, on copies of the plan and the dive
+struct BackgroundPlan {
+	int generation;
+	bool isPlanner;
+	struct diveplan diveplan;
+	struct dive dive;
+	struct deco_state ds;
+	struct deco_settings settings; // taken on the main thread, with the deco mode
+	char *cache;
+	int error;
+};
+
 DivePlannerPointsModel::DivePlannerPointsModel(QObject *parent) : QAbstractTableModel(parent),
 	mode(NOTHING),
 	recalc(false),
 	tempGFHigh(100),
-	tempGFLow(100)
+	tempGFLow(100),
+	planInBackground(false),
+	planGeneration(0),
+	runningPlan(NULL),
+	finishedPlan(NULL)
 {
 	memset(&diveplan, 0, sizeof(diveplan));
+	memset(&decoState, 0, sizeof(decoState));
+	memset(&checkpoints, 0, sizeof(checkpoints));
 	startTime.setTimeSpec(Qt::UTC);
+	connect(&planWatcher, SIGNAL(finished()), this, SLOT(backgroundPlanFinished()));
 }
 
 DivePlannerPointsModel *DivePlannerPointsModel::instance()
@@ -658,6 +679,7 @@ void DivePlannerPointsModel::editStop(int row, divedatapoint newData)
 	if (row >= divepoints.count())
 		return;
 	divepoints[row] = newData;
+	planGeneration++;
 	std::sort(divepoints.begin(), divepoints.end(), divePointsLessThan);
 	if (updateMaxDepth())
 		CylindersModel::instance()->updateBestMixes();
@@ -714,6 +736,11 @@ struct diveplan &DivePlannerPointsModel::getDiveplan()
 	return diveplan;
 }
 
+struct deco_state *DivePlannerPointsModel::getDecoState()
+{
+	return &decoState;
+}
+
 void DivePlannerPointsModel::cancelPlan()
 {
 	/* TODO:
@@ -734,6 +761,8 @@ void DivePlannerPointsModel::cancelPlan()
 
 	setPlanMode(NOTHING);
 	free_dps(&diveplan);
+	setPlanInBackground(false);
+	free_plan_checkpoints(&checkpoints);
 
 	emit planCanceled();
 }
@@ -808,9 +837,21 @@ void DivePlannerPointsModel::createTemporaryPlan()
 #if DEBUG_PLAN
 	dump_plan(&diveplan);
 #endif
+	// with the waypoints that didn't change, the planner doesn't go through the dive again
+	diveplan.checkpoints = &checkpoints;
 	if (recalcQ() && !diveplan_empty(&diveplan)) {
-		plan(&diveplan, &cache, isPlanner(), false);
-		emit calculatedPlanNotes();
+		// the profile shows the plan with its own GF and conservatism
+		set_gf(diveplan.gflow, diveplan.gfhigh, prefs.gf_low_at_maxdepth);
+		set_vpmb_conservatism(diveplan.vpmb_conservatism);
+		if (!planInBackground) {
+			plan(&decoState, &diveplan, &displayed_dive, &cache, isPlanner(), false);
+			emit calculatedPlanNotes();
+		} else if (takeBackgroundPlan()) {
+			emit calculatedPlanNotes();
+		} else {
+			// until it's done, the profile keeps showing the previous plan
+			startBackgroundPlan();
+		}
 	}
 	// throw away the cache
 	free(cache);
@@ -820,6 +861,152 @@ void DivePlannerPointsModel::createTemporaryPlan()
 #endif
 }
 
+/*
+ * Dragging a waypoint changes the plan with every mouse move, faster than
+ * deep plans can be calculated. So then they are calculated on another
+ * thread: one at a time, for the waypoints as they are when it starts.
+ * When it's done and the waypoints have changed in the meantime, it's
+ * thrown away and the next one starts; otherwise the profile picks it up
+ * when it asks for the plan again.
+ */
+void DivePlannerPointsModel::setPlanInBackground(bool background)
+{
+	if (background == planInBackground)
+		return;
+	planInBackground = background;
+	planGeneration++;
+	if (!background) {
+		// it's outdated, and the next plan uses the same checkpoints
+		if (runningPlan) {
+			planWatcher.waitForFinished();
+			freeBackgroundPlan(runningPlan);
+			runningPlan = NULL;
+		}
+		freeBackgroundPlan(finishedPlan);
+		finishedPlan = NULL;
+	}
+}
+
+static void calculateBackgroundPlan(BackgroundPlan *job)
+{
+	calculate_plan(&job->ds, &job->diveplan, &job->dive, &job->cache, job->isPlanner, &job->settings, &job->error);
+}
+
+void DivePlannerPointsModel::startBackgroundPlan()
+{
+	if (runningPlan)
+		return;
+	BackgroundPlan *job = new BackgroundPlan;
+	struct divedatapoint **lastdp = &job->diveplan.dp;
+
+	job->generation = planGeneration;
+	job->isPlanner = isPlanner();
+	job->diveplan = diveplan;
+	job->diveplan.dp = NULL;
+	for (struct divedatapoint *dp = diveplan.dp; dp; dp = dp->next) {
+		*lastdp = create_dp(dp->time, dp->depth, dp->cylinderid, dp->setpoint);
+		(*lastdp)->entered = dp->entered;
+		lastdp = &(*lastdp)->next;
+	}
+	memset(&job->dive, 0, sizeof(job->dive));
+	copy_dive(&displayed_dive, &job->dive);
+	memset(&job->ds, 0, sizeof(job->ds));
+	job->cache = NULL;
+	job->error = 0;
+	prepare_plan_sweep(&displayed_dive, &job->settings);
+	runningPlan = job;
+	planWatcher.setFuture(QtConcurrent::run(calculateBackgroundPlan, job));
+}
+
+void DivePlannerPointsModel::backgroundPlanFinished()
+{
+	// a signal of a job that was waited for already
+	if (!runningPlan || !planWatcher.isFinished())
+		return;
+	BackgroundPlan *job = runningPlan;
+	runningPlan = NULL;
+	if (job->generation == planGeneration) {
+		freeBackgroundPlan(finishedPlan);
+		finishedPlan = job;
+	} else {
+		freeBackgroundPlan(job);
+	}
+	// the profile picks it up, or starts over with the current waypoints
+	emitDataChanged();
+}
+
+// the plan calculated for the current waypoints, if there is one
+bool DivePlannerPointsModel::takeBackgroundPlan()
+{
+	if (!finishedPlan || finishedPlan->generation != planGeneration)
+		return false;
+	BackgroundPlan *job = finishedPlan;
+	finishedPlan = NULL;
+
+	free_dps(&diveplan);
+	diveplan = job->diveplan;
+	job->diveplan.dp = NULL;
+	copy_dive(&job->dive, &displayed_dive);
+	decoState = job->ds;
+	finish_plan(&diveplan, &displayed_dive, job->isPlanner, false, job->error);
+	freeBackgroundPlan(job);
+	return true;
+}
+
+void DivePlannerPointsModel::freeBackgroundPlan(BackgroundPlan *job)
+{
+	if (!job)
+		return;
+	free_dps(&job->diveplan);
+	clear_dive(&job->dive);
+	free(job->cache);
+	delete job;
+}
+
+// plans one cell of a sweep, with what the sweep started from
+struct CalculateSweepCell {
+	CalculateSweepCell(const struct diveplan *base, struct dive *dive, const struct deco_settings &settings) :
+		base(base),
+		dive(dive),
+		settings(settings)
+	{
+	}
+	void operator()(struct plan_sweep_cell &cell) const
+	{
+		plan_sweep_cell(base, dive, &settings, &cell);
+	}
+	const struct diveplan *base;
+	struct dive *dive;
+	struct deco_settings settings;
+};
+
+/* Calculate every combination of the given gradient factors (-1/-1 for those of the
+ * plan), bottom time and depth changes of the current plan, on as many threads as
+ * we have. Each of them works on its own copy of the planned dive. */
+QVector<struct plan_sweep_cell> DivePlannerPointsModel::sweepPlan(const QVector<QPair<int, int> > &gfs, const QVector<int> &bottomTimeDeltas, const QVector<int> &depthDeltas)
+{
+	QVector<struct plan_sweep_cell> cells;
+
+	if (diveplan_empty(&diveplan))
+		return cells;
+	for (int i = 0; i < gfs.count(); i++) {
+		Q_FOREACH (int depthDelta, depthDeltas) {
+			Q_FOREACH (int bottomTimeDelta, bottomTimeDeltas) {
+				struct plan_sweep_cell cell = {};
+				cell.gflow = gfs[i].first;
+				cell.gfhigh = gfs[i].second;
+				cell.depth_delta = depthDelta;
+				cell.bottom_time_delta = bottomTimeDelta;
+				cells.append(cell);
+			}
+		}
+	}
+	struct deco_settings settings;
+	prepare_plan_sweep(&displayed_dive, &settings);
+	QtConcurrent::blockingMap(cells, CalculateSweepCell(&diveplan, &displayed_dive, settings));
+	return cells;
+}
+
 void DivePlannerPointsModel::deleteTemporaryPlan()
 {
 	free_dps(&diveplan);
@@ -845,7 +1032,7 @@ void DivePlannerPointsModel::createPlan(bool replanCopy)
 	setRecalc(oldRecalc);
 
 	//TODO: C-based function here?
-	bool did_deco = plan(&diveplan, &cache, isPlanner(), true);
+	bool did_deco = plan(&decoState, &diveplan, &displayed_dive, &cache, isPlanner(), true);
 	free(cache);
 	if (!current_dive || displayed_dive.id != current_dive->id) {
 		// we were planning a new dive, not re-planning an existing on
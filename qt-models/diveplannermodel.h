@@ -3,8 +3,15 @@
 
 #include <QAbstractTableModel>
 #include <QDateTime>
+#include <QFutureWatcher>
+#include <QPair>
+#include <QVector>
 
 #include "core/dive.h"
+#include "core/deco.h"
+#include "core/planner.h"
+
+struct BackgroundPlan;
 
 class DivePlannerPointsModel : public QAbstractTableModel {
 	Q_OBJECT
@@ -50,9 +57,13 @@ public:
 	divedatapoint at(int row);
 	int size();
 	struct diveplan &getDiveplan();
+	struct deco_state *getDecoState();
 	QStringList &getGasList();
 	int lastEnteredPoint();
 	void removeDeco();
+	QVector<struct plan_sweep_cell> sweepPlan(const QVector<QPair<int, int> > &gfs, const QVector<int> &bottomTimeDeltas, const QVector<int> &depthDeltas);
+	// while a waypoint is dragged around, see createTemporaryPlan()
+	void setPlanInBackground(bool background);
 	static bool addingDeco;
 
 public
@@ -100,16 +111,30 @@ signals:
 	void recreationChanged(bool);
 	void calculatedPlanNotes();
 
+private
+slots:
+	void backgroundPlanFinished();
+
 private:
 	explicit DivePlannerPointsModel(QObject *parent = 0);
 	void createPlan(bool replanCopy);
+	void startBackgroundPlan();
+	bool takeBackgroundPlan();
+	void freeBackgroundPlan(BackgroundPlan *job);
 	struct diveplan diveplan;
+	struct deco_state decoState;
 	Mode mode;
 	bool recalc;
 	QVector<divedatapoint> divepoints;
 	QDateTime startTime;
 	int tempGFHigh;
 	int tempGFLow;
+	struct plan_checkpoints checkpoints;
+	bool planInBackground;
+	int planGeneration; // counts the changes of the waypoints while planning in the background
+	BackgroundPlan *runningPlan; // calculating
+	BackgroundPlan *finishedPlan; // for planGeneration, but not shown yet
+	QFutureWatcher<void> planWatcher;
 };
 
 #endif
@@ -2,6 +2,8 @@
 #include "core/dive.h"
 #include "core/profile.h"
 #include "core/divelist.h"
+#include "core/deco.h"
+#include "qt-models/diveplannermodel.h"
 #include "core/color.h"
 
 DivePlotDataModel::DivePlotDataModel(QObject *parent) :
@@ -74,11 +76,13 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= TISSUE_1 && index.column() <= TISSUE_16) {
-		return item.ceilings[index.column() - TISSUE_1];
+		int *ceilings = plot_tissue_ceilings(&pInfo, index.row());
+		return ceilings ? ceilings[index.column() - TISSUE_1] : 0;
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= PERCENTAGE_1 && index.column() <= PERCENTAGE_16) {
-		return item.percentages[index.column() - PERCENTAGE_1];
+		int *percentages = plot_tissue_percentages(&pInfo, index.row());
+		return percentages ? percentages[index.column() - PERCENTAGE_1] : 0;
 	}
 
 	if (role == Qt::BackgroundRole) {
@@ -234,8 +238,9 @@ void DivePlotDataModel::emitDataChanged()
 void DivePlotDataModel::calculateDecompression()
 {
 	struct divecomputer *dc = select_dc(&displayed_dive);
-	init_decompression(&displayed_dive);
-	calculate_deco_information(&displayed_dive, dc, &pInfo, false);
+	struct deco_state plot_deco_state;
+	init_decompression(&plot_deco_state, &displayed_dive, NULL);
+	calculate_deco_information(&plot_deco_state, DivePlannerPointsModel::instance()->getDecoState(), &displayed_dive, dc, &pInfo, false);
 	dataChanged(index(0, CEILING), index(pInfo.nr - 1, TISSUE_16));
 }
 #endif
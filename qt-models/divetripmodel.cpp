@@ -3,7 +3,10 @@
 #include "core/metrics.h"
 #include "core/divelist.h"
 #include "core/helpers.h"
+#include "core/qthelper.h"
+#include "core/deco-analysis.h"
 #include <QIcon>
+#include <QtConcurrent>
 
 static int nitrox_sort_value(struct dive *dive)
 {
@@ -12,6 +15,14 @@ static int nitrox_sort_value(struct dive *dive)
 	return he * 1000 + o2;
 }
 
+// the deco preview of a dive, if there is one for the current deco model
+static const struct deco_preview *shown_deco_preview(struct dive *dive)
+{
+	if (!dive->deco_preview.valid || decoMode() == VPMB)
+		return NULL;
+	return &dive->deco_preview;
+}
+
 static QVariant dive_table_alignment(int column)
 {
 	QVariant retVal;
@@ -23,6 +34,9 @@ static QVariant dive_table_alignment(int column)
 	case DiveTripModel::SAC:
 	case DiveTripModel::OTU:
 	case DiveTripModel::MAXCNS:
+	case DiveTripModel::MAXCEILING:
+	case DiveTripModel::SURFACEGF:
+	case DiveTripModel::DECOTIME:
 		// Right align numeric columns
 		retVal = int(Qt::AlignRight | Qt::AlignVCenter);
 		break;
@@ -138,6 +152,15 @@ QVariant DiveItem::data(int column, int role) const
 		case LOCATION:
 			retVal = QString(get_dive_location(dive));
 			break;
+		case MAXCEILING:
+			retVal = shown_deco_preview(dive) ? dive->deco_preview.max_ceiling : -1;
+			break;
+		case SURFACEGF:
+			retVal = shown_deco_preview(dive) ? dive->deco_preview.surface_gf : -1;
+			break;
+		case DECOTIME:
+			retVal = shown_deco_preview(dive) ? dive->deco_preview.deco_time : -1;
+			break;
 		}
 		break;
 	case Qt::DisplayRole:
@@ -181,6 +204,17 @@ QVariant DiveItem::data(int column, int role) const
 		case LOCATION:
 			retVal = QString(get_dive_location(dive));
 			break;
+		case MAXCEILING:
+			if (shown_deco_preview(dive))
+				retVal = get_depth_string(dive->deco_preview.max_ceiling);
+			break;
+		case SURFACEGF:
+			if (shown_deco_preview(dive))
+				retVal = dive->deco_preview.surface_gf;
+			break;
+		case DECOTIME:
+			retVal = displayDecoTime();
+			break;
 		case GAS:
 			const char *gas_string = get_dive_gas_string(dive);
 			retVal = QString(gas_string);
@@ -254,6 +288,15 @@ QVariant DiveItem::data(int column, int role) const
 		case LOCATION:
 			retVal = tr("Location");
 			break;
+		case MAXCEILING:
+			retVal = tr("Max. ceiling(%1), estimated").arg((get_units()->length == units::METERS) ? tr("m") : tr("ft"));
+			break;
+		case SURFACEGF:
+			retVal = tr("GF when surfacing(%), estimated");
+			break;
+		case DECOTIME:
+			retVal = tr("Time with a ceiling, estimated");
+			break;
 		}
 		break;
 	}
@@ -385,6 +428,18 @@ QString DiveItem::displaySac() const
 	return QString("");
 }
 
+QString DiveItem::displayDecoTime() const
+{
+	struct dive *dive = get_dive_by_uniq_id(diveId);
+	const struct deco_preview *preview = shown_deco_preview(dive);
+	if (!preview)
+		return QString("");
+	int mins = (preview->deco_time + 59) / 60;
+	if (mins >= 60)
+		return QString("%1:%2").arg(mins / 60).arg(mins % 60, 2, 10, QChar('0'));
+	return QString("%1").arg(mins);
+}
+
 QString DiveItem::displayWeight() const
 {
 	QString str = weight_string(weight());
@@ -403,6 +458,7 @@ DiveTripModel::DiveTripModel(QObject *parent) :
 	currentLayout(TREE)
 {
 	columns = COLUMNS;
+	connect(DecoPreviews::instance(), SIGNAL(previewsChanged()), this, SLOT(decoPreviewsChanged()));
 }
 
 Qt::ItemFlags DiveTripModel::flags(const QModelIndex &index) const
@@ -474,6 +530,15 @@ QVariant DiveTripModel::headerData(int section, Qt::Orientation orientation, int
 		case LOCATION:
 			ret = tr("Location");
 			break;
+		case MAXCEILING:
+			ret = tr("Ceiling");
+			break;
+		case SURFACEGF:
+			ret = tr("Surf. GF");
+			break;
+		case DECOTIME:
+			ret = tr("Deco");
+			break;
 		}
 		break;
 	case Qt::ToolTipRole:
@@ -525,6 +590,15 @@ QVariant DiveTripModel::headerData(int section, Qt::Orientation orientation, int
 		case LOCATION:
 			ret = tr("Location");
 			break;
+		case MAXCEILING:
+			ret = tr("Max. ceiling(%1), estimated").arg((get_units()->length == units::METERS) ? tr("m") : tr("ft"));
+			break;
+		case SURFACEGF:
+			ret = tr("GF when surfacing(%), estimated");
+			break;
+		case DECOTIME:
+			ret = tr("Time with a ceiling, estimated");
+			break;
 		}
 		break;
 	}
@@ -544,9 +618,10 @@ void DiveTripModel::setupModelData()
 	if (autogroup)
 		autogroup_dives();
 	dive_table.preexisting = dive_table.nr;
+	// only recalculates what changed since the last time
+	update_all_cylinder_related_info();
 	while (--i >= 0) {
 		struct dive *dive = get_dive(i);
-		update_cylinder_related_info(dive);
 		dive_trip_t *trip = dive->divetrip;
 
 		DiveItem *diveItem = new DiveItem();
@@ -577,6 +652,22 @@ void DiveTripModel::setupModelData()
 		beginInsertRows(QModelIndex(), 0, rowCount() - 1);
 		endInsertRows();
 	}
+	DecoPreviews::instance()->update();
+}
+
+void DiveTripModel::decoPreviewsChanged()
+{
+	int rows = rowCount();
+
+	if (!rows)
+		return;
+	emit dataChanged(index(0, MAXCEILING), index(rows - 1, DECOTIME));
+	for (int i = 0; i < rows; i++) {
+		QModelIndex parent = index(i, 0);
+		int children = rowCount(parent);
+		if (children)
+			emit dataChanged(index(0, MAXCEILING, parent), index(children - 1, DECOTIME, parent));
+	}
 }
 
 DiveTripModel::Layout DiveTripModel::layout() const
@@ -598,3 +689,104 @@ bool DiveTripModel::setData(const QModelIndex &index, const QVariant &value, int
 		return false;
 	return diveItem->setData(index, value, role);
 }
+
+// Copies of the dives whose deco previews are out of date, each series
+// (see deco_series_end()) from its first dive on
+struct DecoPreviewJob {
+	QVector<int> indices;
+	QVector<struct dive *> dives;
+	QVector<bool> seriesStart;
+	QVector<struct deco_preview> previews;
+};
+
+static void calculateDecoPreviews(DecoPreviewJob *job)
+{
+	struct deco_state ds;
+	timestamp_t lasttime = 0;
+
+	for (int i = 0; i < job->dives.count(); i++) {
+		if (job->seriesStart[i])
+			lasttime = 0;
+		preview_dive_deco(&ds, &lasttime, job->dives[i], &job->previews[i]);
+	}
+}
+
+DecoPreviews::DecoPreviews() :
+	job(NULL),
+	updateAgain(false)
+{
+	connect(&watcher, SIGNAL(finished()), this, SLOT(previewsCalculated()));
+}
+
+DecoPreviews *DecoPreviews::instance()
+{
+	static QScopedPointer<DecoPreviews> self(new DecoPreviews());
+	return self.data();
+}
+
+void DecoPreviews::update()
+{
+	struct deco_settings settings;
+	int start, end, i;
+
+	if (job) {
+		updateAgain = true;
+		return;
+	}
+	if (decoMode() == VPMB)
+		return;
+	get_deco_settings(&settings);
+	job = new DecoPreviewJob;
+	for (start = 0; start < dive_table.nr; start = end) {
+		bool current = true;
+		end = deco_series_end(start);
+		for (i = start; i < end && current; i++)
+			current = deco_preview_is_current(get_dive(i), i > start ? get_dive(i - 1) : NULL, &settings);
+		if (current)
+			continue;
+		for (i = start; i < end; i++) {
+			struct dive *dive = get_dive(i);
+			struct dive *copy = alloc_dive();
+			copy_dive(dive, copy);
+			dive->deco_preview.pending = true;
+			job->indices.append(i);
+			job->dives.append(copy);
+			job->seriesStart.append(i == start);
+			struct deco_preview preview = {};
+			preview.prev_id = i > start ? get_dive(i - 1)->id : 0;
+			preview.settings = settings;
+			job->previews.append(preview);
+		}
+	}
+	if (job->dives.isEmpty()) {
+		delete job;
+		job = NULL;
+		return;
+	}
+	watcher.setFuture(QtConcurrent::run(calculateDecoPreviews, job));
+}
+
+void DecoPreviews::previewsCalculated()
+{
+	for (int i = 0; i < job->dives.count(); i++) {
+		struct dive *dive = get_dive(job->indices[i]);
+		if (!dive || dive->id != job->dives[i]->id)
+			dive = get_dive_by_uniq_id(job->dives[i]->id);
+		// anything that changed since is calculated again
+		if (dive && dive->deco_preview.pending) {
+			dive->deco_preview = job->previews[i];
+			dive->deco_preview.valid = true;
+		} else {
+			updateAgain = true;
+		}
+		clear_dive(job->dives[i]);
+		free(job->dives[i]);
+	}
+	delete job;
+	job = NULL;
+	emit previewsChanged();
+	if (updateAgain) {
+		updateAgain = false;
+		update();
+	}
+}
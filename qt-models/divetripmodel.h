@@ -4,6 +4,7 @@
 #include "treemodel.h"
 #include "core/dive.h"
 #include <string>
+#include <QFutureWatcher>
 
 struct DiveItem : public TreeItem {
 	Q_DECLARE_TR_FUNCTIONS(TripItem)
@@ -24,6 +25,9 @@ public:
 		MAXCNS,
 		PHOTOS,
 		LOCATION,
+		MAXCEILING,
+		SURFACEGF,
+		DECOTIME,
 		COLUMNS
 	};
 
@@ -38,6 +42,7 @@ public:
 	QString displayTemperature() const;
 	QString displayWeight() const;
 	QString displaySac() const;
+	QString displayDecoTime() const;
 	int countPhotos(dive *dive) const;
 	int weight() const;
 	QString icon_names[4];
@@ -69,6 +74,9 @@ public:
 		MAXCNS,
 		PHOTOS,
 		LOCATION,
+		MAXCEILING,
+		SURFACEGF,
+		DECOTIME,
 		COLUMNS
 	};
 
@@ -92,10 +100,39 @@ public:
 	Layout layout() const;
 	void setLayout(Layout layout);
 
+private
+slots:
+	void decoPreviewsChanged();
+
 private:
 	void setupModelData();
 	QMap<dive_trip_t *, TripItem *> trips;
 	Layout currentLayout;
 };
 
+struct DecoPreviewJob;
+
+// Calculates the deco previews of the dive list on another thread, see
+// preview_dive_deco(). There is only one, so that it outlives the models.
+class DecoPreviews : public QObject {
+	Q_OBJECT
+public:
+	static DecoPreviews *instance();
+	void update();
+
+signals:
+	void previewsChanged();
+
+private
+slots:
+	void previewsCalculated();
+
+private:
+	DecoPreviews();
+	DecoPreviewJob *job;
+	// update() was called while the job was running
+	bool updateAgain;
+	QFutureWatcher<void> watcher;
+};
+
 #endif
@@ -0,0 +1,282 @@
+#include "benchcore.h"
+#include "git2.h"
+
+#include "core/dive.h"
+#include "core/deco.h"
+#include "core/display.h"
+#include "core/divelist.h"
+#include "core/file.h"
+#include "core/generate-logbook.h"
+#include "core/membuffer.h"
+#include "core/profile.h"
+#include "core/qthelper.h"
+#include "core/subsurfacestartup.h"
+
+#include <QDir>
+#include <QVector>
+
+// Benchmarks of the calculations that the desktop runs all the time.
+// They all work on the same reference dives, so the numbers of different
+// builds can be compared - run them with "make bench".
+
+extern "C" void save_dives_buffer(struct membuffer *b, const bool select_only);
+
+#define REFERENCE_DIVES SUBSURFACE_SOURCE "/dives/SampleDivesV2.ssrf"
+#define GIT_REPO "./benchgit"
+
+void BenchCore::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+	prefs.calcndltts = true;
+	git_libgit2_init();
+	QCOMPARE(parse_file(REFERENCE_DIVES), 0);
+	QVERIFY(dive_table.nr > 0);
+
+	QDir gitDir(GIT_REPO);
+	git_repository *repo;
+	QCOMPARE(gitDir.removeRecursively(), true);
+	QCOMPARE(QDir().mkdir(GIT_REPO), true);
+	QCOMPARE(git_repository_init(&repo, GIT_REPO, false), 0);
+	git_repository_free(repo);
+	QCOMPARE(save_dives(GIT_REPO "[bench]"), 0);
+}
+
+void BenchCore::benchAddSegment()
+{
+	struct deco_state ds;
+	struct gasmix air = { {209}, {0} };
+	struct dive *dive = get_dive(0);
+
+	clear_deco(&ds, 1.013, NULL);
+	QBENCHMARK {
+		// down to 40m and back up, in 20 second steps like the profile
+		for (int depth = 0; depth <= 40000; depth += 200)
+			add_segment(&ds, depth_to_bar(depth, dive), &air, 20, 0, dive, 0);
+		for (int depth = 40000; depth >= 0; depth -= 200)
+			add_segment(&ds, depth_to_bar(depth, dive), &air, 20, 0, dive, 0);
+	}
+}
+
+void BenchCore::benchTissueToleranceCalc_data()
+{
+	QTest::addColumn<int>("mode");
+	QTest::newRow("buehlmann") << (int)BUEHLMANN;
+	QTest::newRow("vpmb") << (int)VPMB;
+}
+
+void BenchCore::benchTissueToleranceCalc()
+{
+	QFETCH(int, mode);
+	struct deco_state ds;
+	struct gasmix air = { {209}, {0} };
+	struct dive *dive = get_dive(0);
+	double tolerance = 0.0;
+
+	prefs.display_deco_mode = (deco_mode)mode;
+	clear_deco(&ds, 1.013, NULL);
+	// 30 minutes at 40m leave us with some deco
+	add_segment(&ds, depth_to_bar(40000, dive), &air, 30 * 60, 0, dive, 0);
+	nuclear_regeneration(&ds, 30 * 60);
+	vpmb_start_gradient(&ds);
+	QBENCHMARK {
+		for (int depth = 40000; depth >= 0; depth -= 200)
+			tolerance += tissue_tolerance_calc(&ds, dive, depth_to_bar(depth, dive));
+	}
+	QVERIFY(tolerance > 0.0);
+}
+
+void BenchCore::benchDecoInformation_data()
+{
+	benchTissueToleranceCalc_data();
+}
+
+void BenchCore::benchDecoInformation()
+{
+	QFETCH(int, mode);
+	QVector<struct plot_info> plots(dive_table.nr);
+	struct deco_state ds;
+	int i;
+
+	prefs.display_deco_mode = (deco_mode)mode;
+	for (i = 0; i < dive_table.nr; i++) {
+		plots[i] = calculate_max_limits_new(get_dive(i), &get_dive(i)->dc);
+		// what the profile asks for, for its tool tip
+		plots[i].columns = PLOT_TISSUE_PERCENTAGES;
+		create_plot_info_new(get_dive(i), &get_dive(i)->dc, &plots[i], true, NULL);
+	}
+	QBENCHMARK {
+		for (i = 0; i < dive_table.nr; i++) {
+			init_decompression(&ds, get_dive(i), NULL);
+			calculate_deco_information(&ds, NULL, get_dive(i), &get_dive(i)->dc, &plots[i], false);
+		}
+	}
+	for (i = 0; i < dive_table.nr; i++)
+		free_plot_info_data(&plots[i]);
+}
+
+void BenchCore::benchPlotInfo()
+{
+	prefs.display_deco_mode = BUEHLMANN;
+	QBENCHMARK {
+		for (int i = 0; i < dive_table.nr; i++) {
+			struct plot_info pi = calculate_max_limits_new(get_dive(i), &get_dive(i)->dc);
+			pi.columns = PLOT_TISSUE_PERCENTAGES;
+			create_plot_info_new(get_dive(i), &get_dive(i)->dc, &pi, false, NULL);
+			free_plot_info_data(&pi);
+		}
+	}
+}
+
+void BenchCore::benchPlan_data()
+{
+	QTest::addColumn<int>("mode");
+	QTest::addColumn<int>("depth");
+	QTest::addColumn<int>("duration");
+	// the TestPlan scenarios, on air
+	QTest::newRow("buehlmann 79m 30min") << (int)BUEHLMANN << 79000 << 30;
+	QTest::newRow("vpmb 60m 30min") << (int)VPMB << 60000 << 30;
+	QTest::newRow("vpmb 100m 60min") << (int)VPMB << 100000 << 60;
+}
+
+void BenchCore::benchPlan()
+{
+	QFETCH(int, mode);
+	QFETCH(int, depth);
+	QFETCH(int, duration);
+	struct deco_state ds;
+	struct diveplan dp = {};
+	struct gasmix air = { {209}, {0} };
+	char *cache = NULL;
+
+	copy_prefs(&default_prefs, &prefs);
+	prefs.planner_deco_mode = (deco_mode)mode;
+	prefs.vpmb_conservatism = 0;
+	set_vpmb_conservatism(0);
+	set_gf(100, 100, false);
+	setCurrentAppState("PlanDive");
+
+	clear_dive(&displayed_dive);
+	displayed_dive.cylinder[0].gasmix = air;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	dp.salinity = 10300;
+	dp.surface_pressure = 1013;
+	dp.gflow = dp.gfhigh = 100;
+	int droptime = depth * 60 / 99000;
+	plan_add_segment(&dp, droptime, depth, 0, 0, 1);
+	plan_add_segment(&dp, duration * 60 - droptime, depth, 0, 0, 1);
+
+	QBENCHMARK {
+		plan(&ds, &dp, &displayed_dive, &cache, true, false);
+	}
+	free(cache);
+	free_dps(&dp);
+	clear_dive(&displayed_dive);
+	setCurrentAppState("Default");
+	copy_prefs(&default_prefs, &prefs);
+	prefs.calcndltts = true;
+}
+
+void BenchCore::benchParseXml()
+{
+	struct memblock mem;
+	struct dive_table table = {};
+
+	QVERIFY(readfile(REFERENCE_DIVES, &mem) >= 0);
+	QBENCHMARK {
+		QCOMPARE(parse_xml_buffer(REFERENCE_DIVES, (const char *)mem.buffer, mem.size, &table, NULL), 0);
+		for (int i = 0; i < table.nr; i++) {
+			clear_dive(table.dives[i]);
+			free(table.dives[i]);
+		}
+		table.nr = 0;
+	}
+	free(table.dives);
+	free(mem.buffer);
+}
+
+void BenchCore::benchSaveXml()
+{
+	QBENCHMARK {
+		struct membuffer buf = { 0 };
+		save_dives_buffer(&buf, false);
+		free_buffer(&buf);
+	}
+}
+
+void BenchCore::benchGitLoad()
+{
+	QBENCHMARK {
+		clear_dive_file_data();
+		QCOMPARE(parse_file(GIT_REPO "[bench]"), 0);
+	}
+	QVERIFY(dive_table.nr > 0);
+}
+
+void BenchCore::benchGeneratedSave_data()
+{
+	QTest::addColumn<int>("dives");
+	QTest::newRow("1000 dives") << 1000;
+	QTest::newRow("10000 dives") << 10000;
+}
+
+// instead of the reference dives, a generated logbook of the given size
+static void generateLogbook(int dives)
+{
+	struct logbook_shape shape;
+
+	clear_dive_file_data();
+	default_logbook_shape(&shape);
+	shape.dives = dives;
+	shape.sample_rate = 10;
+	generate_logbook(&shape, &dive_table);
+}
+
+void BenchCore::benchGeneratedSave()
+{
+	QFETCH(int, dives);
+
+	generateLogbook(dives);
+	QBENCHMARK {
+		struct membuffer buf = { 0 };
+		save_dives_buffer(&buf, false);
+		free_buffer(&buf);
+	}
+	clear_dive_file_data();
+	QCOMPARE(parse_file(REFERENCE_DIVES), 0);
+}
+
+void BenchCore::benchGeneratedParse_data()
+{
+	benchGeneratedSave_data();
+}
+
+void BenchCore::benchGeneratedParse()
+{
+	QFETCH(int, dives);
+	struct membuffer buf = { 0 };
+	struct dive_table table = {};
+
+	generateLogbook(dives);
+	save_dives_buffer(&buf, false);
+	QBENCHMARK {
+		QCOMPARE(parse_xml_buffer("generated", buf.buffer, buf.len, &table, NULL), 0);
+		for (int i = 0; i < table.nr; i++) {
+			clear_dive(table.dives[i]);
+			free(table.dives[i]);
+		}
+		table.nr = 0;
+	}
+	free(table.dives);
+	free_buffer(&buf);
+	clear_dive_file_data();
+	QCOMPARE(parse_file(REFERENCE_DIVES), 0);
+}
+
+void BenchCore::cleanupTestCase()
+{
+	clear_dive_file_data();
+	QDir(GIT_REPO).removeRecursively();
+}
+
+QTEST_MAIN(BenchCore)
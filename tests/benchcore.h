@@ -0,0 +1,28 @@
+#ifndef BENCHCORE_H
+#define BENCHCORE_H
+
+#include <QTest>
+
+class BenchCore : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void benchAddSegment();
+	void benchTissueToleranceCalc_data();
+	void benchTissueToleranceCalc();
+	void benchDecoInformation_data();
+	void benchDecoInformation();
+	void benchPlotInfo();
+	void benchPlan_data();
+	void benchPlan();
+	void benchParseXml();
+	void benchSaveXml();
+	void benchGitLoad();
+	void benchGeneratedSave_data();
+	void benchGeneratedSave();
+	void benchGeneratedParse_data();
+	void benchGeneratedParse();
+	void cleanupTestCase();
+};
+
+#endif // BENCHCORE_H
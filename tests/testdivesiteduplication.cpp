@@ -1,6 +1,7 @@
 #include "testdivesiteduplication.h"
 #include "core/dive.h"
 #include "core/divesite.h"
+#include "core/divelist.h"
 
 void TestDiveSiteDuplication::testReadV2()
 {
@@ -8,4 +9,110 @@ void TestDiveSiteDuplication::testReadV2()
 	QCOMPARE(dive_site_table.nr, 2);
 }
 
+void TestDiveSiteDuplication::testGpsProximity()
+{
+	// the two sites of TwoTimesTwo.ssrf have the same GPS fix
+	degrees_t latitude = { 7132557 }, longitude = { 134224213 };
+	struct dive_site_pair *pairs;
+	struct dive_site *ds = NULL;
+
+	QCOMPARE(get_dive_site_pairs_by_gps_proximity(1, &pairs), 1);
+	QCOMPARE(pairs[0].uuid1, get_dive_site(0)->uuid);
+	QCOMPARE(pairs[0].distance, 0u);
+	free(pairs);
+	QCOMPARE(get_dive_site_uuid_by_gps_proximity(latitude, longitude, 20, &ds), get_dive_site(0)->uuid);
+	QCOMPARE(ds, get_dive_site(0));
+	// about 110m further east
+	longitude.udeg += 1000;
+	QCOMPARE(get_dive_site_uuid_by_gps_proximity(latitude, longitude, 20, NULL), 0u);
+	QVERIFY(get_dive_site_uuid_by_gps_proximity(latitude, longitude, 200, NULL) != 0);
+	// a site that moves there is found there
+	set_dive_site_gps(get_dive_site(1), latitude, longitude);
+	QCOMPARE(get_dive_site_uuid_by_gps_proximity(latitude, longitude, 20, NULL), get_dive_site(1)->uuid);
+}
+
+void TestDiveSiteDuplication::testDiveSiteCounts()
+{
+	// still TwoTimesTwo.ssrf: the dives alternate between the two sites
+	uint32_t uuid0 = get_dive(0)->dive_site_uuid, uuid1 = get_dive(1)->dive_site_uuid;
+	uint32_t uuids[] = { uuid0, uuid1 };
+
+	QVERIFY(uuid0 != uuid1);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid0, false), 2);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid1, false), 2);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid0, true), 0);
+
+	// the counts follow the selection
+	select_dive(0);
+	select_dive(1);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid0, true), 1);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid1, true), 1);
+	deselect_dive(0);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid0, true), 0);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid1, true), 1);
+
+	// and the dives that move to another site
+	merge_dive_sites(uuid0, uuids, 2);
+	QCOMPARE(dive_site_table.nr, 1);
+	QVERIFY(get_dive_site_by_uuid(uuid1) == NULL);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid0, false), 4);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid0, true), 1);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid1, false), 0);
+	deselect_dive(1);
+	QCOMPARE(nr_of_dives_at_dive_site(uuid0, true), 0);
+	clear_dive_file_data();
+}
+
+void TestDiveSiteDuplication::testReassignDiveSite()
+{
+	QCOMPARE(parse_file(SUBSURFACE_SOURCE "/dives/TwoTimesTwo.ssrf"), 0);
+	uint32_t uuid0 = get_dive(0)->dive_site_uuid, uuid1 = get_dive(1)->dive_site_uuid;
+
+	// count once, then move the dives of the second site one at a time
+	QVERIFY(is_dive_site_used(uuid1, false));
+	set_dive_site_uuid(get_dive(1), uuid0);
+	QVERIFY(is_dive_site_used(uuid1, false));
+	QCOMPARE(nr_of_dives_at_dive_site(uuid0, false), 3);
+	set_dive_site_uuid(get_dive(3), uuid0);
+	QVERIFY(!is_dive_site_used(uuid1, false));
+	QCOMPARE(nr_of_dives_at_dive_site(uuid0, false), 4);
+	clear_dive_file_data();
+}
+
+static void compareSitesByUuid(const QVector<uint32_t> &uuids)
+{
+	for (int i = 0; i < uuids.count(); i++) {
+		struct dive_site *ds = get_dive_site_by_uuid(uuids[i]);
+
+		// every third of them was deleted
+		if (i % 3 == 0) {
+			QVERIFY(ds == NULL);
+			continue;
+		}
+		QVERIFY(ds != NULL);
+		QCOMPARE(QString(ds->name), QString("Site %1").arg(i));
+	}
+}
+
+void TestDiveSiteDuplication::testUuidIndex()
+{
+	QVector<uint32_t> uuids;
+
+	for (int i = 0; i < 200; i++)
+		uuids.append(create_dive_site(qPrintable(QString("Site %1").arg(i)), i));
+	for (int i = 0; i < uuids.count(); i++)
+		QCOMPARE(QString(get_dive_site_by_uuid(uuids[i])->name), QString("Site %1").arg(i));
+
+	// the sites after the deleted ones move, and sorting moves them all
+	for (int i = 0; i < uuids.count(); i += 3)
+		delete_dive_site(uuids[i]);
+	QCOMPARE(dive_site_table.nr, 133);
+	compareSitesByUuid(uuids);
+	dive_site_table_sort();
+	compareSitesByUuid(uuids);
+
+	clear_dive_file_data();
+	QVERIFY(get_dive_site_by_uuid(uuids[1]) == NULL);
+}
+
 QTEST_MAIN(TestDiveSiteDuplication)
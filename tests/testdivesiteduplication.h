@@ -8,6 +8,10 @@ class TestDiveSiteDuplication : public QObject
 	Q_OBJECT
 private slots:
 	void testReadV2();
+	void testGpsProximity();
+	void testDiveSiteCounts();
+	void testReassignDiveSite();
+	void testUuidIndex();
 };
 
 #endif // TESTDIVESITEDUPLICATION_H
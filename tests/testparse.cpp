@@ -2,6 +2,7 @@
 #include "core/dive.h"
 #include "core/file.h"
 #include "core/divelist.h"
+#include "core/generate-logbook.h"
 #include <QTextStream>
 
 void TestParse::initTestCase()
@@ -405,4 +406,34 @@ void TestParse::testParseCompareDLDOutput()
 	clear_dive_file_data();
 }
 
+void TestParse::testParseGeneratedLogbook()
+{
+	// a generated logbook, with all the kinds of data it makes up, has to
+	// come back the same after saving and loading it
+	struct logbook_shape shape;
+
+	default_logbook_shape(&shape);
+	shape.dives = 20;
+	shape.ccr_percent = 50;
+	generate_logbook(&shape, &dive_table);
+	QCOMPARE(dive_table.nr, 20);
+	QCOMPARE(save_dives("./testgenerated.ssrf"), 0);
+	clear_dive_file_data();
+	QCOMPARE(parse_file("./testgenerated.ssrf"), 0);
+	QCOMPARE(dive_table.nr, 20);
+	QCOMPARE(save_dives("./testgeneratedout.ssrf"), 0);
+	QFile org("./testgenerated.ssrf");
+	org.open(QFile::ReadOnly);
+	QFile out("./testgeneratedout.ssrf");
+	out.open(QFile::ReadOnly);
+	QTextStream orgS(&org);
+	QTextStream outS(&out);
+	QStringList readin = orgS.readAll().split("\n");
+	QStringList written = outS.readAll().split("\n");
+	while(readin.size() && written.size()){
+		QCOMPARE(readin.takeFirst(), written.takeFirst());
+	}
+	clear_dive_file_data();
+}
+
 QTEST_MAIN(TestParse)
@@ -1,6 +1,7 @@
 #include "core/dive.h"
 #include "testplan.h"
 #include "core/planner.h"
+#include "core/deco.h"
 #include "core/units.h"
 #include "core/subsurfacestartup.h"
 #include "core/qthelper.h"
@@ -9,9 +10,8 @@
 #define DEBUG  1
 
 // testing the dive plan algorithm
-extern bool plan(struct diveplan *diveplan, char **cached_datap, bool is_planner, bool show_disclaimer);
-
-extern pressure_t first_ceiling_pressure;
+struct deco_state test_deco_state;
+extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, char **cached_datap, bool is_planner, bool show_disclaimer);
 
 void setupPrefs()
 {
@@ -289,7 +289,7 @@ void TestPlan::testMetric()
 	struct diveplan testPlan = {};
 	setupPlan(&testPlan);
 
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -325,7 +325,7 @@ void TestPlan::testImperial()
 	struct diveplan testPlan = {};
 	setupPlan(&testPlan);
 
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -361,7 +361,7 @@ void TestPlan::testVpmbMetric60m30minAir()
 	setupPlanVpmb60m30minAir(&testPlan);
 	setCurrentAppState("PlanDive");
 
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -370,7 +370,7 @@ void TestPlan::testVpmbMetric60m30minAir()
 #endif
 
 	// print first ceiling
-	printf("First ceiling %.1f m\n", (mbar_to_depth(first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
+	printf("First ceiling %.1f m\n", (mbar_to_depth(test_deco_state.first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
 	// check benchmark run time of 141 minutes, and known Subsurface runtime of 139 minutes
 	QVERIFY(compareDecoTime(displayed_dive.dc.duration.seconds, 141u * 60u + 20u, 139u * 60u + 20u));
 }
@@ -387,7 +387,7 @@ void TestPlan::testVpmbMetric60m30minEan50()
 	setupPlanVpmb60m30minEan50(&testPlan);
 	setCurrentAppState("PlanDive");
 
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -396,7 +396,7 @@ void TestPlan::testVpmbMetric60m30minEan50()
 #endif
 
 	// print first ceiling
-	printf("First ceiling %.1f m\n", (mbar_to_depth(first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
+	printf("First ceiling %.1f m\n", (mbar_to_depth(test_deco_state.first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
 	// check first gas change to EAN50 at 21m
 	struct event *ev = displayed_dive.dc.events;
 	QVERIFY(ev != NULL);
@@ -419,7 +419,7 @@ void TestPlan::testVpmbMetric60m30minTx()
 	setupPlanVpmb60m30minTx(&testPlan);
 	setCurrentAppState("PlanDive");
 
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -428,7 +428,7 @@ void TestPlan::testVpmbMetric60m30minTx()
 #endif
 
 	// print first ceiling
-	printf("First ceiling %.1f m\n", (mbar_to_depth(first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
+	printf("First ceiling %.1f m\n", (mbar_to_depth(test_deco_state.first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
 	// check first gas change to EAN50 at 21m
 	struct event *ev = displayed_dive.dc.events;
 	QVERIFY(ev != NULL);
@@ -451,7 +451,7 @@ void TestPlan::testVpmbMetric100m60min()
 	setupPlanVpmb100m60min(&testPlan);
 	setCurrentAppState("PlanDive");
 
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -460,7 +460,7 @@ void TestPlan::testVpmbMetric100m60min()
 #endif
 
 	// print first ceiling
-	printf("First ceiling %.1f m\n", (mbar_to_depth(first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
+	printf("First ceiling %.1f m\n", (mbar_to_depth(test_deco_state.first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
 	// check first gas change to EAN50 at 21m
 	struct event *ev = displayed_dive.dc.events;
 	QVERIFY(ev != NULL);
@@ -489,7 +489,7 @@ void TestPlan::testVpmbMetricMultiLevelAir()
 	setupPlanVpmbMultiLevelAir(&testPlan);
 	setCurrentAppState("PlanDive");
 
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -498,7 +498,7 @@ void TestPlan::testVpmbMetricMultiLevelAir()
 #endif
 
 	// print first ceiling
-	printf("First ceiling %.1f m\n", (mbar_to_depth(first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
+	printf("First ceiling %.1f m\n", (mbar_to_depth(test_deco_state.first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
 	// check benchmark run time of 167 minutes, and known Subsurface runtime of 169 minutes
 	QVERIFY(compareDecoTime(displayed_dive.dc.duration.seconds, 167u * 60u + 20u, 169u * 60u + 20u));
 }
@@ -515,7 +515,7 @@ void TestPlan::testVpmbMetric100m10min()
 	setupPlanVpmb100m10min(&testPlan);
 	setCurrentAppState("PlanDive");
 
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -524,7 +524,7 @@ void TestPlan::testVpmbMetric100m10min()
 #endif
 
 	// print first ceiling
-	printf("First ceiling %.1f m\n", (mbar_to_depth(first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
+	printf("First ceiling %.1f m\n", (mbar_to_depth(test_deco_state.first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
 	// check first gas change to EAN50 at 21m
 	struct event *ev = displayed_dive.dc.events;
 	QVERIFY(ev != NULL);
@@ -557,7 +557,7 @@ void TestPlan::testVpmbMetricRepeat()
 	setupPlanVpmb30m20min(&testPlan);
 	setCurrentAppState("PlanDive");
 
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -566,14 +566,14 @@ void TestPlan::testVpmbMetricRepeat()
 #endif
 
 	// print first ceiling
-	printf("First ceiling %.1f m\n", (mbar_to_depth(first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
+	printf("First ceiling %.1f m\n", (mbar_to_depth(test_deco_state.first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
 	// check benchmark run time of 27 minutes, and known Subsurface runtime of 27 minutes
 	QVERIFY(compareDecoTime(displayed_dive.dc.duration.seconds, 27u * 60u + 20u, 27u * 60u + 20u));
 
 	int firstDiveRunTimeSeconds = displayed_dive.dc.duration.seconds;
 
 	setupPlanVpmb100mTo70m30min(&testPlan);
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -582,7 +582,7 @@ void TestPlan::testVpmbMetricRepeat()
 #endif
 
 	// print first ceiling
-	printf("First ceiling %.1f m\n", (mbar_to_depth(first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
+	printf("First ceiling %.1f m\n", (mbar_to_depth(test_deco_state.first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
 	// check first gas change to 21/35 at 66m
 	struct event *ev = displayed_dive.dc.events;
 	QVERIFY(ev != NULL);
@@ -605,7 +605,7 @@ void TestPlan::testVpmbMetricRepeat()
 	QVERIFY(compareDecoTime(displayed_dive.dc.duration.seconds, 126u * 60u + 20u, 126u * 60u + 20u));
 
 	setupPlanVpmb30m20min(&testPlan);
-	plan(&testPlan, &cache, 1, 0);
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
 
 #if DEBUG
 	free(displayed_dive.notes);
@@ -614,11 +614,81 @@ void TestPlan::testVpmbMetricRepeat()
 #endif
 
 	// print first ceiling
-	printf("First ceiling %.1f m\n", (mbar_to_depth(first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
+	printf("First ceiling %.1f m\n", (mbar_to_depth(test_deco_state.first_ceiling_pressure.mbar, &displayed_dive) * 0.001));
 
 	// check runtime is exactly the same as the first time
 	int finalDiveRunTimeSeconds = displayed_dive.dc.duration.seconds;
 	QCOMPARE(finalDiveRunTimeSeconds, firstDiveRunTimeSeconds);
 }
 
+void TestPlan::testMetricSweep()
+{
+	char *cache = NULL;
+
+	setupPrefs();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	prefs.planner_deco_mode = BUEHLMANN;
+
+	struct diveplan testPlan = {};
+	setupPlan(&testPlan);
+
+	plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
+	free(cache);
+	int runtime = displayed_dive.dc.sample[displayed_dive.dc.samples - 1].time.seconds;
+
+	// the plan itself, five minutes longer at the bottom, 3m deeper and with GF 30/70
+	struct plan_sweep_cell cells[4] = {};
+	for (int i = 0; i < 3; i++)
+		cells[i].gflow = cells[i].gfhigh = -1;
+	cells[1].bottom_time_delta = 5 * 60;
+	cells[2].depth_delta = 3000;
+	cells[3].gflow = 30;
+	cells[3].gfhigh = 70;
+	struct deco_settings settings;
+	prepare_plan_sweep(&displayed_dive, &settings);
+	for (int i = 0; i < 4; i++) {
+		plan_sweep_cell(&testPlan, &displayed_dive, &settings, &cells[i]);
+		QVERIFY(cells[i].valid);
+		QVERIFY(cells[i].decodive);
+	}
+	QCOMPARE(cells[0].runtime, runtime);
+	QCOMPARE(cells[0].gas_used[0].mliter, displayed_dive.cylinder[0].gas_used.mliter);
+	QVERIFY(cells[1].runtime > runtime + 5 * 60);
+	QVERIFY(cells[2].runtime > runtime);
+	QVERIFY(cells[3].runtime > runtime);
+	// the cells work on their own copies of the dive
+	QCOMPARE(displayed_dive.dc.sample[displayed_dive.dc.samples - 1].time.seconds, runtime);
+}
+
+void TestPlan::testMetricCheckpoints()
+{
+	struct plan_checkpoints checkpoints = {};
+	struct diveplan testPlan = {};
+	int runtime[2][2];
+
+	setupPrefs();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	prefs.planner_deco_mode = BUEHLMANN;
+
+	// the plan, then with the bottom waypoint ten minutes later - without and with checkpoints
+	for (int moved = 0; moved < 2; moved++) {
+		for (int i = 0; i < 2; i++) {
+			char *cache = NULL;
+
+			setupPlan(&testPlan);
+			testPlan.dp->next->time += moved * 10 * 60;
+			testPlan.checkpoints = i ? &checkpoints : NULL;
+			plan(&test_deco_state, &testPlan, &displayed_dive, &cache, 1, 0);
+			free(cache);
+			runtime[moved][i] = displayed_dive.dc.sample[displayed_dive.dc.samples - 1].time.seconds;
+		}
+		QCOMPARE(runtime[moved][1], runtime[moved][0]);
+	}
+	QVERIFY(runtime[1][0] > runtime[0][0] + 10 * 60);
+	free_dps(&testPlan);
+	free_plan_checkpoints(&checkpoints);
+}
+
 QTEST_MAIN(TestPlan)
@@ -15,6 +15,8 @@ private slots:
 	void testVpmbMetric100m60min();
 	void testVpmbMetric100m10min();
 	void testVpmbMetricRepeat();
+	void testMetricSweep();
+	void testMetricCheckpoints();
 };
 
 #endif // TESTPLAN_H
@@ -1,9 +1,231 @@
 #include "testprofile.h"
+#include <QVector>
 #include "core/dive.h"
+#include "core/display.h"
+#include "core/profile.h"
+#include "core/divelist.h"
+#include "core/generate-logbook.h"
+#include "core/subsurfacestartup.h"
 
 void TestProfile::testRedCeiling()
 {
 	parse_file("../dives/deep.xml");
 }
 
-QTEST_MAIN(TestProfile)
\ No newline at end of file
+// The minimum and maximum depth within 4.5 minutes of every entry - the
+// first entry of the deepest or shallowest, looking at all of them
+static void compareMinMax(const struct plot_info *pi)
+{
+	for (int i = 0; i < pi->nr; i++) {
+		int min = -1, max = -1;
+
+		for (int j = 0; j < pi->nr; j++) {
+			if (abs(pi->entry[j].sec - pi->entry[i].sec) > 9 * 30)
+				continue;
+			if (min < 0 || pi->entry[j].depth < pi->entry[min].depth)
+				min = j;
+			if (max < 0 || pi->entry[j].depth > pi->entry[max].depth)
+				max = j;
+		}
+		QCOMPARE(pi->entry[i].min, min);
+		QCOMPARE(pi->entry[i].max, max);
+	}
+}
+
+// The SAC rate calculation as it was before it learned to reuse work:
+// every entry on its own, from up to 30 seconds before it until a minute
+// after that, adding up the depth pressure over time step by step
+static int plainSacBetween(struct dive *dive, struct plot_data *first, struct plot_data *last)
+{
+	int airuse;
+	double pressuretime;
+	pressure_t a, b;
+	cylinder_t *cyl;
+
+	if (first == last)
+		return 0;
+
+	a.mbar = GET_PRESSURE(first);
+	b.mbar = GET_PRESSURE(last);
+	cyl = dive->cylinder + first->cylinderindex;
+	airuse = gas_volume(cyl, a) - gas_volume(cyl, b);
+	if (airuse <= 0)
+		return 0;
+
+	pressuretime = 0.0;
+	do {
+		int depth = (first[0].depth + first[1].depth) / 2;
+		int time = first[1].sec - first[0].sec;
+		double atm = depth_to_atm(depth, dive);
+
+		pressuretime += atm * time;
+	} while (++first < last);
+
+	pressuretime /= 60;
+	return rint(airuse / pressuretime);
+}
+
+static void plainFillSac(struct dive *dive, struct plot_data *entries, int nr, int idx)
+{
+	struct plot_data *entry = entries + idx;
+	struct plot_data *first, *last;
+	int time;
+
+	if (entry->sac)
+		return;
+
+	if (!GET_PRESSURE(entry))
+		return;
+
+	first = entry;
+	time = entry->sec - 30;
+	while (idx > 0) {
+		struct plot_data *prev = first - 1;
+		if (prev->cylinderindex != first->cylinderindex)
+			break;
+		if (prev->depth < SURFACE_THRESHOLD && first->depth < SURFACE_THRESHOLD)
+			break;
+		if (prev->sec < time)
+			break;
+		if (!GET_PRESSURE(prev))
+			break;
+		idx--;
+		first = prev;
+	}
+
+	last = first;
+	time = first->sec + 60;
+	while (++idx < nr) {
+		struct plot_data *next = last + 1;
+		if (next->cylinderindex != last->cylinderindex)
+			break;
+		if (next->depth < SURFACE_THRESHOLD && last->depth < SURFACE_THRESHOLD)
+			break;
+		if (next->sec > time)
+			break;
+		if (!GET_PRESSURE(next))
+			break;
+		last = next;
+	}
+
+	entry->sac = plainSacBetween(dive, first, last);
+}
+
+static void compareSac(struct dive *dive, const struct plot_info *pi)
+{
+	QVector<struct plot_data> plain(pi->nr);
+
+	for (int i = 0; i < pi->nr; i++) {
+		plain[i] = pi->entry[i];
+		plain[i].sac = 0;
+	}
+	for (int i = 0; i < pi->nr; i++)
+		plainFillSac(dive, plain.data(), pi->nr, i);
+	for (int i = 0; i < pi->nr; i++)
+		QCOMPARE(pi->entry[i].sac, plain[i].sac);
+}
+
+static bool hasSampleSac(const struct divecomputer *dc)
+{
+	for (int i = 0; i < dc->samples; i++) {
+		if (dc->sample[i].sac.mliter)
+			return true;
+	}
+	return false;
+}
+
+static void compareMinMaxAndSac()
+{
+	struct dive *dive;
+	int i;
+
+	for_each_dive (i, dive) {
+		for (struct divecomputer *dc = &dive->dc; dc; dc = dc->next) {
+			struct plot_info pi = calculate_max_limits_new(dive, dc);
+
+			// there is nothing to compare without samples, and SAC rates
+			// from the dive computer stay as they are
+			if (!dc->samples || hasSampleSac(dc))
+				continue;
+			create_plot_info_without_deco(dive, dc, &pi, false);
+			compareMinMax(&pi);
+			compareSac(dive, &pi);
+			free_plot_info_data(&pi);
+		}
+	}
+}
+
+void TestProfile::testMinMaxAndSac()
+{
+	// the minima, maxima and SAC rates are calculated for all entries at
+	// once - they have to be what looking at each entry on its own gives
+	struct logbook_shape shape;
+
+	copy_prefs(&default_prefs, &prefs);
+	QCOMPARE(parse_file(SUBSURFACE_SOURCE "/dives/SampleDivesV2.ssrf"), 0);
+	compareMinMaxAndSac();
+	clear_dive_file_data();
+
+	default_logbook_shape(&shape);
+	shape.dives = 10;
+	generate_logbook(&shape, &dive_table);
+	compareMinMaxAndSac();
+	clear_dive_file_data();
+}
+
+static bool sameTissue(double closedForm, double stepped)
+{
+	return fabs(closedForm - stepped) <= 1e-9 * fabs(stepped);
+}
+
+// At every entry without a ceiling, the NDL in closed form has to be what
+// adding one minute after the other gives, and leave the same tissues behind
+static void compareNdl(struct dive *dive, struct divecomputer *dc)
+{
+	struct plot_info pi = calculate_max_limits_new(dive, dc);
+	double surface_pressure = (dc->surface_pressure.mbar ? dc->surface_pressure.mbar : get_surface_pressure_in_mbar(dive, true)) / 1000.0;
+	struct deco_state ds;
+
+	create_plot_info_without_deco(dive, dc, &pi, false);
+	init_decompression(&ds, dive, NULL);
+	for (int i = 1; i < pi.nr; i++) {
+		struct plot_data *entry = pi.entry + i;
+		struct plot_data closedEntry = *entry, steppedEntry = *entry;
+		struct deco_state closed, stepped;
+
+		add_segment(&ds, depth_to_bar((entry[-1].depth + entry->depth) / 2, dive), &dive->cylinder[entry->cylinderindex].gasmix,
+			    entry->sec - entry[-1].sec, entry->o2pressure.mbar, dive, prefs.bottomsac);
+		if (entry->depth < 3000 ||
+		    deco_allowed_depth(tissue_tolerance_calc(&ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, 1) > 0)
+			continue;
+		closed = stepped = ds;
+		closedEntry.ndl_calc = steppedEntry.ndl_calc = 0;
+		calculate_ndl(&closed, &closedEntry, dive, surface_pressure, true);
+		calculate_ndl(&stepped, &steppedEntry, dive, surface_pressure, false);
+		QCOMPARE(closedEntry.ndl_calc, steppedEntry.ndl_calc);
+		for (int ci = 0; ci < 16; ci++) {
+			QVERIFY(sameTissue(closed.tissue_n2_sat[ci], stepped.tissue_n2_sat[ci]));
+			QVERIFY(sameTissue(closed.tissue_he_sat[ci], stepped.tissue_he_sat[ci]));
+			QVERIFY(sameTissue(closed.tolerated_by_tissue[ci], stepped.tolerated_by_tissue[ci]));
+		}
+	}
+	free_plot_info_data(&pi);
+}
+
+void TestProfile::testNdlClosedForm()
+{
+	struct dive *dive;
+	int i;
+
+	copy_prefs(&default_prefs, &prefs);
+	QCOMPARE(parse_file(SUBSURFACE_SOURCE "/dives/SampleDivesV2.ssrf"), 0);
+	for_each_dive (i, dive) {
+		for (struct divecomputer *dc = &dive->dc; dc; dc = dc->next) {
+			if (dc->samples)
+				compareNdl(dive, dc);
+		}
+	}
+	clear_dive_file_data();
+}
+
+QTEST_MAIN(TestProfile)
@@ -7,6 +7,8 @@ class TestProfile : public QObject{
 	Q_OBJECT
 private slots:
 	void testRedCeiling();
+	void testMinMaxAndSac();
+	void testNdlClosedForm();
 };
 
 #endif
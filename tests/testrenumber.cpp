@@ -2,6 +2,7 @@
 #include "core/dive.h"
 #include "core/file.h"
 #include "core/divelist.h"
+#include "core/id-index.h"
 #include <QTextStream>
 
 void TestRenumber::setup()
@@ -33,4 +34,51 @@ void TestRenumber::testMergeAndAppend()
 		QCOMPARE(d->number, 2);
 }
 
+void TestRenumber::testLookupById()
+{
+	// the merges above moved dives around and gave them old ids back
+	for (int i = 0; i < dive_table.nr; i++) {
+		struct dive *d = get_dive(i);
+		QCOMPARE(get_dive_by_uniq_id(d->id), d);
+		QCOMPARE(get_idx_by_uniq_id(d->id), i);
+		QCOMPARE(get_divenr(d), i);
+	}
+	int id = get_dive(1)->id;
+	delete_single_dive(0);
+	QCOMPARE(get_idx_by_uniq_id(id), 0);
+}
+
+void TestRenumber::testIdIndexRemove()
+{
+	struct id_index index = {};
+
+	// the ids shifted by 16 bits all want the same slot, the small ones go in between
+	for (int i = 0; i < 100; i++) {
+		id_index_set(&index, (i + 1) << 16, i);
+		id_index_set(&index, i + 1, 100 + i);
+	}
+	// only the id at the given position is removed
+	id_index_remove(&index, 1 << 16, 5);
+	QCOMPARE(id_index_get(&index, 1 << 16), 0);
+
+	// whatever had to probe past a removed entry has to be found still
+	for (int i = 0; i < 100; i += 2) {
+		id_index_remove(&index, (i + 1) << 16, i);
+		id_index_remove(&index, i + 1, 100 + i);
+	}
+	for (int i = 0; i < 100; i++) {
+		QCOMPARE(id_index_get(&index, (i + 1) << 16), i % 2 ? i : -1);
+		QCOMPARE(id_index_get(&index, i + 1), i % 2 ? 100 + i : -1);
+	}
+	for (int i = 1; i < 100; i += 2)
+		id_index_remove(&index, (i + 1) << 16, i);
+	for (int i = 0; i < 100; i++) {
+		QCOMPARE(id_index_get(&index, (i + 1) << 16), -1);
+		QCOMPARE(id_index_get(&index, i + 1), i % 2 ? 100 + i : -1);
+	}
+	QCOMPARE(index.used, 50u);
+	free(index.entries);
+}
+
+
 QTEST_MAIN(TestRenumber)
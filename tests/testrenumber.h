@@ -10,6 +10,8 @@ private slots:
 	void setup();
 	void testMerge();
 	void testMergeAndAppend();
+	void testLookupById();
+	void testIdIndexRemove();
 };
 
 #endif